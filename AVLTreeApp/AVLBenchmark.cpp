@@ -1,14 +1,282 @@
 #include <chrono>
 #include <random>
+#include <algorithm>
+#include <cstdio>
 #include <map>
+#include <string>
+#include <thread>
 #include "../benchmark/benchmark.h"
+#include "../benchmark/allocations.h"
 #include "../AVLTreeLib/AVLTree.h"
 
+/**
+ * Measure insertion and teardown time of a tree with given node allocator
+ *
+ * @tparam TreeType tree instantiated with the examined allocator
+ * @param numbers keys to insert
+ * @param sampleSize number of keys to insert
+ * @param insertNanos output, time of inserting sampleSize keys
+ * @param teardownNanos output, time of destroying all nodes
+ */
+template<typename TreeType>
+void measureAllocator(std::vector<unsigned long> const &numbers, size_t sampleSize,
+                      size_t &insertNanos, size_t &teardownNanos) {
+    TreeType tree;
+    Benchmark<std::chrono::nanoseconds> insertTimer;
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        tree.insert(numbers[idx], numbers[idx]);
+    }
+    insertNanos = insertTimer.elapsed();
+
+    Benchmark<std::chrono::nanoseconds> teardownTimer;
+    tree.clear();
+    teardownNanos = teardownTimer.elapsed();
+}
+
+/**
+ * Size of heavyweight string values in bytes, large enough to defeat small string optimization
+ */
+const size_t HEAVY_VALUE_BYTES = 256;
+
+/**
+ * Measure heap allocations of inserting heavyweight string values
+ *
+ * @tparam InsertFunction callable (tree, key, value) performing one insertion
+ * @param numbers keys to insert
+ * @param sampleSize number of keys to insert
+ * @param insertFunction insertion variant under test, may consume the prepared value
+ * @param nanos output, time of inserting sampleSize keys
+ * @return average number of heap allocations per insert
+ */
+template<typename InsertFunction>
+double measureHeavyInsert(std::vector<unsigned long> const &numbers, size_t sampleSize,
+                          InsertFunction insertFunction, size_t &nanos) {
+    std::vector<std::string> values(sampleSize, std::string(HEAVY_VALUE_BYTES, 'x'));
+    AVLTree<unsigned long, std::string> tree;
+
+    auto allocationsBefore = allocationCount();
+    Benchmark<std::chrono::nanoseconds> timer;
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        insertFunction(tree, numbers[idx], values[idx]);
+    }
+    nanos = timer.elapsed();
+    return (double) (allocationCount() - allocationsBefore) / sampleSize;
+}
+
+/**
+ * Number of operations per second
+ */
+double throughput(size_t operations, size_t nanos) {
+    return nanos == 0 ? 0.0 : operations * 1e9 / nanos;
+}
+
+/**
+ * Number of keys passed to a single findBatch call in the search benchmark
+ */
+const size_t SEARCH_BATCH_SIZE = 256;
+
+/**
+ * Tree sizes of the frozen snapshot benchmark, 10^8 keys need about 9 GB and can be appended on a machine that has it
+ */
+const std::vector<size_t> FROZEN_SAMPLE_SIZES = {100000, 1000000, 10000000};
+
+/**
+ * Number of lookups timed per tree size in the frozen snapshot benchmark
+ */
+const size_t FROZEN_LOOKUPS = 1000000;
+
+/**
+ * Measure lookups of present keys in a live tree and in its frozen snapshot
+ *
+ * @param size number of random keys in the tree
+ * @param generator source of keys and lookup order
+ * @param liveNanos output, time of FROZEN_LOOKUPS lookups in the tree
+ * @param frozenNanos output, time of FROZEN_LOOKUPS lookups in the snapshot
+ */
+void measureFrozenSearch(size_t size, std::mt19937 &generator, size_t &liveNanos, size_t &frozenNanos) {
+    std::vector<std::pair<unsigned long, unsigned long>> pairs;
+    for (size_t idx = 0; idx < size; idx++) {
+        auto number = (unsigned long) generator() << 32 | generator();
+        pairs.emplace_back(number, number);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    std::vector<unsigned long> lookups;
+    for (size_t idx = 0; idx < FROZEN_LOOKUPS; idx++) {
+        lookups.push_back(pairs[generator() % pairs.size()].first);
+    }
+
+    AVLTree<unsigned long, unsigned long> tree;
+    tree.buildFromSorted(pairs.begin(), pairs.end());
+    pairs.clear();
+    pairs.shrink_to_fit();
+    auto frozen = tree.freeze();
+
+    // Sums keep the lookups from being optimized away
+    unsigned long liveSum = 0, frozenSum = 0;
+    Benchmark<std::chrono::nanoseconds> liveTimer;
+    for (auto key : lookups) {
+        liveSum += *tree.find(key);
+    }
+    liveNanos = liveTimer.elapsed();
+
+    Benchmark<std::chrono::nanoseconds> frozenTimer;
+    for (auto key : lookups) {
+        frozenSum += *frozen.find(key);
+    }
+    frozenNanos = frozenTimer.elapsed();
+
+    if (liveSum != frozenSum) {
+        std::cerr << "Frozen snapshot lookups differ from the tree\n";
+    }
+}
+
+/**
+ * Number of pairs loaded by the parallel bulk load benchmark
+ */
+const size_t PARALLEL_LOAD_SIZE = 4000000;
+
+/**
+ * Measure bulk loading of random pairs with increasing numbers of threads, 1 up to the hardware concurrency
+ *
+ * @param generator source of the pairs
+ * @param loadNanos output, time of bulkLoad by number of threads
+ */
+void measureParallelLoad(std::mt19937 &generator, std::map<size_t, size_t> &loadNanos) {
+    std::vector<std::pair<unsigned long, unsigned long>> pairs;
+    for (size_t idx = 0; idx < PARALLEL_LOAD_SIZE; idx++) {
+        auto number = (unsigned long) generator() << 32 | generator();
+        pairs.emplace_back(number, number);
+    }
+
+    size_t maxThreads = std::thread::hardware_concurrency();
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads > 0 ? maxThreads : 1);
+
+    for (auto threads : threadCounts) {
+        AVLTree<unsigned long, unsigned long> tree;
+        Benchmark<std::chrono::nanoseconds> timer;
+        tree.bulkLoad(pairs.begin(), pairs.end(), true, threads);
+        loadNanos[threads] = timer.elapsed();
+    }
+}
+
+/**
+ * Size of the tree merged with smaller trees by the union benchmark
+ */
+const size_t UNION_BASE_SIZE = 1000000;
+
+/**
+ * Sizes of the trees merged into the base tree by the union benchmark
+ */
+const std::vector<size_t> UNION_DELTA_SIZES = {1000, 10000, 100000};
+
+/**
+ * Measure merging a smaller tree into a large one, by an insert loop and by join-based unionWith
+ *
+ * @param generator source of the keys
+ * @param insertNanos output, time of inserting the smaller tree's elements one by one, by delta size
+ * @param unionNanos output, time of unionWith, by delta size
+ */
+void measureUnion(std::mt19937 &generator, std::map<size_t, size_t> &insertNanos,
+                  std::map<size_t, size_t> &unionNanos) {
+    std::vector<std::pair<unsigned long, unsigned long>> pairs;
+    for (size_t idx = 0; idx < UNION_BASE_SIZE; idx++) {
+        auto number = (unsigned long) generator() << 32 | generator();
+        pairs.emplace_back(number, number);
+    }
+    AVLTree<unsigned long, unsigned long> base;
+    base.bulkLoad(pairs.begin(), pairs.end());
+
+    for (auto deltaSize : UNION_DELTA_SIZES) {
+        AVLTree<unsigned long, unsigned long> delta;
+        for (size_t idx = 0; idx < deltaSize; idx++) {
+            auto number = (unsigned long) generator() << 32 | generator();
+            delta.insert(number, number);
+        }
+
+        AVLTree<unsigned long, unsigned long> inserted(base);
+        Benchmark<std::chrono::nanoseconds> insertTimer;
+        for (auto const &entry : delta) {
+            inserted.insert(entry.first, entry.second);
+        }
+        insertNanos[deltaSize] = insertTimer.elapsed();
+
+        AVLTree<unsigned long, unsigned long> merged(base);
+        Benchmark<std::chrono::nanoseconds> unionTimer;
+        merged.unionWith(std::move(delta));
+        unionNanos[deltaSize] = unionTimer.elapsed();
+
+        if (merged.size() != inserted.size()) {
+            std::cerr << "Union differs from the insert loop\n";
+        }
+    }
+}
+
+/**
+ * Number of elements in the tree restarted from a snapshot
+ */
+const size_t RESTART_SIZE = 1000000;
+
+/**
+ * Measure restoring a tree after a restart, by re-inserting every element and by mapping a saved snapshot
+ *
+ * @param generator source of the keys
+ * @param reinsertNanos output, time of the insert loop
+ * @param openNanos output, time of openMapped with and without checksum verification, in that order
+ * @param firstLookupsNanos output, time of 1000 lookups right after opening without verification
+ */
+void measureRestart(std::mt19937 &generator, size_t &reinsertNanos, std::pair<size_t, size_t> &openNanos,
+                    size_t &firstLookupsNanos) {
+    std::vector<std::pair<unsigned long, unsigned long>> pairs;
+    for (size_t idx = 0; idx < RESTART_SIZE; idx++) {
+        auto number = (unsigned long) generator() << 32 | generator();
+        pairs.emplace_back(number, number);
+    }
+
+    AVLTree<unsigned long, unsigned long> tree;
+    Benchmark<std::chrono::nanoseconds> reinsertTimer;
+    for (auto const &pair : pairs) {
+        tree.insert(pair.first, pair.second);
+    }
+    reinsertNanos = reinsertTimer.elapsed();
+
+    auto path = "avl-benchmark-snapshot.bin";
+    tree.save(path);
+    {
+        Benchmark<std::chrono::nanoseconds> verifiedTimer;
+        auto verified = AVLTree<unsigned long, unsigned long>::openMapped(path);
+        openNanos.first = verifiedTimer.elapsed();
+    }
+    Benchmark<std::chrono::nanoseconds> openTimer;
+    auto mapped = AVLTree<unsigned long, unsigned long>::openMapped(path, false);
+    openNanos.second = openTimer.elapsed();
+
+    size_t found = 0;
+    Benchmark<std::chrono::nanoseconds> lookupTimer;
+    for (size_t idx = 0; idx < 1000; idx++) {
+        found += mapped.contains(pairs[idx * (RESTART_SIZE / 1000)].first);
+    }
+    firstLookupsNanos = lookupTimer.elapsed();
+
+    if (found != 1000 || mapped.size() != tree.size()) {
+        std::cerr << "Mapped snapshot differs from the tree\n";
+    }
+    std::remove(path);
+}
+
 int main() {
     std::vector<int> sampleSizes = {10000, 20000, 30000, 40000, 50000, 60000, 70000, 80000, 90000, 100000};
 
     std::map<int, size_t> creationTimeNanos;
     std::map<int, size_t> searchTimeNanos;
+    std::map<int, size_t> batchSearchTimeNanos;
+    std::map<int, size_t> deletionTimeNanos;
+    std::map<int, AVLTree<unsigned long, unsigned long>::InsertStatistics> insertStatistics;
 
     auto seed = std::chrono::system_clock::now().time_since_epoch().count();
     std::mt19937 generator((unsigned long) seed);
@@ -21,30 +289,148 @@ int main() {
     for (auto sampleSize : sampleSizes) {
         Benchmark<std::chrono::nanoseconds> timer;
 
-        auto tree = AVLTree<unsigned long, unsigned long>();
+        AVLTree<unsigned long, unsigned long> tree;
         for (size_t idx = 0; idx < sampleSize; idx++) {
             auto number = randomNumbers[idx];
             tree.insert(number, number);
         }
         auto timeNanos = timer.elapsed();
         creationTimeNanos[sampleSize] = timeNanos;
+        insertStatistics[sampleSize] = tree.getInsertStatistics();
     }
 
     // Tree search benchmark
-    auto tree = AVLTree<unsigned long, unsigned long>();
+    AVLTree<unsigned long, unsigned long> tree;
     for (auto number : randomNumbers) {
         tree.insert(number, number);
     }
 
     for (auto sampleSize : sampleSizes) {
+        // Counting found keys keeps the lookups from being optimized away
+        size_t found = 0, batchFound = 0;
         Benchmark<std::chrono::nanoseconds> timer;
 
         for (size_t idx = 0; idx < sampleSize; idx++) {
-            tree.find(randomNumbers[idx]);
+            found += tree.find(randomNumbers[idx]) != nullptr;
         }
 
         auto timeNanos = timer.elapsed();
         searchTimeNanos[sampleSize] = timeNanos;
+
+        // Same keys resolved SEARCH_BATCH_SIZE at a time
+        std::vector<std::vector<unsigned long>> batches;
+        for (size_t idx = 0; idx < (size_t) sampleSize; idx += SEARCH_BATCH_SIZE) {
+            auto batchEnd = std::min(idx + SEARCH_BATCH_SIZE, (size_t) sampleSize);
+            batches.emplace_back(randomNumbers.begin() + idx, randomNumbers.begin() + batchEnd);
+        }
+        std::vector<unsigned long *> values;
+
+        Benchmark<std::chrono::nanoseconds> batchTimer;
+        for (auto const &batch : batches) {
+            tree.findBatch(batch, values);
+            for (auto value : values) {
+                batchFound += value != nullptr;
+            }
+        }
+        batchSearchTimeNanos[sampleSize] = batchTimer.elapsed();
+
+        if (found != batchFound) {
+            std::cerr << "Batched lookups differ from single ones\n";
+        }
+    }
+
+    // Node deletion benchmark
+    auto rng = std::default_random_engine {};
+    for (auto sampleSize : sampleSizes) {
+        AVLTree<unsigned long, unsigned long> removalTree;
+        for (auto number : randomNumbers) {
+            removalTree.insert(number, number);
+        }
+
+        Benchmark<std::chrono::nanoseconds> timer;
+        std::vector<unsigned long> indices;
+
+        for (int idx = 0; idx < sampleSize; idx++) {
+            indices.push_back(idx);
+        }
+        std::shuffle(indices.begin(), indices.end(), rng);
+
+        for (auto index : indices) {
+            removalTree.remove(randomNumbers[index]);
+        }
+
+        auto timeNanos = timer.elapsed();
+        deletionTimeNanos[sampleSize] = timeNanos;
+    }
+
+    // Bulk construction benchmark, compared with the insertion loop from the creation benchmark
+    std::map<int, size_t> bulkLoadTimeNanos;
+    std::map<int, size_t> buildFromSortedTimeNanos;
+    for (auto sampleSize : sampleSizes) {
+        std::vector<std::pair<unsigned long, unsigned long>> pairs;
+        for (int idx = 0; idx < sampleSize; idx++) {
+            pairs.emplace_back(randomNumbers[idx], randomNumbers[idx]);
+        }
+
+        AVLTree<unsigned long, unsigned long> unsortedTree;
+        Benchmark<std::chrono::nanoseconds> bulkLoadTimer;
+        unsortedTree.bulkLoad(pairs.begin(), pairs.end());
+        bulkLoadTimeNanos[sampleSize] = bulkLoadTimer.elapsed();
+
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+        AVLTree<unsigned long, unsigned long> sortedTree;
+        Benchmark<std::chrono::nanoseconds> buildTimer;
+        sortedTree.buildFromSorted(pairs.begin(), pairs.end());
+        buildFromSortedTimeNanos[sampleSize] = buildTimer.elapsed();
+    }
+
+    // Parallel bulk load benchmark, startup time by number of threads
+    std::map<size_t, size_t> parallelLoadNanos;
+    measureParallelLoad(generator, parallelLoadNanos);
+
+    // Union benchmark, merging small trees into a large one
+    std::map<size_t, size_t> unionInsertNanos, unionWithNanos;
+    measureUnion(generator, unionInsertNanos, unionWithNanos);
+
+    // Restart benchmark, rebuilding a tree by inserts compared with mapping its snapshot
+    size_t restartInsertNanos, restartLookupNanos;
+    std::pair<size_t, size_t> restartOpenNanos;
+    measureRestart(generator, restartInsertNanos, restartOpenNanos, restartLookupNanos);
+
+    // Heavyweight value benchmark, heap allocations per insert when copying, moving and constructing in place
+    std::map<int, double> copyAllocations, moveAllocations, emplaceAllocations;
+    std::map<int, size_t> copyTimeNanos, moveTimeNanos, emplaceTimeNanos;
+    typedef AVLTree<unsigned long, std::string> HeavyTree;
+    for (auto sampleSize : sampleSizes) {
+        copyAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &value) {
+                    tree.insert(key, value);
+                }, copyTimeNanos[sampleSize]);
+        moveAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &value) {
+                    tree.insert(std::move(key), std::move(value));
+                }, moveTimeNanos[sampleSize]);
+        emplaceAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &) {
+                    tree.tryEmplace(key, HEAVY_VALUE_BYTES, 'x');
+                }, emplaceTimeNanos[sampleSize]);
+    }
+
+    // Node allocator benchmark, slab pool versus one heap allocation per node
+    std::map<int, size_t> poolInsertNanos, heapInsertNanos, poolTeardownNanos, heapTeardownNanos;
+    for (auto sampleSize : sampleSizes) {
+        measureAllocator<AVLTree<unsigned long, unsigned long, ThreeWayCompare<unsigned long>, NodePool>>(
+                randomNumbers, sampleSize, poolInsertNanos[sampleSize], poolTeardownNanos[sampleSize]);
+        measureAllocator<AVLTree<unsigned long, unsigned long, ThreeWayCompare<unsigned long>, HeapAllocator>>(
+                randomNumbers, sampleSize, heapInsertNanos[sampleSize], heapTeardownNanos[sampleSize]);
+    }
+
+    // Frozen snapshot benchmark, pointer chasing versus Eytzinger layout on trees exceeding the caches
+    std::map<size_t, size_t> liveLookupNanos, frozenLookupNanos;
+    for (auto size : FROZEN_SAMPLE_SIZES) {
+        measureFrozenSearch(size, generator, liveLookupNanos[size], frozenLookupNanos[size]);
     }
 
     std::cout << "Creation time benchmark\nSize\ttime (ns)\n";
@@ -55,11 +441,84 @@ int main() {
 
     }
 
-    std::cout << "Search time benchmark\nSize\ttime (ns)\n";
-    for (it = searchTimeNanos.begin(); it != searchTimeNanos.end(); it++) {
+    std::cout << "Insert rebalancing statistics\nSize\trotations / insert\ttouched nodes / insert\n";
+    for (auto const &entry : insertStatistics) {
+        auto statistics = entry.second;
+        std::cout << entry.first << "\t"
+                  << (double) statistics.rotations / statistics.insertions << "\t"
+                  << (double) statistics.touchedNodes / statistics.insertions << std::endl;
+    }
+
+    std::cout << "Search time benchmark (findBatch of " << SEARCH_BATCH_SIZE << " keys)\n"
+              << "Size\tfind (ns)\tfindBatch (ns)\tfind (lookups/s)\tfindBatch (lookups/s)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << searchTimeNanos[sampleSize] << "\t"
+                  << batchSearchTimeNanos[sampleSize] << "\t"
+                  << throughput(sampleSize, searchTimeNanos[sampleSize]) << "\t"
+                  << throughput(sampleSize, batchSearchTimeNanos[sampleSize]) << std::endl;
+    }
+
+    std::cout << "Removal time benchmark\nSize\ttime (ns)\n";
+    for (it = deletionTimeNanos.begin(); it != deletionTimeNanos.end(); it++) {
         auto pair = *it;
         std::cout << pair.first << "\t" << pair.second << std::endl;
+    }
+
+    std::cout << "\nBulk construction benchmark\nSize\tinsert loop (ns)\tbulkLoad (ns)\tbuildFromSorted (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << creationTimeNanos[sampleSize] << "\t"
+                  << bulkLoadTimeNanos[sampleSize] << "\t"
+                  << buildFromSortedTimeNanos[sampleSize] << std::endl;
+    }
+
+    std::cout << "\nParallel bulk load benchmark (" << PARALLEL_LOAD_SIZE << " pairs)\nThreads\tbulkLoad (ns)\n";
+    for (auto const &load : parallelLoadNanos) {
+        std::cout << load.first << "\t" << load.second << std::endl;
+    }
+
+    std::cout << "\nUnion benchmark (" << UNION_BASE_SIZE << " element tree)\n"
+              << "Delta size\tinsert loop (ns)\tunionWith (ns)\n";
+    for (auto deltaSize : UNION_DELTA_SIZES) {
+        std::cout << deltaSize << "\t"
+                  << unionInsertNanos[deltaSize] << "\t"
+                  << unionWithNanos[deltaSize] << std::endl;
+    }
+
+    std::cout << "\nRestart benchmark (" << RESTART_SIZE << " elements)\n"
+              << "insert loop (ns)\topenMapped verified (ns)\topenMapped unverified (ns)\t1000 first lookups (ns)\n"
+              << restartInsertNanos << "\t" << restartOpenNanos.first << "\t" << restartOpenNanos.second << "\t"
+              << restartLookupNanos << std::endl;
+
+    std::cout << "\nHeavyweight value benchmark (" << HEAVY_VALUE_BYTES << " byte strings)\n"
+              << "Size\tcopy (allocs/insert)\tmove (allocs/insert)\ttryEmplace (allocs/insert)"
+              << "\tcopy (ns)\tmove (ns)\ttryEmplace (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << copyAllocations[sampleSize] << "\t"
+                  << moveAllocations[sampleSize] << "\t"
+                  << emplaceAllocations[sampleSize] << "\t"
+                  << copyTimeNanos[sampleSize] << "\t"
+                  << moveTimeNanos[sampleSize] << "\t"
+                  << emplaceTimeNanos[sampleSize] << std::endl;
+    }
+
+    std::cout << "\nAllocator benchmark\nSize\tpool (inserts/s)\theap (inserts/s)\tpool teardown (ns)\theap teardown (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << throughput(sampleSize, poolInsertNanos[sampleSize]) << "\t"
+                  << throughput(sampleSize, heapInsertNanos[sampleSize]) << "\t"
+                  << poolTeardownNanos[sampleSize] << "\t"
+                  << heapTeardownNanos[sampleSize] << std::endl;
+    }
 
+    std::cout << "\nFrozen snapshot benchmark (" << FROZEN_LOOKUPS << " lookups)\n"
+              << "Size\ttree (lookups/s)\tfrozen (lookups/s)\n";
+    for (auto size : FROZEN_SAMPLE_SIZES) {
+        std::cout << size << "\t"
+                  << throughput(FROZEN_LOOKUPS, liveLookupNanos[size]) << "\t"
+                  << throughput(FROZEN_LOOKUPS, frozenLookupNanos[size]) << std::endl;
     }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../benchmark/benchmark.h"
+#include "../benchmark/memory.h"
+#include "../AVLTreeLib/AVLTree.h"
+#include "../AVLTreeLib/AVLTreeSet.h"
+#include "../AVLTreeLib/CompactAVLTree.h"
+#include "../AVLTreeLib/ParentlessAVLTree.h"
+#include "../BinarySearchTreeLib/BinarySearchTree.h"
+#include "../BinarySearchTreeLib/BinarySearchTreeSet.h"
+
+/**
+ * Number of keys inserted into every tree
+ */
+const size_t KEY_COUNT = 10000000;
+
+/**
+ * Number of lookups of present keys
+ */
+const size_t LOOKUP_COUNT = 1000000;
+
+/**
+ * Number of keys of the value placement benchmark
+ */
+const size_t VALUE_KEY_COUNT = 1000000;
+
+/**
+ * Opaque value of given size
+ */
+template<size_t Bytes>
+struct Payload {
+    char bytes[Bytes];
+};
+
+/**
+ * Results of one tree
+ */
+struct Measurement {
+    size_t nodeBytes;
+    size_t residentBytes;
+    size_t insertNanos;
+    size_t findNanos;
+};
+
+/**
+ * Insert key into a map, mapping it to itself
+ */
+template<typename Tree>
+void insertKey(Tree &tree, unsigned long key) {
+    tree.insert(key, key);
+}
+
+/**
+ * Insert key into an AVL set, which stores no value
+ */
+template<typename KeyType, typename Compare, template<typename> class NodeAllocator>
+void insertKey(AVLTreeSet<KeyType, Compare, NodeAllocator> &set, unsigned long key) {
+    set.insert(key);
+}
+
+/**
+ * Insert key into a binary search tree set, which stores no value
+ */
+template<typename KeyType, typename Compare, template<typename> class NodeAllocator>
+void insertKey(BinarySearchTreeSet<KeyType, Compare, NodeAllocator> &set, unsigned long key) {
+    set.insert(key);
+}
+
+/**
+ * Insert keys into an empty tree and look some of them up, measuring time and resident memory growth
+ *
+ * @tparam Tree tree type with find and nodeBytes, supported by insertKey
+ * @param keys inserted keys
+ * @return measured values
+ */
+template<typename Tree>
+Measurement measure(std::vector<unsigned long> const &keys) {
+    Measurement result = {Tree::nodeBytes(), 0, 0, 0};
+    auto residentBefore = residentSetBytes();
+    Tree tree;
+
+    Benchmark<std::chrono::nanoseconds> insertTimer;
+    for (auto key : keys) {
+        insertKey(tree, key);
+    }
+    result.insertNanos = insertTimer.elapsed();
+    result.residentBytes = residentSetBytes() - residentBefore;
+
+    size_t found = 0;
+    Benchmark<std::chrono::nanoseconds> findTimer;
+    for (size_t idx = 0; idx < LOOKUP_COUNT; idx++) {
+        found += tree.find(keys[idx * (keys.size() / LOOKUP_COUNT)]) != nullptr;
+    }
+    result.findNanos = findTimer.elapsed();
+    if (found != LOOKUP_COUNT) {
+        std::cerr << "Lookups missed inserted keys\n";
+    }
+    return result;
+}
+
+/**
+ * Run measurement in a child process, so that memory freed by earlier trees does not hide the growth
+ *
+ * @tparam Tree measured tree type
+ * @param keys inserted keys
+ * @return measured values, zeros if the child failed
+ */
+template<typename Tree>
+Measurement measureIsolated(std::vector<unsigned long> const &keys) {
+    Measurement result = {0, 0, 0, 0};
+    int channel[2];
+    if (pipe(channel) != 0) {
+        return result;
+    }
+    auto child = fork();
+    if (child == 0) {
+        close(channel[0]);
+        auto measured = measure<Tree>(keys);
+        auto written = write(channel[1], &measured, sizeof(measured));
+        _exit(written == (ssize_t) sizeof(measured) ? 0 : 1);
+    }
+
+    close(channel[1]);
+    if (child > 0) {
+        if (read(channel[0], &result, sizeof(result)) != (ssize_t) sizeof(result)) {
+            result = {0, 0, 0, 0};
+        }
+        waitpid(child, nullptr, 0);
+    }
+    close(channel[0]);
+    return result;
+}
+
+/**
+ * Insert keys with values of given size and look some of them up, reading the first byte of every found value
+ *
+ * @tparam Tree CompactAVLTree with Payload values
+ * @param keys inserted keys, the first VALUE_KEY_COUNT are used
+ * @return measured values, resident growth is not measured
+ */
+template<typename Tree>
+Measurement measureValues(std::vector<unsigned long> const &keys) {
+    Measurement result = {Tree::nodeBytes(), 0, 0, 0};
+    Tree tree;
+    typename std::remove_pointer<decltype(tree.find(0))>::type value = {};
+
+    Benchmark<std::chrono::nanoseconds> insertTimer;
+    for (size_t idx = 0; idx < VALUE_KEY_COUNT; idx++) {
+        value.bytes[0] = (char) idx;
+        tree.insert(keys[idx], value);
+    }
+    result.insertNanos = insertTimer.elapsed();
+
+    size_t checksum = 0;
+    Benchmark<std::chrono::nanoseconds> findTimer;
+    for (size_t idx = 0; idx < LOOKUP_COUNT; idx++) {
+        auto lookupIdx = idx * (VALUE_KEY_COUNT / LOOKUP_COUNT);
+        checksum += (unsigned char) (tree.find(keys[lookupIdx])->bytes[0] - (char) lookupIdx);
+    }
+    result.findNanos = findTimer.elapsed();
+    if (checksum != 0) {
+        std::cerr << "Lookups returned wrong values\n";
+    }
+    return result;
+}
+
+/**
+ * Print inline and cold placement of values of one size
+ *
+ * @tparam Bytes size of the values
+ * @param keys inserted keys
+ */
+template<size_t Bytes>
+void compareValuePlacement(std::vector<unsigned long> const &keys) {
+    typedef CompactAVLTree<unsigned long, Payload<Bytes>> Inline;
+    typedef CompactAVLTree<unsigned long, Payload<Bytes>, ThreeWayCompare<unsigned long>, std::uint32_t,
+            ColdValues> Cold;
+    for (auto measured : {measureValues<Inline>(keys), measureValues<Cold>(keys)}) {
+        std::cout << Bytes << "\t"
+                  << (measured.nodeBytes == Inline::nodeBytes() ? "inline" : "cold") << "\t"
+                  << measured.nodeBytes << "\t"
+                  << (double) measured.insertNanos / VALUE_KEY_COUNT << "\t"
+                  << (double) measured.findNanos / LOOKUP_COUNT << std::endl;
+    }
+}
+
+/**
+ * Print one row of the results
+ */
+void printRow(std::string const &name, Measurement const &measured) {
+    std::cout << name << "\t"
+              << measured.nodeBytes << "\t"
+              << measured.residentBytes / (1024 * 1024) << "\t"
+              << (double) measured.residentBytes / KEY_COUNT << "\t"
+              << (double) measured.insertNanos / KEY_COUNT << "\t"
+              << (double) measured.findNanos / LOOKUP_COUNT << std::endl;
+}
+
+int main() {
+    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 generator((unsigned long) seed);
+    std::vector<unsigned long> keys;
+    for (size_t idx = 0; idx < KEY_COUNT; idx++) {
+        keys.push_back((unsigned long) generator() << 32 | generator());
+    }
+
+    auto pointerAVL = measureIsolated<AVLTree<unsigned long, unsigned long>>(keys);
+    auto compactAVL = measureIsolated<CompactAVLTree<unsigned long, unsigned long>>(keys);
+    auto parentlessAVL = measureIsolated<ParentlessAVLTree<unsigned long, unsigned long>>(keys);
+    auto pointerBST = measureIsolated<BinarySearchTree<unsigned long, unsigned long>>(keys);
+    auto setAVL = measureIsolated<AVLTreeSet<unsigned long>>(keys);
+    auto setBST = measureIsolated<BinarySearchTreeSet<unsigned long>>(keys);
+
+    std::cout << "Node layout benchmark (" << KEY_COUNT << " unsigned long keys, maps store equal values)\n"
+              << "Tree\tnode (bytes)\tresident growth (MiB)\tresident / key (bytes)\tinsert (ns)\tfind (ns)\n";
+    printRow("AVLTree", pointerAVL);
+    printRow("CompactAVLTree", compactAVL);
+    printRow("ParentlessAVLTree", parentlessAVL);
+    printRow("BinarySearchTree", pointerBST);
+    printRow("AVLTreeSet", setAVL);
+    printRow("BinarySearchTreeSet", setBST);
+
+    std::cout << "\nValue placement benchmark (" << VALUE_KEY_COUNT << " keys, CompactAVLTree)\n"
+              << "value (bytes)\tvalues\tnode (bytes)\tinsert (ns)\tfind (ns)\n";
+    compareValuePlacement<64>(keys);
+    compareValuePlacement<128>(keys);
+    compareValuePlacement<256>(keys);
+    compareValuePlacement<512>(keys);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../benchmark/benchmark.h"
+#include "../AVLTreeLib/AVLTree.h"
+#include "../AVLTreeLib/ConcurrentAVLTree.h"
+
+/**
+ * Number of keys in the tree during the measurements
+ */
+const size_t TREE_SIZE = 1000000;
+
+/**
+ * Number of operations performed by every thread
+ */
+const size_t OPERATIONS_PER_THREAD = 1000000;
+
+/**
+ * Percentage of writes in the mixed workload
+ */
+const unsigned MIXED_WRITE_PERCENT = 10;
+
+/**
+ * AVLTree behind a single mutex, the way it has to be shared between threads without ConcurrentAVLTree
+ */
+class LockedAVLTree {
+private:
+    AVLTree<unsigned long, unsigned long> tree;
+    std::mutex mutex;
+
+public:
+    void insert(unsigned long key, unsigned long value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tree.insert(key, value);
+    }
+
+    void remove(unsigned long key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tree.remove(key);
+    }
+
+    bool find(unsigned long key, unsigned long &value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = tree.find(key);
+        if (found != nullptr) {
+            value = *found;
+        }
+        return found != nullptr;
+    }
+};
+
+/**
+ * Measure throughput of threads sharing one tree
+ *
+ * Every thread looks up random keys of the tree, a writePercent share of the operations removes a key and inserts
+ * it back, so the tree keeps its size
+ *
+ * @tparam TreeType shared tree with insert, remove and find(key, value)
+ * @param keys keys of the tree
+ * @param threadCount number of threads
+ * @param writePercent percentage of write operations
+ * @return operations per second over all threads
+ */
+template<typename TreeType>
+double measureThreads(std::vector<unsigned long> const &keys, size_t threadCount, unsigned writePercent) {
+    TreeType tree;
+    for (auto key : keys) {
+        tree.insert(key, key);
+    }
+
+    std::atomic<bool> started(false);
+    std::atomic<size_t> foundKeys(0);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < threadCount; thread++) {
+        threads.emplace_back([&tree, &keys, &started, &foundKeys, thread, writePercent]() {
+            std::mt19937 generator((unsigned) thread);
+            size_t found = 0;
+            unsigned long value = 0;
+            while (!started.load()) {
+                std::this_thread::yield();
+            }
+
+            for (size_t operation = 0; operation < OPERATIONS_PER_THREAD; operation++) {
+                auto key = keys[generator() % keys.size()];
+                if (generator() % 100 < writePercent) {
+                    tree.remove(key);
+                    tree.insert(key, key);
+                } else {
+                    found += tree.find(key, value);
+                }
+            }
+            foundKeys.fetch_add(found);
+        });
+    }
+
+    Benchmark<std::chrono::nanoseconds> timer;
+    started.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto nanos = timer.elapsed();
+
+    // Found keys are consumed so the lookups cannot be optimized away
+    if (foundKeys.load() > threadCount * OPERATIONS_PER_THREAD) {
+        std::cerr << "More keys found than looked up\n";
+    }
+    return nanos == 0 ? 0.0 : threadCount * OPERATIONS_PER_THREAD * 1e9 / nanos;
+}
+
+int main() {
+    size_t maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 generator((unsigned long) seed);
+    std::vector<unsigned long> keys;
+    for (size_t i = 0; i < TREE_SIZE; i++) {
+        keys.push_back((unsigned long) generator() << 32 | generator());
+    }
+
+    std::map<size_t, double> lockedReads, concurrentReads, lockedMixed, concurrentMixed;
+    for (auto threads : threadCounts) {
+        lockedReads[threads] = measureThreads<LockedAVLTree>(keys, threads, 0);
+        concurrentReads[threads] = measureThreads<ConcurrentAVLTree<unsigned long, unsigned long>>(keys, threads, 0);
+        lockedMixed[threads] = measureThreads<LockedAVLTree>(keys, threads, MIXED_WRITE_PERCENT);
+        concurrentMixed[threads] = measureThreads<ConcurrentAVLTree<unsigned long, unsigned long>>(
+                keys, threads, MIXED_WRITE_PERCENT);
+    }
+
+    std::cout << "Read-only throughput, " << TREE_SIZE << " keys\n"
+              << "Threads\tmutex AVL (ops/s)\tconcurrent AVL (ops/s)\n";
+    for (auto threads : threadCounts) {
+        std::cout << threads << "\t" << lockedReads[threads] << "\t" << concurrentReads[threads] << std::endl;
+    }
+
+    std::cout << "Mixed throughput, " << MIXED_WRITE_PERCENT << "% of operations remove and reinsert a key\n"
+              << "Threads\tmutex AVL (ops/s)\tconcurrent AVL (ops/s)\n";
+    for (auto threads : threadCounts) {
+        std::cout << threads << "\t" << lockedMixed[threads] << "\t" << concurrentMixed[threads] << std::endl;
+    }
+    return 0;
+}
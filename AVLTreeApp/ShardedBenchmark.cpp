@@ -0,0 +1,99 @@
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../benchmark/benchmark.h"
+#include "../AVLTreeLib/ShardedTree.h"
+
+/**
+ * Number of keys inserted in every measurement, split evenly between the threads
+ */
+const size_t INSERTED_KEYS = 1000000;
+
+/**
+ * Number of shards of the partitioned trees
+ */
+const size_t SHARD_COUNT = 64;
+
+typedef ShardedTree<unsigned long, unsigned long> Tree;
+
+/**
+ * Measure throughput of threads inserting disjoint slices of keys into one tree
+ *
+ * @param tree empty tree
+ * @param keys inserted keys
+ * @param threadCount number of threads
+ * @return insertions per second over all threads
+ */
+double measureInserts(Tree &tree, std::vector<unsigned long> const &keys, size_t threadCount) {
+    std::atomic<bool> started(false);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < threadCount; thread++) {
+        threads.emplace_back([&tree, &keys, &started, thread, threadCount]() {
+            while (!started.load()) {
+                std::this_thread::yield();
+            }
+            for (size_t idx = thread; idx < keys.size(); idx += threadCount) {
+                tree.insert(keys[idx], keys[idx]);
+            }
+        });
+    }
+
+    Benchmark<std::chrono::nanoseconds> timer;
+    started.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    auto nanos = timer.elapsed();
+
+    if (tree.size() > keys.size()) {
+        std::cerr << "Tree holds more keys than inserted\n";
+    }
+    return nanos == 0 ? 0.0 : keys.size() * 1e9 / nanos;
+}
+
+int main() {
+    size_t maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 generator((unsigned long) seed);
+    std::vector<unsigned long> keys;
+    for (size_t i = 0; i < INSERTED_KEYS; i++) {
+        keys.push_back((unsigned long) generator() << 32 | generator());
+    }
+
+    // Uniform keys make equal-width ranges equally loaded
+    std::vector<unsigned long> splitKeys;
+    for (size_t shard = 1; shard < SHARD_COUNT; shard++) {
+        splitKeys.push_back(std::numeric_limits<unsigned long>::max() / SHARD_COUNT * shard);
+    }
+
+    std::map<size_t, double> singleInserts, hashInserts, rangeInserts;
+    for (auto threads : threadCounts) {
+        Tree single(1);
+        singleInserts[threads] = measureInserts(single, keys, threads);
+        Tree hashed(SHARD_COUNT);
+        hashInserts[threads] = measureInserts(hashed, keys, threads);
+        Tree ranged(splitKeys);
+        rangeInserts[threads] = measureInserts(ranged, keys, threads);
+    }
+
+    std::cout << "Insert throughput, " << INSERTED_KEYS << " keys, " << SHARD_COUNT << " shards\n"
+              << "Threads\tsingle locked tree (ops/s)\thash sharded (ops/s)\trange sharded (ops/s)\n";
+    for (auto threads : threadCounts) {
+        std::cout << threads << "\t" << singleInserts[threads] << "\t" << hashInserts[threads] << "\t"
+                  << rangeInserts[threads] << std::endl;
+    }
+    return 0;
+}
@@ -1,10 +1,26 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <ostream>
 #include <iomanip>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/FrozenTree.h"
+#include "../CommonLib/MappedTree.h"
+#include "../CommonLib/NodePool.h"
+#include "../CommonLib/NodeValue.h"
+#include "../CommonLib/Parallel.h"
+#include "../CommonLib/Prefetch.h"
+#include "../CommonLib/TreeIterator.h"
 
 
 /**
@@ -15,41 +31,63 @@
  *
  * @tparam KeyType type of the keys
  * @tparam ValueType type of the values
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam NodeAllocator allocator of the tree's nodes (NodePool or HeapAllocator)
  */
-template<typename KeyType, typename ValueType>
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
 class AVLTree {
+public:
+
+    /**
+     * Counters of the rebalancing work done by insertions
+     */
+    struct InsertStatistics {
+        /**
+         * Number of insert calls
+         */
+        size_t insertions;
+
+        /**
+         * Number of single rotations, double rotation counts as two
+         */
+        size_t rotations;
+
+        /**
+         * Number of nodes whose height and balance were recalculated
+         */
+        size_t touchedNodes;
+    };
+
 private:
 
     /**
      * Node of an AVL tree
      *
-     * Stores key, value and pointers to the parent and children
+     * Stores key, value, pointers to the parent and children and the number of nodes in its subtree,
+     * the value lives in the NodeValue base and takes no space in sets
      *
      * @tparam KeyType type of keys used for comparison
      * @tparam ValueType type of values
      */
-    struct Node {
+    struct Node : NodeValue<ValueType> {
         KeyType key;
-        ValueType value;
         int height;
+        size_t subtreeSize;
         Node *leftChild;
         Node *rightChild;
         Node *parent;
 
 
         /**
-         * Initialize node with given parent
+         * Initialize node with given parent, key and value are constructed in place
          *
-         * @param key key
-         * @param value value
          * @param parent node's parent node
+         * @param key argument for constructing the key
+         * @param valueArgs arguments for constructing the value
          */
-        Node(KeyType key, ValueType const &value, Node *parent = nullptr);
-
-        /**
-         * Destroy node and its children recursively
-         */
-        ~Node();
+        template<typename K, typename... Args>
+        Node(Node *parent, K &&key, Args &&... valueArgs);
 
         /**
          * Difference of subtree heights (left - right)
@@ -74,11 +112,26 @@ private:
          */
         std::string toString(std::string const &separator) const;
 
+        /**
+         * Write representation [<key>,<separator><value>] directly to a stream
+         *
+         * @tparam StreamType type of the output stream
+         * @param stream output stream
+         * @param separator inserted before the value
+         */
+        template<typename StreamType>
+        void write(StreamType &stream, char const *separator) const;
+
         /**
          * Recalculate node's height recursively
          */
         void updateHeight();
 
+        /**
+         * Recalculate number of nodes in the subtree from children's counts
+         */
+        void updateSubtreeSize();
+
         /**
          * Utility for accessing node's height, null safe
          *
@@ -86,6 +139,14 @@ private:
          * @return height of the subtree with given root (0 for nullptr)
          */
         static int nodeHeight(Node const *node);
+
+        /**
+         * Utility for accessing number of nodes in a subtree, null safe
+         *
+         * @param node root node of a tree
+         * @return number of nodes in the subtree with given root (0 for nullptr)
+         */
+        static size_t nodeSubtreeSize(Node const *node);
     };
 
     /**
@@ -93,24 +154,331 @@ private:
      */
     Node *root;
 
+    /**
+     * Allocator owning all nodes of the tree
+     */
+    NodeAllocator<Node> nodeAllocator;
+
+    /**
+     * Three-way comparator of the keys, called once per visited node
+     */
+    Compare compare;
+
+    /**
+     * Rebalancing work done by insertions since construction or the last reset
+     */
+    InsertStatistics insertStatistics;
+
+    /**
+     * Destroy all nodes of a subtree and give them back to the allocator
+     *
+     * Iterative, flattens the subtree with right rotations instead of using a stack
+     *
+     * @param subRoot root node of the subtree to destroy
+     */
+    void destroySubtree(Node *subRoot);
+
+    /**
+     * Destroy all nodes of a subtree created by given allocator
+     *
+     * @param subRoot root node of the subtree to destroy
+     * @param allocator allocator the nodes are given back to
+     */
+    static void destroySubtree(Node *subRoot, NodeAllocator<Node> &allocator);
+
+    /**
+     * Position of a key in the tree
+     *
+     * Link points to the node with the key, or is the empty child link where a node with the key belongs
+     */
+    struct InsertionPoint {
+        Node *parent;
+        Node **link;
+    };
+
+    /**
+     * Descend iteratively to the node with given key or to the place where it should be inserted
+     *
+     * @param key searched key
+     * @return link to the node with the key or to the empty place for it
+     */
+    InsertionPoint findInsertionPoint(KeyType const &key);
+
+    /**
+     * Link new node at an empty insertion point and restore AVL property
+     *
+     * Walks back up through parent pointers. Heights are recalculated only until a subtree's height
+     * does not change or a rotation restores it, so at most one (single or double) rotation is performed,
+     * above that only subtree sizes are incremented
+     *
+     * @param point empty link found by findInsertionPoint
+     * @param node new node, constructed with point's parent as its parent
+     */
+    void attachNode(InsertionPoint point, Node *node);
+
+    /**
+     * Insert key-value pair or replace value of an existing key, arguments are perfectly forwarded
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    template<typename K, typename V>
+    void insertOrAssign(K &&key, V &&value);
 
     /**
-     * Insert given key-value pair into subtree with subRoot as its root node
+     * Construct value in place if the key is not present yet, arguments are perfectly forwarded
      *
-     * @param key key to insert
-     * @param value value to insert
-     * @param subRoot root of the subtree to insert into
+     * @param key key mapping to the value
+     * @param valueArgs arguments for constructing the value
+     * @return pointer to the value with given key and whether it was inserted
      */
-    void insertIntoSubtree(KeyType const &key, ValueType const &value, Node *subRoot);
+    template<typename K, typename... Args>
+    std::pair<ValueType *, bool> emplaceIfAbsent(K &&key, Args &&... valueArgs);
 
     /**
      * Restore AVL property of a subtree - each node has balance factor in range [-1, 1] (inclusive)
      *
-     * @param insertedKey key from the most recent insertion that may have violated AVL property
+     * Single or double rotation is chosen by the balance factor of the taller child,
+     * so it applies after both insertion and removal
+     *
      * @param subRoot root node of the tree to rebalance
+     * @return root node of the subtree after rebalancing
+     */
+    Node *rebalance(Node *subRoot);
+
+    /**
+     * Restore heights, subtree sizes and AVL property on the path from given node to the root after removal
+     *
+     * Rebalancing stops as soon as a subtree's height is the same as before the removal,
+     * only subtree sizes are updated above that point
+     *
+     * @param subRoot lowest node whose subtree lost a node
+     */
+    void rebalanceAfterRemoval(Node *subRoot);
+
+    /**
+     * Put newChild in place of oldChild under given parent, or as the tree's root if parent is nullptr
+     *
+     * @param parent parent of the replaced node
+     * @param oldChild replaced node
+     * @param newChild replacement, may be nullptr
+     */
+    void replaceChild(Node *parent, Node *oldChild, Node *newChild);
+
+    /**
+     * Build perfectly balanced subtree out of the next count elements of a sorted sequence
+     *
+     * Elements are consumed in order, left subtree first, so any forward iterator works. If creating a node throws,
+     * the nodes already created for the subtree are destroyed before the exception propagates
+     *
+     * @tparam ForwardIterator iterator over key-value pairs
+     * @param current position of the subtree's smallest element, advanced past its largest one
+     * @param count number of elements in the subtree
+     * @param parent parent of the subtree's root
+     * @param allocator allocator of the subtree's nodes, a concurrent build gives each thread its own
+     * @return root node of the built subtree
+     */
+    template<typename ForwardIterator>
+    Node *buildSubtree(ForwardIterator &current, size_t count, Node *parent, NodeAllocator<Node> &allocator);
+
+    /**
+     * Subtree of a concurrent build left for one thread
+     */
+    template<typename ForwardIterator>
+    struct BuildTask {
+        ForwardIterator first;
+        size_t count;
+        Node *parent;
+        Node **link;
+    };
+
+    /**
+     * Create the top levels of a balanced subtree until every thread has an independent subtree to build
+     *
+     * Medians are chosen exactly like in buildSubtree, so the result has the same shape as a sequential build
+     *
+     * @tparam ForwardIterator iterator over key-value pairs
+     * @param first position of the subtree's smallest element
+     * @param count number of elements in the subtree
+     * @param parent parent of the subtree's root
+     * @param link link the subtree's root is stored to
+     * @param threadCount number of threads left for the subtree
+     * @param tasks output, subtrees left for the threads
+     * @param splitNodes output, created nodes in pre-order
+     */
+    template<typename ForwardIterator>
+    void splitBuild(ForwardIterator first, size_t count, Node *parent, Node **link, size_t threadCount,
+                    std::vector<BuildTask<ForwardIterator>> &tasks, std::vector<Node *> &splitNodes);
+
+    /**
+     * Copy structure of a subtree, including heights and subtree sizes, into nodes of this tree's allocator
+     *
+     * Iterative, nodes are reserved in one batch before copying
+     *
+     * @param source root node of the copied subtree, may belong to another tree
+     * @return root node of the copy
+     */
+    Node *cloneSubtree(Node const *source);
+
+    /**
+     * Pieces of a subtree split around a key
+     */
+    struct SplitResult {
+        /**
+         * Subtree of keys less than the key
+         */
+        Node *less;
+
+        /**
+         * Detached node with the key or nullptr if the key is not present
+         */
+        Node *equal;
+
+        /**
+         * Subtree of keys greater than the key
+         */
+        Node *greater;
+    };
+
+    /**
+     * Make node the root of a subtree with given children, recalculating its height and size
+     *
+     * Children have to be balanced and differ in height by at most 1
+     *
+     * @param subRoot node becoming the root, its parent is reset
+     * @param left new left subtree
+     * @param right new right subtree
+     * @return subRoot
+     */
+    static Node *linkNode(Node *subRoot, Node *left, Node *right);
+
+    /**
+     * Detach subtree from its parent
+     *
+     * @param subRoot root node of the subtree, may be nullptr
+     * @return subRoot
+     */
+    static Node *detach(Node *subRoot);
+
+    /**
+     * Join two subtrees and a node with a key between theirs into a balanced subtree
+     *
+     * Descends along the spine of the taller subtree to the height of the shorter one, O(height difference)
+     *
+     * @param left subtree with keys less than the middle key
+     * @param middle detached node
+     * @param right subtree with keys greater than the middle key
+     * @return root node of the joined subtree, without parent
+     */
+    static Node *joinNodes(Node *left, Node *middle, Node *right);
+
+    /**
+     * Join step for a left subtree taller than the right one by more than 1
      */
-    void rebalance(KeyType const &insertedKey, Node *subRoot);
+    static Node *joinRight(Node *left, Node *middle, Node *right);
 
+    /**
+     * Join step for a right subtree taller than the left one by more than 1
+     */
+    static Node *joinLeft(Node *left, Node *middle, Node *right);
+
+    /**
+     * Join two subtrees, all keys of left less than all keys of right, the largest node of left becomes the middle
+     *
+     * @param left subtree with the smaller keys
+     * @param right subtree with the greater keys
+     * @return root node of the joined subtree, without parent
+     */
+    static Node *joinTwo(Node *left, Node *right);
+
+    /**
+     * Detach the node with the largest key of a subtree
+     *
+     * @param subRoot root node of the subtree, not null
+     * @param maximum set to the detached node
+     * @return root node of the remaining subtree
+     */
+    static Node *splitLast(Node *subRoot, Node *&maximum);
+
+    /**
+     * Split subtree around a key into subtrees of smaller and greater keys, O(log n)
+     *
+     * @param subRoot root node of the subtree, detached from its parent
+     * @param key splitting key
+     * @return balanced subtrees of smaller and greater keys and the node with the key itself
+     */
+    SplitResult splitNodes(Node *subRoot, KeyType const &key) const;
+
+    /**
+     * Collect all nodes of a subtree
+     *
+     * @param subRoot root node of the subtree
+     * @param nodes output, receives the nodes
+     */
+    static void collectNodes(Node *subRoot, std::vector<Node *> &nodes);
+
+    /**
+     * Union of two subtrees of this tree's allocator, nodes of other replace nodes of subRoot with equal keys
+     *
+     * @param subRoot root node of the first subtree
+     * @param other root node of the second subtree
+     * @param discarded output, replaced nodes
+     * @param threadCount number of threads for the recursion
+     * @return root node of the union
+     */
+    Node *unionNodes(Node *subRoot, Node *other, std::vector<Node *> &discarded, size_t threadCount) const;
+
+    /**
+     * Intersection of a subtree with a read-only subtree, nodes of the result come from subRoot
+     *
+     * @param subRoot root node of the modified subtree
+     * @param other root node of the read-only subtree, may belong to another tree
+     * @param discarded output, nodes whose keys are missing in other
+     * @param threadCount number of threads for the recursion
+     * @return root node of the intersection
+     */
+    Node *intersectNodes(Node *subRoot, Node const *other, std::vector<Node *> &discarded, size_t threadCount) const;
+
+    /**
+     * Difference of a subtree and a read-only subtree
+     *
+     * @param subRoot root node of the modified subtree
+     * @param other root node of the read-only subtree, may belong to another tree
+     * @param discarded output, nodes whose keys are present in other
+     * @param threadCount number of threads for the recursion
+     * @return root node of the difference
+     */
+    Node *differenceNodes(Node *subRoot, Node const *other, std::vector<Node *> &discarded, size_t threadCount) const;
+
+    /**
+     * Run two independent recursive steps of a set operation, concurrently if they are large enough
+     *
+     * @param size combined size of the inputs of both steps
+     * @param threadCount number of threads available to both steps
+     * @param discarded output, nodes discarded by both steps
+     * @param step callable (std::vector<Node *> &discarded, size_t threadCount, bool isLeft) returning step's root
+     * @param left output, result of the left step
+     * @param right output, result of the right step
+     */
+    template<typename Step>
+    static void runSetSteps(size_t size, size_t threadCount, std::vector<Node *> &discarded, Step step,
+                            Node *&left, Node *&right);
+
+
+    /**
+     * Smallest combined input of a set operation step worth running on a separate thread
+     */
+    static const size_t PARALLEL_SET_GRAIN = 8192;
+
+    /**
+     * Smallest subtree worth building on a separate thread
+     */
+    static const size_t PARALLEL_BUILD_GRAIN = 16384;
+
+    /**
+     * Number of descents advanced together by findBatch, enough independent loads to cover memory latency
+     */
+    static const size_t BATCH_WIDTH = 16;
 
     /**
      * Number of spaces per nesting level when displaying tree
@@ -146,47 +514,78 @@ private:
      * @param subRoot root node of the scanned subtree
      * @return pointer to value associated with key or nullptr if not found
      */
-    static ValueType *findInSubtree(KeyType const &key, Node *subRoot);
+    ValueType *findInSubtree(KeyType const &key, Node *subRoot) const;
 
     /**
-     * Get number of elements stored in a subtree
+     * Count keys not greater than given key
      *
-     * @param subRoot root node of the subtree
-     * @return number of nodes in the subtree
+     * @param key upper bound (inclusive)
+     * @return number of keys k such that k <= key
+     */
+    size_t countNotGreater(KeyType const &key) const;
+
+    /**
+     * Find node with the smallest key not less than (or greater than) given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @param includeKey whether a node with the key itself qualifies
+     * @return found node or nullptr if there is none
+     */
+    Node *boundNode(KeyType const &key, bool includeKey) const;
+
+    /**
+     * Find node with the largest key not greater than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return found node or nullptr if there is none
      */
-    static size_t sizeSubtree(Node const *subRoot);
+    Node *floorNode(KeyType const &key) const;
 
     /**
-     * Recursively print subtree on given indentation level
+     * Print subtree one node per line, iterative pre-order traversal writing directly to the stream
+     *
+     * Children deeper than maxDepth levels are replaced by a "..." line. With bounds given, only nodes with keys
+     * in [lo, hi] are printed, still indented by their depth, and subtrees outside the range are not visited.
      *
      * @tparam StreamType type of the output stream
      * @param stream output stream
      * @param subRoot root node of the subtree to print
-     * @param indent number of spaces
-     * @param prefix prefix inserted before node (Left/Right)
+     * @param maxDepth number of printed levels
+     * @param lo lower bound of printed keys or nullptr
+     * @param hi upper bound of printed keys or nullptr
      */
     template<typename StreamType>
-    static void printSubtree(StreamType &stream, Node const *subRoot, int indent, std::string const &prefix);
+    void printSubtree(StreamType &stream, Node const *subRoot, size_t maxDepth,
+                      KeyType const *lo, KeyType const *hi) const;
 
     /**
-     * Return string representation of the subtree in pre-order traversal
+     * Write representation of the subtree in pre-order traversal, iteratively and directly to the stream
      *
+     * @tparam StreamType type of the output stream
+     * @param stream output stream
      * @param subRoot root node of the subtree
-     * @return string representation in pre-order traversal
+     * @param maxDepth number of written levels, deeper subtrees are written as "..."
      */
-    static std::string toStringSubtree(Node const *subRoot);
+    template<typename StreamType>
+    static void writeSubtree(StreamType &stream, Node const *subRoot, size_t maxDepth);
+
+
+public:
 
     /**
-     * Get string made of given number of spaces
-     * utility for displaying trees
-     *
-     * @param spaces number of spaces
-     * @return string made of given number of spaces
+     * Bidirectional in-order iterator, dereferences to a pair of references (key, value)
      */
-    static std::string indentWhitespace(int spaces);
+    using Iterator = TreeIterator<Node, KeyType, ValueType, false>;
 
+    /**
+     * Bidirectional in-order iterator with read-only values
+     */
+    using ConstIterator = TreeIterator<Node, KeyType, ValueType, true>;
 
-public:
+    /**
+     * Stateful position in the tree which can seek a key and step in both directions
+     */
+    using Cursor = TreeCursor<Node, KeyType, ValueType, Compare>;
 
     /**
      * Initialize empty tree
@@ -194,120 +593,1168 @@ public:
     AVLTree();
 
     /**
-     * Destroy tree
+     * Initialize empty tree ordered by given comparator
      *
-     * Destroys all nodes recursively
+     * @param compare three-way comparator of the keys
      */
-    ~AVLTree();
+    explicit AVLTree(Compare const &compare);
 
     /**
-     * Get number of elements stored in the tree
+     * Copy another tree node by node, preserving its shape - no insertions nor rotations, O(n)
      *
-     * @return number of elements stored in the tree
+     * @param other copied tree
      */
-    size_t size() const;
+    AVLTree(AVLTree const &other);
 
     /**
-     * Insert key-value pair into the tree
-     * If the key already exists, its corresponding value gets replaced
-     * Maintains AVL property - each node has a balance factor in range [-1, 1] (inclusive)
+     * Take over nodes of another tree in O(1), leaving it empty
      *
-     * @param key key mapping to the value
-     * @param value mapped value
+     * @param other moved tree
      */
-    void insert(KeyType const &key, ValueType const &value);
+    AVLTree(AVLTree &&other) noexcept;
 
     /**
-     * Find value related to the given key
+     * Replace contents with a copy of another tree, O(n)
      *
-     * @param key key mapped to searched value
-     * @return pointer to the value or nullptr if not found
+     * @param other copied tree
+     * @return this tree
      */
-    ValueType *find(KeyType const &key);
+    AVLTree &operator=(AVLTree const &other);
 
     /**
-     * String representation of the tree in pre-order traversal
-     * @return pre-order traversal string
+     * Replace contents with nodes of another tree in O(1), leaving it empty
+     *
+     * @param other moved tree
+     * @return this tree
      */
-    std::string toString() const;
+    AVLTree &operator=(AVLTree &&other) noexcept;
 
     /**
-     * Display tree (pre-order traversal) to a stream
+     * Destroy tree
      *
-     * @tparam StreamType type of output stream
-     * @param stream output stream
+     * Destroys all nodes, see clear
      */
-    template<typename StreamType>
-    void print(StreamType &stream) const;
-
+    ~AVLTree();
 
-};
+    /**
+     * Remove all elements from the tree
+     *
+     * Nodes are destroyed one by one unless the allocator releases memory in bulk
+     * and the nodes are trivially destructible, then all slabs are freed at once
+     */
+    void clear();
 
-template<typename KeyType, typename ValueType>
-void AVLTree<KeyType, ValueType>::Node::updateHeight() {
-    this->height = 1 + std::max(
-            Node::nodeHeight(this->leftChild),
-            Node::nodeHeight(this->rightChild)
-    );
-}
+    /**
+     * Replace tree's contents with key-value pairs from a range sorted by strictly increasing keys
+     *
+     * Builds perfectly balanced tree in O(n) without any rotations. With more threads the top levels are created
+     * first and the independent subtrees below them are built concurrently, each into its own allocator
+     * which the tree's allocator adopts afterwards.
+     *
+     * @tparam ForwardIterator iterator over pairs (first - key, second - value), random access avoids
+     *                         linear skipping to the medians of a concurrent build
+     * @param first beginning of the sorted range
+     * @param last end of the sorted range
+     * @param threadCount maximal number of threads building the tree
+     */
+    template<typename ForwardIterator>
+    void buildFromSorted(ForwardIterator first, ForwardIterator last, size_t threadCount = 1);
 
-template<typename KeyType, typename ValueType>
-AVLTree<KeyType, ValueType>::Node::Node(KeyType key, ValueType const &value, Node *parent) {
-    height = 1;
-    this->parent = parent;
-    this->leftChild = nullptr;
-    this->rightChild = nullptr;
-    this->key = key;
-    this->value = value;
-}
+    /**
+     * Replace tree's contents with key-value pairs from an unsorted range
+     *
+     * Pairs are sorted in O(n log n) and the tree is built with buildFromSorted,
+     * both steps use up to threadCount threads
+     *
+     * @tparam InputIterator iterator over pairs (first - key, second - value)
+     * @param first beginning of the range
+     * @param last end of the range
+     * @param deduplicate whether to drop repeated keys, the last pair with given key wins;
+     *                    if false the caller guarantees the keys are unique
+     * @param threadCount maximal number of threads sorting the pairs and building the tree
+     */
+    template<typename InputIterator>
+    void bulkLoad(InputIterator first, InputIterator last, bool deduplicate = true, size_t threadCount = 1);
 
+    /**
+     * Append all elements of a tree whose keys are all greater than this tree's keys, O(log n)
+     *
+     * This tree's allocator adopts the other one's nodes, no element is copied
+     *
+     * @param greater tree with greater keys, left empty
+     */
+    void join(AVLTree &&greater);
 
-template<typename KeyType, typename ValueType>
-AVLTree<KeyType, ValueType>::Node::~Node() {
-    delete leftChild;
-    delete rightChild;
-}
+    /**
+     * Move all elements with keys not less than given key into a new tree
+     *
+     * The tree is split in O(log n). With an allocator transferring single nodes (HeapAllocator) the greater part
+     * is relinked into the returned tree as is. Nodes of a NodePool cannot leave their slabs, so with the pool
+     * the elements of the greater part are moved into nodes of the returned tree in O(k) for k moved elements
+     *
+     * @param key smallest key of the returned tree
+     * @return tree with all keys k such that k >= key
+     */
+    AVLTree split(KeyType const &key);
 
+    /**
+     * Add all elements of another tree, values of other win for keys present in both
+     *
+     * Join-based union in O(m log(n/m + 1)) for trees of sizes m <= n, nodes of other are relinked into this tree,
+     * the two halves of every step are processed concurrently while threads are available
+     *
+     * @param other merged tree, left empty
+     * @param threadCount maximal number of threads
+     */
+    void unionWith(AVLTree &&other, size_t threadCount = 1);
 
-template<typename KeyType, typename ValueType>
-int AVLTree<KeyType, ValueType>::Node::getBalance() const {
+    /**
+     * Keep only keys also present in another tree, values stay the ones of this tree
+     *
+     * @param other read-only tree
+     * @param threadCount maximal number of threads
+     */
+    void intersectWith(AVLTree const &other, size_t threadCount = 1);
+
+    /**
+     * Remove all keys present in another tree
+     *
+     * @param other read-only tree
+     * @param threadCount maximal number of threads
+     */
+    void differenceWith(AVLTree const &other, size_t threadCount = 1);
+
+    /**
+     * Get number of elements stored in the tree
+     *
+     * Constant time, read from the root's subtree size
+     *
+     * @return number of elements stored in the tree
+     */
+    size_t size() const;
+
+    /**
+     * Get memory taken by one node, links and bookkeeping included, without allocator overhead
+     *
+     * @return size of a node in bytes
+     */
+    static size_t nodeBytes();
+
+    /**
+     * Get number of keys strictly less than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return number of keys k such that k < key
+     */
+    size_t rank(KeyType const &key) const;
+
+    /**
+     * Get k-th smallest key (0-based)
+     *
+     * @param k position of the key in sorted order
+     * @return pointer to the key or nullptr if k >= size()
+     */
+    KeyType const *select(size_t k) const;
+
+    /**
+     * Count keys in range [lo, hi] (inclusive)
+     *
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @return number of keys k such that lo <= k <= hi
+     */
+    size_t countInRange(KeyType const &lo, KeyType const &hi) const;
+
+    /**
+     * Get rebalancing work done by insertions since construction or the last reset
+     *
+     * @return insertion counters
+     */
+    InsertStatistics const &getInsertStatistics() const;
+
+    /**
+     * Zero insertion counters
+     */
+    void resetInsertStatistics();
+
+    /**
+     * Insert key-value pair into the tree
+     * If the key already exists, its corresponding value gets replaced
+     * Maintains AVL property - each node has a balance factor in range [-1, 1] (inclusive)
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Insert key-value pair into the tree, moving them into the node
+     * If the key already exists, its corresponding value gets replaced
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType &&key, ValueType &&value);
+
+    /**
+     * Construct key and value in place inside a new node, like std::map::emplace
+     * If the key already exists, the tree is not modified and the new node is discarded
+     *
+     * @param key argument for constructing the key
+     * @param valueArgs arguments for constructing the value
+     * @return pointer to the value with given key and whether it was inserted
+     */
+    template<typename K, typename... Args>
+    std::pair<ValueType *, bool> emplace(K &&key, Args &&... valueArgs);
+
+    /**
+     * Construct value in place if the key is not present, like std::map::try_emplace
+     * If the key already exists, arguments are left untouched and no value is constructed
+     *
+     * @param key key mapping to the value
+     * @param valueArgs arguments for constructing the value
+     * @return pointer to the value with given key and whether it was inserted
+     */
+    template<typename... Args>
+    std::pair<ValueType *, bool> tryEmplace(KeyType const &key, Args &&... valueArgs);
+
+    /**
+     * Construct value in place if the key is not present, moving the key into the node
+     *
+     * @param key key mapping to the value
+     * @param valueArgs arguments for constructing the value
+     * @return pointer to the value with given key and whether it was inserted
+     */
+    template<typename... Args>
+    std::pair<ValueType *, bool> tryEmplace(KeyType &&key, Args &&... valueArgs);
+
+    /**
+     * Remove key and its value from the tree, does nothing if the key is not present
+     * Maintains AVL property - each node has a balance factor in range [-1, 1] (inclusive)
+     *
+     * @param key key to remove
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Find value related to the given key
+     *
+     * @param key key mapped to searched value
+     * @return pointer to the value or nullptr if not found
+     */
+    ValueType *find(KeyType const &key);
+
+    /**
+     * Check whether the key is present in the tree
+     *
+     * @param key searched key
+     * @return true if the tree contains the key
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Find values of many keys at once
+     *
+     * Descents of BATCH_WIDTH keys advance in lockstep one level at a time, and the next node of each one
+     * is prefetched, so cache misses of independent lookups overlap instead of following each other
+     *
+     * @param keys searched keys
+     * @param outValues output, resized to keys.size(), i-th element points to the value of keys[i] or is nullptr
+     */
+    void findBatch(std::vector<KeyType> const &keys, std::vector<ValueType *> &outValues);
+
+    /**
+     * Get iterator to the smallest key
+     *
+     * Iterators stay valid until their element is removed, increments are amortized O(1)
+     *
+     * @return iterator to the smallest key or end() for an empty tree
+     */
+    Iterator begin();
+
+    /**
+     * Get past-the-end iterator, decrementing it gives the largest key
+     *
+     * @return past-the-end iterator
+     */
+    Iterator end();
+
+    /**
+     * Get read-only iterator to the smallest key
+     *
+     * @return iterator to the smallest key or end() for an empty tree
+     */
+    ConstIterator begin() const;
+
+    /**
+     * Get read-only past-the-end iterator
+     *
+     * @return past-the-end iterator
+     */
+    ConstIterator end() const;
+
+    /**
+     * Get iterator to the smallest key not less than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    Iterator lowerBound(KeyType const &key);
+
+    /**
+     * Get read-only iterator to the smallest key not less than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    ConstIterator lowerBound(KeyType const &key) const;
+
+    /**
+     * Get iterator to the smallest key greater than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    Iterator upperBound(KeyType const &key);
+
+    /**
+     * Get read-only iterator to the smallest key greater than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    ConstIterator upperBound(KeyType const &key) const;
+
+    /**
+     * Get iterator to the largest key not greater than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    Iterator floor(KeyType const &key);
+
+    /**
+     * Get read-only iterator to the largest key not greater than given key
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    ConstIterator floor(KeyType const &key) const;
+
+    /**
+     * Get iterator to the smallest key not less than given key, same as lowerBound
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    Iterator ceiling(KeyType const &key);
+
+    /**
+     * Get read-only iterator to the smallest key not less than given key, same as lowerBound
+     *
+     * @param key compared key, does not have to be present in the tree
+     * @return iterator to the found key or end() if there is none
+     */
+    ConstIterator ceiling(KeyType const &key) const;
+
+    /**
+     * Call visitor for every key in range [lo, hi] (inclusive) in increasing order
+     *
+     * Descends once to lo and then walks in order, O(log n + k) for k visited keys
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType &)
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @param visitor callable invoked for each key in the range
+     */
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor);
+
+    /**
+     * Call visitor for every key in range [lo, hi] (inclusive) in increasing order, values are read-only
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @param visitor callable invoked for each key in the range
+     */
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const;
+
+    /**
+     * Export contents into an immutable, pointer-free snapshot optimized for lookups, O(n)
+     *
+     * Snapshot does not observe later modifications of the tree
+     *
+     * @return snapshot in Eytzinger layout
+     */
+    FrozenTree<KeyType, ValueType, Compare> freeze() const;
+
+    /**
+     * Write contents into a versioned, checksummed binary snapshot, O(n)
+     *
+     * The file holds sorted arrays of keys and values without pointers, see saveMappedTree
+     *
+     * @param path saved file, replaced atomically
+     * @throws std::system_error if the file cannot be written
+     */
+    void save(std::string const &path) const;
+
+    /**
+     * Map snapshot written by save and serve lookups and scans directly from the mapping
+     *
+     * @param path snapshot file
+     * @param verifyChecksum whether to read the whole file once to compare its checksum
+     * @param compare three-way comparator the saved tree was ordered by
+     * @return read-only view of the snapshot
+     * @throws std::system_error if the file cannot be opened or mapped
+     * @throws std::runtime_error if the file is not a valid snapshot of these key and value types
+     */
+    static MappedTree<KeyType, ValueType, Compare> openMapped(std::string const &path, bool verifyChecksum = true,
+                                                              Compare const &compare = Compare());
+
+    /**
+     * Get cursor positioned at the smallest key
+     *
+     * @return cursor, invalid for an empty tree
+     */
+    Cursor cursor();
+
+    /**
+     * String representation of the tree in pre-order traversal
+     * @return pre-order traversal string
+     */
+    std::string toString() const;
+
+    /**
+     * Write string representation of the tree (see toString) to a stream without building it in memory
+     *
+     * O(n) time and O(height) memory, so even huge trees can be dumped to a file
+     *
+     * @tparam StreamType type of output stream
+     * @param stream output stream
+     * @param maxDepth number of written levels, deeper subtrees are written as "..."
+     */
+    template<typename StreamType>
+    void writeString(StreamType &stream, size_t maxDepth = std::numeric_limits<size_t>::max()) const;
+
+    /**
+     * Display tree (pre-order traversal) to a stream
+     *
+     * @tparam StreamType type of output stream
+     * @param stream output stream
+     * @param maxDepth number of printed levels, deeper children are printed as "..."
+     */
+    template<typename StreamType>
+    void print(StreamType &stream, size_t maxDepth = std::numeric_limits<size_t>::max()) const;
+
+    /**
+     * Display nodes with keys in range [lo, hi] (inclusive) to a stream, indented by their depth in the tree
+     *
+     * Visits only the O(log n + k) nodes on paths to the range and inside it
+     *
+     * @tparam StreamType type of output stream
+     * @param stream output stream
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     */
+    template<typename StreamType>
+    void printRange(StreamType &stream, KeyType const &lo, KeyType const &hi) const;
+
+
+};
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::updateHeight() {
+    this->height = 1 + std::max(
+            Node::nodeHeight(this->leftChild),
+            Node::nodeHeight(this->rightChild)
+    );
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::updateSubtreeSize() {
+    this->subtreeSize = 1 + Node::nodeSubtreeSize(this->leftChild) + Node::nodeSubtreeSize(this->rightChild);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::Node(Node *parent, K &&key, Args &&... valueArgs)
+        : NodeValue<ValueType>(std::forward<Args>(valueArgs)...), key(std::forward<K>(key)) {
+    height = 1;
+    subtreeSize = 1;
+    this->parent = parent;
+    this->leftChild = nullptr;
+    this->rightChild = nullptr;
+}
+
+
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+int AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::getBalance() const {
     return nodeHeight(leftChild) - nodeHeight(rightChild);
 }
 
 
-template<typename KeyType, typename ValueType>
-std::string AVLTree<KeyType, ValueType>::Node::toString() const {
-    return this->toString("");
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::toString() const {
+    return this->toString("");
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::toString(std::string const &separator) const {
+    std::ostringstream stringStream;
+    write(stringStream, separator.c_str());
+    return stringStream.str();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::write(StreamType &stream, char const *separator) const {
+    stream << "[" << key << "," << separator << this->value << "]";
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+int AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::nodeHeight(Node const *node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    return node->height;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::nodeSubtreeSize(Node const *node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    return node->subtreeSize;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::AVLTree() {
+    root = nullptr;
+    resetInsertStatistics();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::AVLTree(Compare const &compare)
+        : compare(compare) {
+    root = nullptr;
+    resetInsertStatistics();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::AVLTree(AVLTree const &other)
+        : compare(other.compare) {
+    root = nullptr;
+    resetInsertStatistics();
+    root = cloneSubtree(other.root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::AVLTree(AVLTree &&other) noexcept
+        : nodeAllocator(std::move(other.nodeAllocator)), compare(std::move(other.compare)) {
+    root = other.root;
+    insertStatistics = other.insertStatistics;
+    other.root = nullptr;
+    other.resetInsertStatistics();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator> &
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::operator=(AVLTree const &other) {
+    if (this != &other) {
+        clear();
+        compare = other.compare;
+        root = cloneSubtree(other.root);
+    }
+    return *this;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator> &
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::operator=(AVLTree &&other) noexcept {
+    if (this != &other) {
+        clear();
+        nodeAllocator = std::move(other.nodeAllocator);
+        compare = std::move(other.compare);
+        root = other.root;
+        insertStatistics = other.insertStatistics;
+        other.root = nullptr;
+        other.resetInsertStatistics();
+    }
+    return *this;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::cloneSubtree(Node const *source) {
+    if (source == nullptr) {
+        return nullptr;
+    }
+
+    nodeAllocator.reserve(source->subtreeSize);
+    auto cloneRoot = nodeAllocator.create(nullptr, source->key, source->value);
+    cloneRoot->height = source->height;
+    cloneRoot->subtreeSize = source->subtreeSize;
+
+    // Pairs of (source node, its copy) whose children are yet to be copied
+    std::vector<std::pair<Node const *, Node *>> stack;
+    stack.emplace_back(source, cloneRoot);
+    try {
+        while (!stack.empty()) {
+            auto pair = stack.back();
+            stack.pop_back();
+
+            if (pair.first->leftChild != nullptr) {
+                auto sourceChild = pair.first->leftChild;
+                auto clone = nodeAllocator.create(pair.second, sourceChild->key, sourceChild->value);
+                clone->height = sourceChild->height;
+                clone->subtreeSize = sourceChild->subtreeSize;
+                pair.second->leftChild = clone;
+                stack.emplace_back(sourceChild, clone);
+            }
+            if (pair.first->rightChild != nullptr) {
+                auto sourceChild = pair.first->rightChild;
+                auto clone = nodeAllocator.create(pair.second, sourceChild->key, sourceChild->value);
+                clone->height = sourceChild->height;
+                clone->subtreeSize = sourceChild->subtreeSize;
+                pair.second->rightChild = clone;
+                stack.emplace_back(sourceChild, clone);
+            }
+        }
+    } catch (...) {
+        // Every created node is already linked into the copy
+        destroySubtree(cloneRoot);
+        throw;
+    }
+    return cloneRoot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::InsertStatistics const &
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::getInsertStatistics() const {
+    return insertStatistics;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::resetInsertStatistics() {
+    insertStatistics = InsertStatistics{0, 0, 0};
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::~AVLTree() {
+    clear();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::clear() {
+    if (!NodeAllocator<Node>::RELEASES_IN_BULK || !std::is_trivially_destructible<Node>::value) {
+        destroySubtree(root);
+    }
+    nodeAllocator.releaseAll();
+    root = nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::buildFromSorted(ForwardIterator first, ForwardIterator last,
+                                                                          size_t threadCount) {
+    assert(std::adjacent_find(first, last, [this](decltype(*first) previous, decltype(*first) next) {
+        return compare(previous.first, next.first) >= 0;
+    }) == last);
+
+    clear();
+    auto count = (size_t) std::distance(first, last);
+    if (threadCount <= 1 || count < 2 * PARALLEL_BUILD_GRAIN) {
+        root = buildSubtree(first, count, nullptr, nodeAllocator);
+        return;
+    }
+
+    std::vector<BuildTask<ForwardIterator>> tasks;
+    std::vector<Node *> splitNodes;
+    std::vector<NodeAllocator<Node>> allocators;
+    try {
+        splitBuild(first, count, nullptr, &root, threadCount, tasks, splitNodes);
+
+        allocators.resize(tasks.size());
+        std::vector<std::function<void()>> builds;
+        for (size_t idx = 0; idx < tasks.size(); ++idx) {
+            builds.push_back([this, &tasks, &allocators, idx]() {
+                auto current = tasks[idx].first;
+                *tasks[idx].link = buildSubtree(current, tasks[idx].count, tasks[idx].parent, allocators[idx]);
+            });
+        }
+        runConcurrently(builds);
+    } catch (...) {
+        // A failed build has destroyed its own nodes and left its link empty, everything else is reachable from root
+        for (auto &allocator : allocators) {
+            nodeAllocator.adopt(std::move(allocator));
+        }
+        clear();
+        throw;
+    }
+
+    for (auto &allocator : allocators) {
+        nodeAllocator.adopt(std::move(allocator));
+    }
+    // Reverse pre-order visits children before their parents
+    for (auto node = splitNodes.rbegin(); node != splitNodes.rend(); ++node) {
+        (*node)->updateHeight();
+        (*node)->updateSubtreeSize();
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::splitBuild(ForwardIterator first, size_t count, Node *parent,
+                                                                     Node **link, size_t threadCount,
+                                                                     std::vector<BuildTask<ForwardIterator>> &tasks,
+                                                                     std::vector<Node *> &splitNodes) {
+    if (threadCount <= 1 || count < 2 * PARALLEL_BUILD_GRAIN) {
+        tasks.push_back({first, count, parent, link});
+        return;
+    }
+
+    auto leftCount = (count - 1) / 2;
+    auto median = std::next(first, leftCount);
+    auto subRoot = nodeAllocator.create(parent, median->first, median->second);
+    *link = subRoot;
+    splitNodes.push_back(subRoot);
+    splitBuild(first, leftCount, subRoot, &subRoot->leftChild, threadCount / 2, tasks, splitNodes);
+    splitBuild(std::next(median), count - 1 - leftCount, subRoot, &subRoot->rightChild,
+               threadCount - threadCount / 2, tasks, splitNodes);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::buildSubtree(ForwardIterator &current, size_t count, Node *parent,
+                                                                  NodeAllocator<Node> &allocator) {
+    if (count == 0) {
+        return nullptr;
+    }
+
+    auto leftCount = (count - 1) / 2;
+    auto left = buildSubtree(current, leftCount, nullptr, allocator);
+
+    Node *subRoot = nullptr;
+    try {
+        subRoot = allocator.create(parent, current->first, current->second);
+        ++current;
+        subRoot->leftChild = left;
+        if (left != nullptr) {
+            left->parent = subRoot;
+        }
+        subRoot->rightChild = buildSubtree(current, count - 1 - leftCount, subRoot, allocator);
+    } catch (...) {
+        // A failed right subtree has already destroyed its own nodes
+        destroySubtree(subRoot != nullptr ? subRoot : left, allocator);
+        throw;
+    }
+
+    subRoot->updateHeight();
+    subRoot->updateSubtreeSize();
+    return subRoot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename InputIterator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::bulkLoad(InputIterator first, InputIterator last, bool deduplicate,
+                                                                   size_t threadCount) {
+    std::vector<std::pair<KeyType, ValueType>> pairs;
+    for (; first != last; ++first) {
+        pairs.emplace_back(first->first, first->second);
+    }
+
+    // Stable sort keeps pairs with equal keys in input order, so the last one of each run is the latest write
+    parallelStableSort(pairs.begin(), pairs.end(), threadCount, [this](std::pair<KeyType, ValueType> const &lhs,
+                                                                      std::pair<KeyType, ValueType> const &rhs) {
+        return compare(lhs.first, rhs.first) < 0;
+    });
+
+    if (deduplicate && !pairs.empty()) {
+        size_t kept = 0;
+        for (size_t idx = 1; idx < pairs.size(); ++idx) {
+            if (compare(pairs[kept].first, pairs[idx].first) < 0) {
+                ++kept;
+            }
+            if (kept != idx) {
+                pairs[kept] = std::move(pairs[idx]);
+            }
+        }
+        pairs.resize(kept + 1);
+    }
+
+    buildFromSorted(pairs.begin(), pairs.end(), threadCount);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::linkNode(Node *subRoot, Node *left, Node *right) {
+    subRoot->parent = nullptr;
+    subRoot->leftChild = left;
+    subRoot->rightChild = right;
+    if (left != nullptr) {
+        left->parent = subRoot;
+    }
+    if (right != nullptr) {
+        right->parent = subRoot;
+    }
+    subRoot->updateHeight();
+    subRoot->updateSubtreeSize();
+    return subRoot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::detach(Node *subRoot) {
+    if (subRoot != nullptr) {
+        subRoot->parent = nullptr;
+    }
+    return subRoot;
 }
 
-template<typename KeyType, typename ValueType>
-std::string AVLTree<KeyType, ValueType>::Node::toString(std::string const &separator) const {
-    std::ostringstream stringStream;
-    stringStream << "[" << key << "," << separator << value << "]";
-    return stringStream.str();
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::joinNodes(Node *left, Node *middle, Node *right) {
+    auto leftHeight = Node::nodeHeight(left);
+    auto rightHeight = Node::nodeHeight(right);
+    if (leftHeight > rightHeight + 1) {
+        return joinRight(left, middle, right);
+    }
+    if (rightHeight > leftHeight + 1) {
+        return joinLeft(left, middle, right);
+    }
+    return linkNode(middle, left, right);
 }
 
-template<typename KeyType, typename ValueType>
-int AVLTree<KeyType, ValueType>::Node::nodeHeight(Node const *node) {
-    if (node == nullptr) {
-        return 0;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::joinRight(Node *left, Node *middle, Node *right) {
+    // Recursion depth is the height difference of the joined subtrees
+    auto outer = left->leftChild;
+    auto inner = left->rightChild;
+    Node *joined;
+    if (Node::nodeHeight(inner) <= Node::nodeHeight(right) + 1) {
+        joined = linkNode(middle, inner, right);
+        if (Node::nodeHeight(joined) > Node::nodeHeight(outer) + 1) {
+            // right-left case, rotate the joined subtree right first
+            auto pivot = joined->leftChild;
+            joined = linkNode(pivot, pivot->leftChild, linkNode(joined, pivot->rightChild, joined->rightChild));
+        }
+    } else {
+        joined = joinRight(inner, middle, right);
     }
 
-    return node->height;
+    linkNode(left, outer, joined);
+    if (Node::nodeHeight(joined) <= Node::nodeHeight(outer) + 1) {
+        return left;
+    }
+    // Rotate left
+    return linkNode(joined, linkNode(left, outer, joined->leftChild), joined->rightChild);
 }
 
-template<typename KeyType, typename ValueType>
-AVLTree<KeyType, ValueType>::AVLTree() {
-    root = nullptr;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::joinLeft(Node *left, Node *middle, Node *right) {
+    auto outer = right->rightChild;
+    auto inner = right->leftChild;
+    Node *joined;
+    if (Node::nodeHeight(inner) <= Node::nodeHeight(left) + 1) {
+        joined = linkNode(middle, left, inner);
+        if (Node::nodeHeight(joined) > Node::nodeHeight(outer) + 1) {
+            // left-right case, rotate the joined subtree left first
+            auto pivot = joined->rightChild;
+            joined = linkNode(pivot, linkNode(joined, joined->leftChild, pivot->leftChild), pivot->rightChild);
+        }
+    } else {
+        joined = joinLeft(left, middle, inner);
+    }
+
+    linkNode(right, joined, outer);
+    if (Node::nodeHeight(joined) <= Node::nodeHeight(outer) + 1) {
+        return right;
+    }
+    // Rotate right
+    return linkNode(joined, joined->leftChild, linkNode(right, joined->rightChild, outer));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::splitLast(Node *subRoot, Node *&maximum) {
+    if (subRoot->rightChild == nullptr) {
+        maximum = subRoot;
+        auto left = detach(subRoot->leftChild);
+        subRoot->leftChild = nullptr;
+        return left;
+    }
+
+    auto left = detach(subRoot->leftChild);
+    auto rest = splitLast(detach(subRoot->rightChild), maximum);
+    return joinNodes(left, subRoot, rest);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::joinTwo(Node *left, Node *right) {
+    if (left == nullptr) {
+        return detach(right);
+    }
+    if (right == nullptr) {
+        return detach(left);
+    }
+
+    Node *maximum = nullptr;
+    auto rest = splitLast(detach(left), maximum);
+    return joinNodes(rest, maximum, detach(right));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::SplitResult
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::splitNodes(Node *subRoot, KeyType const &key) const {
+    if (subRoot == nullptr) {
+        return {nullptr, nullptr, nullptr};
+    }
+
+    auto left = detach(subRoot->leftChild);
+    auto right = detach(subRoot->rightChild);
+    auto order = compare(key, subRoot->key);
+    if (order == 0) {
+        linkNode(subRoot, nullptr, nullptr);
+        return {left, subRoot, right};
+    }
+    if (order < 0) {
+        auto pieces = splitNodes(left, key);
+        pieces.greater = joinNodes(pieces.greater, subRoot, right);
+        return pieces;
+    }
+    auto pieces = splitNodes(right, key);
+    pieces.less = joinNodes(left, subRoot, pieces.less);
+    return pieces;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::collectNodes(Node *subRoot, std::vector<Node *> &nodes) {
+    if (subRoot == nullptr) {
+        return;
+    }
+    auto first = nodes.size();
+    nodes.push_back(subRoot);
+    for (auto idx = first; idx < nodes.size(); ++idx) {
+        if (nodes[idx]->leftChild != nullptr) {
+            nodes.push_back(nodes[idx]->leftChild);
+        }
+        if (nodes[idx]->rightChild != nullptr) {
+            nodes.push_back(nodes[idx]->rightChild);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Step>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::runSetSteps(size_t size, size_t threadCount,
+                                                                      std::vector<Node *> &discarded, Step step,
+                                                                      Node *&left, Node *&right) {
+    if (threadCount <= 1 || size < PARALLEL_SET_GRAIN) {
+        left = step(discarded, 1, true);
+        right = step(discarded, 1, false);
+        return;
+    }
+
+    // Steps touch disjoint nodes and no allocator, each collects its discarded nodes separately
+    std::vector<Node *> rightDiscarded;
+    runConcurrently({
+        [&]() { left = step(discarded, threadCount / 2, true); },
+        [&]() { right = step(rightDiscarded, threadCount - threadCount / 2, false); }
+    });
+    discarded.insert(discarded.end(), rightDiscarded.begin(), rightDiscarded.end());
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::unionNodes(Node *subRoot, Node *other,
+                                                                std::vector<Node *> &discarded,
+                                                                size_t threadCount) const {
+    if (subRoot == nullptr) {
+        return detach(other);
+    }
+    if (other == nullptr) {
+        return detach(subRoot);
+    }
+
+    auto size = Node::nodeSubtreeSize(subRoot) + Node::nodeSubtreeSize(other);
+    auto otherLeft = detach(other->leftChild);
+    auto otherRight = detach(other->rightChild);
+    auto pieces = splitNodes(detach(subRoot), other->key);
+    if (pieces.equal != nullptr) {
+        discarded.push_back(pieces.equal);
+    }
+
+    Node *left, *right;
+    runSetSteps(size, threadCount, discarded, [&](std::vector<Node *> &stepDiscarded, size_t stepThreads, bool isLeft) {
+        return isLeft ? unionNodes(pieces.less, otherLeft, stepDiscarded, stepThreads)
+                      : unionNodes(pieces.greater, otherRight, stepDiscarded, stepThreads);
+    }, left, right);
+    return joinNodes(left, other, right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::intersectNodes(Node *subRoot, Node const *other,
+                                                                    std::vector<Node *> &discarded,
+                                                                    size_t threadCount) const {
+    if (subRoot == nullptr) {
+        return nullptr;
+    }
+    if (other == nullptr) {
+        collectNodes(subRoot, discarded);
+        return nullptr;
+    }
+
+    auto size = Node::nodeSubtreeSize(subRoot) + Node::nodeSubtreeSize(other);
+    auto pieces = splitNodes(detach(subRoot), other->key);
+    Node *left, *right;
+    runSetSteps(size, threadCount, discarded, [&](std::vector<Node *> &stepDiscarded, size_t stepThreads, bool isLeft) {
+        return isLeft ? intersectNodes(pieces.less, other->leftChild, stepDiscarded, stepThreads)
+                      : intersectNodes(pieces.greater, other->rightChild, stepDiscarded, stepThreads);
+    }, left, right);
+    return (pieces.equal != nullptr) ? joinNodes(left, pieces.equal, right) : joinTwo(left, right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::differenceNodes(Node *subRoot, Node const *other,
+                                                                     std::vector<Node *> &discarded,
+                                                                     size_t threadCount) const {
+    if (subRoot == nullptr || other == nullptr) {
+        return detach(subRoot);
+    }
+
+    auto size = Node::nodeSubtreeSize(subRoot) + Node::nodeSubtreeSize(other);
+    auto pieces = splitNodes(detach(subRoot), other->key);
+    if (pieces.equal != nullptr) {
+        discarded.push_back(pieces.equal);
+    }
+    Node *left, *right;
+    runSetSteps(size, threadCount, discarded, [&](std::vector<Node *> &stepDiscarded, size_t stepThreads, bool isLeft) {
+        return isLeft ? differenceNodes(pieces.less, other->leftChild, stepDiscarded, stepThreads)
+                      : differenceNodes(pieces.greater, other->rightChild, stepDiscarded, stepThreads);
+    }, left, right);
+    return joinTwo(left, right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::join(AVLTree &&greater) {
+    if (this == &greater || greater.root == nullptr) {
+        return;
+    }
+    assert(root == nullptr || compare(InOrder<Node>::last(root)->key, InOrder<Node>::first(greater.root)->key) < 0);
+
+    nodeAllocator.adopt(std::move(greater.nodeAllocator));
+    root = joinTwo(root, greater.root);
+    greater.root = nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::split(KeyType const &key) {
+    AVLTree greater(compare);
+    auto pieces = splitNodes(root, key);
+    root = pieces.less;
+    if (pieces.equal != nullptr) {
+        pieces.greater = joinNodes(nullptr, pieces.equal, pieces.greater);
+    }
+
+    if (NodeAllocator<Node>::TRANSFERS_NODES) {
+        greater.root = detach(pieces.greater);
+        return greater;
+    }
+
+    std::vector<std::pair<KeyType, ValueType>> moved;
+    moved.reserve(Node::nodeSubtreeSize(pieces.greater));
+    for (auto node = InOrder<Node>::first(pieces.greater); node != nullptr; node = InOrder<Node>::next(node)) {
+        moved.emplace_back(std::move(node->key), std::move(node->value));
+    }
+    destroySubtree(pieces.greater);
+
+    auto current = moved.begin();
+    greater.nodeAllocator.reserve(moved.size());
+    greater.root = greater.buildSubtree(current, moved.size(), nullptr, greater.nodeAllocator);
+    return greater;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::unionWith(AVLTree &&other, size_t threadCount) {
+    if (this == &other) {
+        return;
+    }
+
+    nodeAllocator.adopt(std::move(other.nodeAllocator));
+    auto otherRoot = other.root;
+    other.root = nullptr;
+
+    std::vector<Node *> discarded;
+    root = unionNodes(root, otherRoot, discarded, threadCount);
+    for (auto node : discarded) {
+        nodeAllocator.destroy(node);
+    }
 }
 
-template<typename KeyType, typename ValueType>
-AVLTree<KeyType, ValueType>::~AVLTree() {
-    delete root;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::intersectWith(AVLTree const &other, size_t threadCount) {
+    if (this == &other) {
+        return;
+    }
+
+    std::vector<Node *> discarded;
+    root = intersectNodes(root, other.root, discarded, threadCount);
+    for (auto node : discarded) {
+        nodeAllocator.destroy(node);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::differenceWith(AVLTree const &other, size_t threadCount) {
+    if (this == &other) {
+        clear();
+        return;
+    }
+
+    std::vector<Node *> discarded;
+    root = differenceNodes(root, other.root, discarded, threadCount);
+    for (auto node : discarded) {
+        nodeAllocator.destroy(node);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot) {
+    destroySubtree(subRoot, nodeAllocator);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot,
+                                                                         NodeAllocator<Node> &allocator) {
+    while (subRoot != nullptr) {
+        if (subRoot->leftChild != nullptr) {
+            // Rotate right without maintaining heights or parents, the nodes are about to be destroyed
+            auto left = subRoot->leftChild;
+            subRoot->leftChild = left->rightChild;
+            left->rightChild = subRoot;
+            subRoot = left;
+        } else {
+            auto right = subRoot->rightChild;
+            allocator.destroy(subRoot);
+            subRoot = right;
+        }
+    }
 }
 
-template<typename KeyType, typename ValueType>
-typename AVLTree<KeyType, ValueType>::Node *AVLTree<KeyType, ValueType>::rotateLeft(AVLTree::Node *rotationRoot) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *AVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateLeft(AVLTree::Node *rotationRoot) {
     auto rootParent = rotationRoot->parent;
     auto pivot = rotationRoot->rightChild;  // Always not null
     auto shiftedSubtree = pivot->leftChild;
@@ -320,9 +1767,9 @@ typename AVLTree<KeyType, ValueType>::Node *AVLTree<KeyType, ValueType>::rotateL
     return finishRotation(rotationRoot, rootParent, pivot, shiftedSubtree);
 }
 
-template<typename KeyType, typename ValueType>
-typename AVLTree<KeyType, ValueType>::Node *
-AVLTree<KeyType, ValueType>::finishRotation(AVLTree::Node *rotationRoot, AVLTree::Node *rootParent,
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::finishRotation(AVLTree::Node *rotationRoot, AVLTree::Node *rootParent,
                                             AVLTree::Node *pivot,
                                             AVLTree::Node *shiftedSubtree) {
     if (shiftedSubtree != nullptr) {
@@ -338,12 +1785,14 @@ AVLTree<KeyType, ValueType>::finishRotation(AVLTree::Node *rotationRoot, AVLTree
     }
 
     rotationRoot->updateHeight();
+    rotationRoot->updateSubtreeSize();
     pivot->updateHeight();
+    pivot->updateSubtreeSize();
     return pivot;
 }
 
-template<typename KeyType, typename ValueType>
-typename AVLTree<KeyType, ValueType>::Node *AVLTree<KeyType, ValueType>::rotateRight(Node *rotationRoot) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *AVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateRight(Node *rotationRoot) {
     auto rootParent = rotationRoot->parent;
     auto pivot = rotationRoot->leftChild;  // Always not null
     auto shiftedSubtree = pivot->rightChild;
@@ -356,13 +1805,14 @@ typename AVLTree<KeyType, ValueType>::Node *AVLTree<KeyType, ValueType>::rotateR
     return finishRotation(rotationRoot, rootParent, pivot, shiftedSubtree);
 }
 
-template<typename KeyType, typename ValueType>
-void AVLTree<KeyType, ValueType>::rebalance(KeyType const &insertedKey, Node *subRoot) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::rebalance(Node *subRoot) {
     bool isRootRotation = (subRoot == root);
     int balance = subRoot->getBalance();
 
     if (balance > 1) {
-        if (insertedKey < subRoot->leftChild->key) {
+        if (subRoot->leftChild->getBalance() >= 0) {
             subRoot = rotateRight(subRoot);  // left-left
         } else {
             rotateLeft(subRoot->leftChild);
@@ -371,7 +1821,7 @@ void AVLTree<KeyType, ValueType>::rebalance(KeyType const &insertedKey, Node *su
     }
 
     if (balance < -1) {
-        if (insertedKey > subRoot->rightChild->key) {
+        if (subRoot->rightChild->getBalance() <= 0) {
             subRoot = rotateLeft(subRoot);  // right-right
         } else {
             rotateRight(subRoot->rightChild);
@@ -383,140 +1833,589 @@ void AVLTree<KeyType, ValueType>::rebalance(KeyType const &insertedKey, Node *su
     if (isRootRotation) {
         root = subRoot;
     }
+    return subRoot;
 }
 
-template<typename KeyType, typename ValueType>
-size_t AVLTree<KeyType, ValueType>::sizeSubtree(const Node *subRoot) {
-    if (subRoot == nullptr) {
-        return 0;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::rebalanceAfterRemoval(Node *subRoot) {
+    bool heightsSettled = false;
+    while (subRoot != nullptr) {
+        auto parent = subRoot->parent;
+        subRoot->updateSubtreeSize();
+        if (!heightsSettled) {
+            auto previousHeight = subRoot->height;
+            subRoot->updateHeight();
+            subRoot = rebalance(subRoot);
+            heightsSettled = (subRoot->height == previousHeight);
+        }
+        subRoot = parent;
     }
-
-    auto left = sizeSubtree(subRoot->leftChild);
-    auto right = sizeSubtree(subRoot->rightChild);
-    return left + 1 + right;
 }
 
-template<typename KeyType, typename ValueType>
-size_t AVLTree<KeyType, ValueType>::size() const {
-    return sizeSubtree(root);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::replaceChild(Node *parent, Node *oldChild, Node *newChild) {
+    if (parent == nullptr) {
+        root = newChild;
+    } else if (parent->leftChild == oldChild) {
+        parent->leftChild = newChild;
+    } else {
+        parent->rightChild = newChild;
+    }
 }
 
-template<typename KeyType, typename ValueType>
-void AVLTree<KeyType, ValueType>::insertIntoSubtree(KeyType const &key, ValueType const &value, Node *subRoot) {
-    // Replace existing key, no need to rebalance
-    if (key == subRoot->key) {
-        subRoot->value = value;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::remove(KeyType const &key) {
+    Node *removed = root;
+    while (removed != nullptr) {
+        auto order = compare(key, removed->key);
+        if (order == 0) {
+            break;
+        }
+        removed = (order < 0) ? removed->leftChild : removed->rightChild;
+    }
+    if (removed == nullptr) {
         return;
     }
 
-    // Insert recursively and rebalance if needed
-    if (key < subRoot->key) {
-        if (subRoot->leftChild == nullptr) {
-            subRoot->leftChild = new Node(key, value, subRoot);
+    Node *lowestChanged;
+    if (removed->leftChild == nullptr || removed->rightChild == nullptr) {
+        // At most one child, it takes the removed node's place
+        auto child = (removed->leftChild != nullptr) ? removed->leftChild : removed->rightChild;
+        if (child != nullptr) {
+            child->parent = removed->parent;
+        }
+        replaceChild(removed->parent, removed, child);
+        lowestChanged = removed->parent;
+    } else {
+        // Two children, in-order successor is detached and relinked in the removed node's place
+        auto successor = removed->rightChild;
+        while (successor->leftChild != nullptr) {
+            successor = successor->leftChild;
+        }
+
+        if (successor->parent != removed) {
+            lowestChanged = successor->parent;
+            lowestChanged->leftChild = successor->rightChild;
+            if (successor->rightChild != nullptr) {
+                successor->rightChild->parent = lowestChanged;
+            }
+            successor->rightChild = removed->rightChild;
+            successor->rightChild->parent = successor;
         } else {
-            insertIntoSubtree(key, value, subRoot->leftChild);
+            lowestChanged = successor;
         }
 
-    } else {
-        if (subRoot->rightChild == nullptr) {
-            subRoot->rightChild = new Node(key, value, subRoot);
+        successor->leftChild = removed->leftChild;
+        successor->leftChild->parent = successor;
+        successor->parent = removed->parent;
+        replaceChild(removed->parent, removed, successor);
+        // Height before the removal at this position, lets rebalancing detect when it can stop
+        successor->height = removed->height;
+    }
+
+    nodeAllocator.destroy(removed);
+    rebalanceAfterRemoval(lowestChanged);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::size() const {
+    return Node::nodeSubtreeSize(root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::nodeBytes() {
+    return sizeof(Node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::rank(KeyType const &key) const {
+    size_t lessCount = 0;
+    Node const *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else if (order > 0) {
+            lessCount += Node::nodeSubtreeSize(current->leftChild) + 1;
+            current = current->rightChild;
         } else {
-            insertIntoSubtree(key, value, subRoot->rightChild);
+            return lessCount + Node::nodeSubtreeSize(current->leftChild);
         }
     }
+    return lessCount;
+}
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::countNotGreater(KeyType const &key) const {
+    size_t count = 0;
+    Node const *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else if (order > 0) {
+            count += Node::nodeSubtreeSize(current->leftChild) + 1;
+            current = current->rightChild;
+        } else {
+            return count + Node::nodeSubtreeSize(current->leftChild) + 1;
+        }
+    }
+    return count;
+}
 
-    subRoot->updateHeight();
-    rebalance(key, subRoot);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+KeyType const *AVLTree<KeyType, ValueType, Compare, NodeAllocator>::select(size_t k) const {
+    Node const *current = root;
+    while (current != nullptr) {
+        auto leftSize = Node::nodeSubtreeSize(current->leftChild);
+        if (k < leftSize) {
+            current = current->leftChild;
+        } else if (k > leftSize) {
+            k -= leftSize + 1;
+            current = current->rightChild;
+        } else {
+            return &(current->key);
+        }
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t AVLTree<KeyType, ValueType, Compare, NodeAllocator>::countInRange(KeyType const &lo, KeyType const &hi) const {
+    if (compare(hi, lo) < 0) {
+        return 0;
+    }
+
+    return countNotGreater(hi) - rank(lo);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::boundNode(KeyType const &key, bool includeKey) const {
+    Node *bound = nullptr;
+    Node *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order == 0 && includeKey) {
+            return current;
+        }
+        if (order < 0) {
+            bound = current;
+            current = current->leftChild;
+        } else {
+            current = current->rightChild;
+        }
+    }
+    return bound;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::floorNode(KeyType const &key) const {
+    Node *bound = nullptr;
+    Node *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else {
+            bound = current;
+            if (order == 0) {
+                break;
+            }
+            current = current->rightChild;
+        }
+    }
+    return bound;
 }
 
-template<typename KeyType, typename ValueType>
-void AVLTree<KeyType, ValueType>::insert(const KeyType &key, const ValueType &value) {
-    // Insert into empty list
-    if (root == nullptr) {
-        root = new Node(key, value);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::InsertionPoint
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::findInsertionPoint(KeyType const &key) {
+    InsertionPoint point{nullptr, &root};
+    while (*point.link != nullptr) {
+        auto current = *point.link;
+        auto order = compare(key, current->key);
+        if (order == 0) {
+            break;
+        }
+
+        point.parent = current;
+        point.link = (order < 0) ? &(current->leftChild) : &(current->rightChild);
+    }
+    return point;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::attachNode(InsertionPoint point, Node *node) {
+    *point.link = node;
+
+    // Walk back up and rebalance if needed, rotations keep the parent of the rotated subtree unchanged
+    auto subRoot = point.parent;
+    bool heightsSettled = false;
+    while (subRoot != nullptr) {
+        auto parent = subRoot->parent;
+        ++subRoot->subtreeSize;
+
+        if (!heightsSettled) {
+            ++insertStatistics.touchedNodes;
+            auto previousHeight = subRoot->height;
+            subRoot->updateHeight();
+
+            auto balance = subRoot->getBalance();
+            if (balance > 1 || balance < -1) {
+                // Rotation after insertion restores the subtree's height from before the insertion
+                auto isDoubleRotation = (balance > 1) ? subRoot->leftChild->getBalance() < 0
+                                                      : subRoot->rightChild->getBalance() > 0;
+                insertStatistics.rotations += isDoubleRotation ? 2 : 1;
+                rebalance(subRoot);
+                heightsSettled = true;
+            } else if (subRoot->height == previousHeight) {
+                heightsSettled = true;
+            }
+        }
+        subRoot = parent;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename V>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::insertOrAssign(K &&key, V &&value) {
+    ++insertStatistics.insertions;
+
+    auto point = findInsertionPoint(key);
+    // Replace existing key, no need to rebalance
+    if (*point.link != nullptr) {
+        (*point.link)->value = std::forward<V>(value);
         return;
     }
 
-    insertIntoSubtree(key, value, root);
+    attachNode(point, nodeAllocator.create(point.parent, std::forward<K>(key), std::forward<V>(value)));
 }
 
-template<typename KeyType, typename ValueType>
-ValueType *AVLTree<KeyType, ValueType>::findInSubtree(KeyType const &key, Node *subRoot) {
-    if (subRoot == nullptr) {
-        return nullptr;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+std::pair<ValueType *, bool>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::emplaceIfAbsent(K &&key, Args &&... valueArgs) {
+    ++insertStatistics.insertions;
+
+    auto point = findInsertionPoint(key);
+    if (*point.link != nullptr) {
+        return std::make_pair(&((*point.link)->value), false);
     }
 
-    if (key < subRoot->key) {
-        return findInSubtree(key, subRoot->leftChild);
-    } else if (key > subRoot->key) {
-        return findInSubtree(key, subRoot->rightChild);
-    } else {
-        return &(subRoot->value);
+    auto node = nodeAllocator.create(point.parent, std::forward<K>(key), std::forward<Args>(valueArgs)...);
+    attachNode(point, node);
+    return std::make_pair(&(node->value), true);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::insert(const KeyType &key, const ValueType &value) {
+    insertOrAssign(key, value);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::insert(KeyType &&key, ValueType &&value) {
+    insertOrAssign(std::move(key), std::move(value));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+std::pair<ValueType *, bool> AVLTree<KeyType, ValueType, Compare, NodeAllocator>::emplace(K &&key, Args &&... valueArgs) {
+    ++insertStatistics.insertions;
+
+    // Key has to be constructed before it can be compared, so the node is created up front
+    auto node = nodeAllocator.create(nullptr, std::forward<K>(key), std::forward<Args>(valueArgs)...);
+    auto point = findInsertionPoint(node->key);
+    if (*point.link != nullptr) {
+        nodeAllocator.destroy(node);
+        return std::make_pair(&((*point.link)->value), false);
+    }
+
+    node->parent = point.parent;
+    attachNode(point, node);
+    return std::make_pair(&(node->value), true);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename... Args>
+std::pair<ValueType *, bool>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::tryEmplace(KeyType const &key, Args &&... valueArgs) {
+    return emplaceIfAbsent(key, std::forward<Args>(valueArgs)...);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename... Args>
+std::pair<ValueType *, bool>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::tryEmplace(KeyType &&key, Args &&... valueArgs) {
+    return emplaceIfAbsent(std::move(key), std::forward<Args>(valueArgs)...);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType *AVLTree<KeyType, ValueType, Compare, NodeAllocator>::findInSubtree(KeyType const &key, Node *subRoot) const {
+    while (subRoot != nullptr) {
+        auto order = compare(key, subRoot->key);
+        if (order < 0) {
+            subRoot = subRoot->leftChild;
+        } else if (order > 0) {
+            subRoot = subRoot->rightChild;
+        } else {
+            return &(subRoot->value);
+        }
     }
+    return nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-ValueType *AVLTree<KeyType, ValueType>::find(const KeyType &key) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType *AVLTree<KeyType, ValueType, Compare, NodeAllocator>::find(const KeyType &key) {
     return findInSubtree(key, root);
 }
 
-template<typename KeyType, typename ValueType>
-std::string AVLTree<KeyType, ValueType>::toStringSubtree(Node const *subRoot) {
-    if (subRoot == nullptr) {
-        return "";
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool AVLTree<KeyType, ValueType, Compare, NodeAllocator>::contains(const KeyType &key) const {
+    return findInSubtree(key, root) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::findBatch(std::vector<KeyType> const &keys, std::vector<ValueType *> &outValues) {
+    outValues.assign(keys.size(), nullptr);
+    for (size_t batchStart = 0; batchStart < keys.size(); batchStart += BATCH_WIDTH) {
+        auto width = (keys.size() - batchStart < BATCH_WIDTH) ? keys.size() - batchStart : BATCH_WIDTH;
+        Node *current[BATCH_WIDTH];
+        for (size_t lane = 0; lane < width; ++lane) {
+            current[lane] = root;
+        }
+
+        // Every round moves each unfinished descent one level down, finished lanes hold nullptr
+        bool active = root != nullptr;
+        while (active) {
+            active = false;
+            for (size_t lane = 0; lane < width; ++lane) {
+                auto node = current[lane];
+                if (node == nullptr) {
+                    continue;
+                }
+                auto order = compare(keys[batchStart + lane], node->key);
+                if (order == 0) {
+                    outValues[batchStart + lane] = &(node->value);
+                    current[lane] = nullptr;
+                    continue;
+                }
+                node = (order < 0) ? node->leftChild : node->rightChild;
+                prefetchRead(node);
+                current[lane] = node;
+                active = active || node != nullptr;
+            }
+        }
     }
+}
 
-    auto visit = subRoot->toString();
-    auto left = toStringSubtree(subRoot->leftChild);
-    auto right = toStringSubtree(subRoot->rightChild);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::begin() {
+    return Iterator(InOrder<Node>::first(root), &root);
+}
 
-    std::ostringstream stringStream;
-    stringStream << "(" << visit << "," << left << "," << right << ")";
-    return stringStream.str();
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::end() {
+    return Iterator(nullptr, &root);
 }
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::begin() const {
+    return ConstIterator(InOrder<Node>::first(root), &root);
+}
 
-template<typename KeyType, typename ValueType>
-std::string AVLTree<KeyType, ValueType>::toString() const {
-    return toStringSubtree(root);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::end() const {
+    return ConstIterator(nullptr, &root);
 }
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::lowerBound(KeyType const &key) {
+    return Iterator(boundNode(key, true), &root);
+}
 
-template<typename KeyType, typename ValueType>
-template<typename StreamType>
-void AVLTree<KeyType, ValueType>::printSubtree(StreamType &stream, Node const *subRoot, int indent,
-                                               std::string const &prefix) {
-    if (subRoot == nullptr) {
-        return;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::lowerBound(KeyType const &key) const {
+    return ConstIterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::upperBound(KeyType const &key) {
+    return Iterator(boundNode(key, false), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::upperBound(KeyType const &key) const {
+    return ConstIterator(boundNode(key, false), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::floor(KeyType const &key) {
+    return Iterator(floorNode(key), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::floor(KeyType const &key) const {
+    return ConstIterator(floorNode(key), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ceiling(KeyType const &key) {
+    return Iterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator AVLTree<KeyType, ValueType, Compare, NodeAllocator>::ceiling(KeyType const &key) const {
+    return ConstIterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Visitor>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) {
+    for (auto node = boundNode(lo, true); node != nullptr && compare(node->key, hi) <= 0; node = InOrder<Node>::next(node)) {
+        visitor(static_cast<KeyType const &>(node->key), static_cast<ValueType &>(node->value));
     }
-    stream << indentWhitespace(indent) << prefix << subRoot->toString(" ") << "\n";
-    if (subRoot->leftChild != nullptr) {
-        printSubtree(stream, subRoot->leftChild, indent + PRINT_NEST_INDENT, "L: ");
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Visitor>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const {
+    for (auto node = boundNode(lo, true); node != nullptr && compare(node->key, hi) <= 0; node = InOrder<Node>::next(node)) {
+        visitor(static_cast<KeyType const &>(node->key), static_cast<ValueType const &>(node->value));
     }
-    if (subRoot->rightChild != nullptr) {
-        printSubtree(stream, subRoot->rightChild, indent + PRINT_NEST_INDENT, "R: ");
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+FrozenTree<KeyType, ValueType, Compare> AVLTree<KeyType, ValueType, Compare, NodeAllocator>::freeze() const {
+    return FrozenTree<KeyType, ValueType, Compare>(begin(), size(), compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::save(std::string const &path) const {
+    saveMappedTree<KeyType, ValueType>(path, begin(), size());
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+MappedTree<KeyType, ValueType, Compare>
+AVLTree<KeyType, ValueType, Compare, NodeAllocator>::openMapped(std::string const &path, bool verifyChecksum,
+                                                                Compare const &compare) {
+    return MappedTree<KeyType, ValueType, Compare>::open(path, verifyChecksum, compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename AVLTree<KeyType, ValueType, Compare, NodeAllocator>::Cursor AVLTree<KeyType, ValueType, Compare, NodeAllocator>::cursor() {
+    return Cursor(&root, &compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::writeSubtree(StreamType &stream, Node const *subRoot,
+                                                                       size_t maxDepth) {
+    // Stack item is either a node to expand or a literal to emit
+    struct Item {
+        Node const *node;
+        char const *literal;
+        size_t depth;
+    };
+
+    std::vector<Item> stack;
+    stack.push_back({subRoot, nullptr, 0});
+    while (!stack.empty()) {
+        auto item = stack.back();
+        stack.pop_back();
+
+        if (item.literal != nullptr) {
+            stream << item.literal;
+        } else if (item.node != nullptr && item.depth >= maxDepth) {
+            stream << "...";
+        } else if (item.node != nullptr) {
+            // Emits (<node>,<left>,<right>), pushed in reverse order
+            stream << "(";
+            item.node->write(stream, "");
+            stream << ",";
+            stack.push_back({nullptr, ")", 0});
+            stack.push_back({item.node->rightChild, nullptr, item.depth + 1});
+            stack.push_back({nullptr, ",", 0});
+            stack.push_back({item.node->leftChild, nullptr, item.depth + 1});
+        }
     }
 }
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string AVLTree<KeyType, ValueType, Compare, NodeAllocator>::toString() const {
+    std::ostringstream stringStream;
+    writeSubtree(stringStream, root, std::numeric_limits<size_t>::max());
+    return stringStream.str();
+}
 
-template<typename KeyType, typename ValueType>
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
 template<typename StreamType>
-void AVLTree<KeyType, ValueType>::print(StreamType &stream) const {
-    printSubtree(stream, root, 0, "");
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::writeString(StreamType &stream, size_t maxDepth) const {
+    writeSubtree(stream, root, maxDepth);
 }
 
-template<typename KeyType, typename ValueType>
-std::string AVLTree<KeyType, ValueType>::indentWhitespace(int spaces) {
-    std::ostringstream ss;
-    for (int i = 0; i < spaces; ++i) {
-        ss << " ";
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::printSubtree(StreamType &stream, Node const *subRoot,
+                                                                       size_t maxDepth, KeyType const *lo,
+                                                                       KeyType const *hi) const {
+    struct Frame {
+        Node const *node;
+        size_t depth;
+        char const *prefix;
+    };
+
+    if (subRoot == nullptr || maxDepth == 0) {
+        return;
+    }
+
+    std::vector<Frame> stack;
+    stack.push_back({subRoot, 0, ""});
+    while (!stack.empty()) {
+        auto frame = stack.back();
+        stack.pop_back();
+        // Padding an empty string indents without building a string of spaces
+        auto indent = (int) frame.depth * PRINT_NEST_INDENT;
+
+        if (frame.depth >= maxDepth) {
+            stream << std::setw(indent) << "" << frame.prefix << "...\n";
+            continue;
+        }
+
+        auto node = frame.node;
+        bool aboveLo = (lo == nullptr || compare(*lo, node->key) < 0);
+        bool belowHi = (hi == nullptr || compare(node->key, *hi) < 0);
+        if ((aboveLo || compare(*lo, node->key) == 0) && (belowHi || compare(node->key, *hi) == 0)) {
+            stream << std::setw(indent) << "" << frame.prefix;
+            node->write(stream, " ");
+            stream << "\n";
+        }
+        // Right child pushed first to be printed after the left one, subtrees outside the range are skipped
+        if (node->rightChild != nullptr && belowHi) {
+            stack.push_back({node->rightChild, frame.depth + 1, "R: "});
+        }
+        if (node->leftChild != nullptr && aboveLo) {
+            stack.push_back({node->leftChild, frame.depth + 1, "L: "});
+        }
     }
-    return ss.str();
 }
 
-template<typename KeyType, typename ValueType>
-std::ostream &operator<<(std::ostream &stream, AVLTree<KeyType, ValueType> const &tree) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::print(StreamType &stream, size_t maxDepth) const {
+    printSubtree(stream, root, maxDepth, nullptr, nullptr);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void AVLTree<KeyType, ValueType, Compare, NodeAllocator>::printRange(StreamType &stream, KeyType const &lo,
+                                                                     KeyType const &hi) const {
+    printSubtree(stream, root, std::numeric_limits<size_t>::max(), &lo, &hi);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::ostream &operator<<(std::ostream &stream, AVLTree<KeyType, ValueType, Compare, NodeAllocator> const &tree) {
     tree.print(stream);
     return stream;
 }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <utility>
+#include "AVLTree.h"
+
+
+/**
+ * AVL tree of unique keys without associated values
+ *
+ * Nodes store no value at all (see NodeValue), a set of unsigned long keys takes 48 bytes per node instead of 56
+ * needed by an AVLTree mapping the keys to dummy values. The whole AVLTree interface stays available,
+ * values are NoValue and map style calls like insert(key, NoValue()) keep working.
+ *
+ * @tparam KeyType type of keys used for comparison
+ * @tparam Compare three-way comparator of the keys
+ * @tparam NodeAllocator allocator of the tree's nodes
+ */
+template<typename KeyType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
+class AVLTreeSet : public AVLTree<KeyType, NoValue, Compare, NodeAllocator> {
+private:
+    using Base = AVLTree<KeyType, NoValue, Compare, NodeAllocator>;
+
+public:
+    using Base::insert;
+
+    /**
+     * Initialize empty set
+     */
+    AVLTreeSet() = default;
+
+    /**
+     * Initialize empty set ordered by given comparator
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit AVLTreeSet(Compare const &compare) : Base(compare) {}
+
+    /**
+     * Take over nodes of a tree without values in O(1), leaving it empty
+     *
+     * @param tree moved tree
+     */
+    explicit AVLTreeSet(Base &&tree) noexcept : Base(std::move(tree)) {}
+
+    /**
+     * Insert key into the set, does nothing if the key is already present
+     *
+     * @param key inserted key
+     * @return true if the key was inserted
+     */
+    bool insert(KeyType const &key) {
+        return this->tryEmplace(key).second;
+    }
+
+    /**
+     * Insert key into the set, moving it into the node, does nothing if the key is already present
+     *
+     * @param key inserted key
+     * @return true if the key was inserted
+     */
+    bool insert(KeyType &&key) {
+        return this->tryEmplace(std::move(key)).second;
+    }
+
+    /**
+     * Move all keys not less than given key into a new set
+     *
+     * @param key smallest key of the returned set
+     * @return set with all keys k such that k >= key
+     */
+    AVLTreeSet split(KeyType const &key) {
+        return AVLTreeSet(Base::split(key));
+    }
+};
@@ -0,0 +1,651 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/ValueStorage.h"
+
+
+/**
+ * AVL tree storing its nodes in one contiguous vector, linked by narrow indices instead of pointers
+ *
+ * A node holds its key, value, three indices and a one byte height. With 32-bit indices the links and
+ * metadata of a node take 13 bytes instead of the 24 bytes of pointers plus height and subtree size of
+ * AVLTree, for 8 byte keys and values a node shrinks from 56 to 32 bytes. With 10^7 such elements
+ * compact-avl-benchmark measures 32 resident bytes per key against 56 for AVLTree, insert and find times are
+ * on par. Nodes of removed elements are kept on a free list and reused by later inserts, memory is returned
+ * only by clear.
+ *
+ * The tree holds at most numeric_limits<IndexType>::max() elements, the largest index marks missing links.
+ * Inserting beyond that throws std::length_error. Pointers to values are invalidated by inserts which grow the
+ * node vector.
+ *
+ * Values are kept in the nodes by default. With ColdValues they live in a separate vector indexed like the nodes,
+ * descents then read only keys and links, which pays off for values of 64 bytes and more.
+ *
+ * @tparam KeyType type of the keys, copy assignable
+ * @tparam ValueType type of the values, copy assignable
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam IndexType unsigned integer type of the links, bounds the number of elements
+ * @tparam ValueStorage where values are kept, InlineValues or ColdValues
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        typename IndexType = std::uint32_t, template<typename> class ValueStorage = InlineValues>
+class CompactAVLTree {
+    static_assert(std::is_unsigned<IndexType>::value, "Indices have to be unsigned");
+
+private:
+
+    /**
+     * Node of the tree, links are indices into the node vector, the value is held by the NodePart base
+     * of the storage policy
+     */
+    struct Node : ValueStorage<ValueType>::NodePart {
+        KeyType key;
+        IndexType leftChild;
+        IndexType rightChild;
+        IndexType parent;
+
+        /**
+         * Height of the subtree, a byte is enough for any tree fitting in memory
+         */
+        std::uint8_t height;
+
+        /**
+         * Initialize leaf node
+         *
+         * @param key key of the element
+         * @param value value of the element, ignored if values are stored out of the nodes
+         * @param parent parent of the leaf
+         */
+        Node(KeyType const &key, ValueType const &value, IndexType parent)
+                : ValueStorage<ValueType>::NodePart(value), key(key), leftChild(NIL), rightChild(NIL), parent(parent),
+                  height(1) {}
+    };
+
+    /**
+     * Index of a missing node
+     */
+    static const IndexType NIL = std::numeric_limits<IndexType>::max();
+
+    std::vector<Node> nodes;
+
+    ValueStorage<ValueType> values;
+
+    IndexType root;
+
+    /**
+     * First unused node, following ones linked through leftChild
+     */
+    IndexType freeList;
+
+    size_t elementCount;
+
+    Compare compare;
+
+    /**
+     * Get height of a subtree
+     *
+     * @param node root of the subtree, may be NIL
+     * @return height, 0 for NIL
+     */
+    int height(IndexType node) const;
+
+    /**
+     * Recalculate height of a node from its children
+     *
+     * @param node updated node
+     */
+    void updateHeight(IndexType node);
+
+    /**
+     * Take node for a new element, from the free list or by growing the node vector
+     *
+     * @param key key of the element
+     * @param value value of the element
+     * @param parent parent of the new leaf
+     * @return index of the node
+     */
+    IndexType allocateNode(KeyType const &key, ValueType const &value, IndexType parent);
+
+    /**
+     * Get value of a node from the storage policy
+     *
+     * @param node index of the node
+     * @return reference to the value
+     */
+    ValueType &valueOf(IndexType node);
+
+    ValueType const &valueOf(IndexType node) const;
+
+    /**
+     * Replace link of parent (or the root) pointing to a child with another node
+     *
+     * @param parent parent of the replaced child, NIL for the root
+     * @param oldChild replaced child
+     * @param newChild new child, may be NIL, its parent index is updated
+     */
+    void replaceChild(IndexType parent, IndexType oldChild, IndexType newChild);
+
+    /**
+     * Rotate subtree left, the right child becomes the subtree's root
+     *
+     * @param node root of the subtree
+     * @return new root of the subtree, linked to the old root's parent
+     */
+    IndexType rotateLeft(IndexType node);
+
+    /**
+     * Rotate subtree right, the left child becomes the subtree's root
+     *
+     * @param node root of the subtree
+     * @return new root of the subtree, linked to the old root's parent
+     */
+    IndexType rotateRight(IndexType node);
+
+    /**
+     * Restore balance on the path from a node to the root after its subtree changed height
+     *
+     * Stops as soon as a subtree keeps its height, ancestors above it are unaffected
+     *
+     * @param node lowest node whose subtree changed
+     */
+    void rebalanceUpwards(IndexType node);
+
+    /**
+     * Find node holding key
+     *
+     * @param key searched key
+     * @return index of the node or NIL
+     */
+    IndexType findNode(KeyType const &key) const;
+
+    /**
+     * Get node with the smallest key in a subtree
+     *
+     * @param node root of the subtree, may be NIL
+     * @return index of the node or NIL
+     */
+    IndexType firstNode(IndexType node) const;
+
+    /**
+     * Get in-order successor of a node
+     *
+     * @param node node with a successor or the last node
+     * @return index of the successor or NIL
+     */
+    IndexType nextNode(IndexType node) const;
+
+public:
+
+    /**
+     * Initialize empty tree
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit CompactAVLTree(Compare const &compare = Compare());
+
+    /**
+     * Get largest number of elements the index type can address
+     *
+     * @return maximal number of elements
+     */
+    static size_t maxSize();
+
+    /**
+     * Get memory taken by one node, links and height included, values stored out of the nodes are not counted
+     *
+     * @return size of a node in bytes
+     */
+    static size_t nodeBytes();
+
+    /**
+     * Reserve nodes for elements inserted later, avoids regrowing the node vector
+     *
+     * @param count expected number of elements
+     */
+    void reserve(size_t count);
+
+    /**
+     * Get memory taken by the node vector and values stored out of the nodes, including unused capacity
+     *
+     * @return number of bytes
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * Insert key-value pair or replace value of an existing key
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     * @throws std::length_error if the tree already holds maxSize() elements
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value, nothing happens if the key is not present
+     *
+     * @param key removed key
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value or nullptr if not found, invalidated by inserts
+     */
+    ValueType *find(KeyType const &key);
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value or nullptr if not found, invalidated by inserts
+     */
+    ValueType const *find(KeyType const &key) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Remove all elements and release the node vector
+     */
+    void clear();
+
+    /**
+     * Call visitor for every element in increasing key order
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param visitor callable invoked for each element
+     */
+    template<typename Visitor>
+    void forEach(Visitor &&visitor) const;
+
+    /**
+     * Call visitor for every key in range [lo, hi] (inclusive), in increasing order
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @param visitor callable invoked for each key in the range
+     */
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const;
+
+    /**
+     * String representation of the tree in pre-order traversal, same format as AVLTree::toString
+     *
+     * @return pre-order traversal string
+     */
+    std::string toString() const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::CompactAVLTree(Compare const &compare)
+        : root(NIL), freeList(NIL), elementCount(0), compare(compare) {}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+size_t CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::maxSize() {
+    return (size_t) NIL;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+size_t CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::nodeBytes() {
+    return sizeof(Node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::reserve(size_t count) {
+    nodes.reserve(count < maxSize() ? count : maxSize());
+    values.reserve(count < maxSize() ? count : maxSize());
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+size_t CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::memoryUsage() const {
+    return nodes.capacity() * sizeof(Node) + values.memoryUsage();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+int CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::height(IndexType node) const {
+    return node == NIL ? 0 : nodes[node].height;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::updateHeight(IndexType node) {
+    auto leftHeight = height(nodes[node].leftChild);
+    auto rightHeight = height(nodes[node].rightChild);
+    nodes[node].height = (std::uint8_t) (1 + (leftHeight > rightHeight ? leftHeight : rightHeight));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::allocateNode(KeyType const &key,
+                                                                                 ValueType const &value,
+                                                                                 IndexType parent) {
+    if (freeList != NIL) {
+        auto node = freeList;
+        values.store(node, value);
+        freeList = nodes[node].leftChild;
+        nodes[node] = Node(key, value, parent);
+        return node;
+    }
+    if (nodes.size() >= maxSize()) {
+        throw std::length_error("CompactAVLTree index space exhausted");
+    }
+    // Value goes first, a failed push_back leaves a spare value which the next allocation overwrites
+    values.store(nodes.size(), value);
+    nodes.push_back(Node(key, value, parent));
+    return (IndexType) (nodes.size() - 1);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+ValueType &CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::valueOf(IndexType node) {
+    return values.at(nodes[node], node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+ValueType const &CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::valueOf(IndexType node) const {
+    return values.at(nodes[node], node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::replaceChild(IndexType parent, IndexType oldChild,
+                                                                          IndexType newChild) {
+    if (parent == NIL) {
+        root = newChild;
+    } else if (nodes[parent].leftChild == oldChild) {
+        nodes[parent].leftChild = newChild;
+    } else {
+        nodes[parent].rightChild = newChild;
+    }
+    if (newChild != NIL) {
+        nodes[newChild].parent = parent;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::rotateLeft(IndexType node) {
+    auto pivot = nodes[node].rightChild;
+    auto inner = nodes[pivot].leftChild;
+    replaceChild(nodes[node].parent, node, pivot);
+
+    nodes[node].rightChild = inner;
+    if (inner != NIL) {
+        nodes[inner].parent = node;
+    }
+    nodes[pivot].leftChild = node;
+    nodes[node].parent = pivot;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::rotateRight(IndexType node) {
+    auto pivot = nodes[node].leftChild;
+    auto inner = nodes[pivot].rightChild;
+    replaceChild(nodes[node].parent, node, pivot);
+
+    nodes[node].leftChild = inner;
+    if (inner != NIL) {
+        nodes[inner].parent = node;
+    }
+    nodes[pivot].rightChild = node;
+    nodes[node].parent = pivot;
+    updateHeight(node);
+    updateHeight(pivot);
+    return pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::rebalanceUpwards(IndexType node) {
+    while (node != NIL) {
+        auto oldHeight = nodes[node].height;
+        updateHeight(node);
+        auto balance = height(nodes[node].leftChild) - height(nodes[node].rightChild);
+
+        auto subRoot = node;
+        if (balance > 1) {
+            auto left = nodes[node].leftChild;
+            if (height(nodes[left].leftChild) < height(nodes[left].rightChild)) {
+                rotateLeft(left);
+            }
+            subRoot = rotateRight(node);
+        } else if (balance < -1) {
+            auto right = nodes[node].rightChild;
+            if (height(nodes[right].rightChild) < height(nodes[right].leftChild)) {
+                rotateRight(right);
+            }
+            subRoot = rotateLeft(node);
+        }
+
+        if (subRoot == node && nodes[node].height == oldHeight) {
+            return;
+        }
+        node = nodes[subRoot].parent;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::insert(KeyType const &key, ValueType const &value) {
+    auto parent = NIL;
+    auto current = root;
+    int order = 0;
+    while (current != NIL) {
+        order = compare(key, nodes[current].key);
+        if (order == 0) {
+            valueOf(current) = value;
+            return;
+        }
+        parent = current;
+        current = (order < 0) ? nodes[current].leftChild : nodes[current].rightChild;
+    }
+
+    auto node = allocateNode(key, value, parent);
+    if (parent == NIL) {
+        root = node;
+    } else if (order < 0) {
+        nodes[parent].leftChild = node;
+    } else {
+        nodes[parent].rightChild = node;
+    }
+    ++elementCount;
+    rebalanceUpwards(parent);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::remove(KeyType const &key) {
+    auto node = findNode(key);
+    if (node == NIL) {
+        return;
+    }
+
+    // A node with two children takes over its successor's element, the successor is unlinked instead
+    if (nodes[node].leftChild != NIL && nodes[node].rightChild != NIL) {
+        auto successor = firstNode(nodes[node].rightChild);
+        nodes[node].key = nodes[successor].key;
+        valueOf(node) = valueOf(successor);
+        node = successor;
+    }
+
+    auto child = (nodes[node].leftChild != NIL) ? nodes[node].leftChild : nodes[node].rightChild;
+    auto parent = nodes[node].parent;
+    replaceChild(parent, node, child);
+
+    nodes[node].leftChild = freeList;
+    freeList = node;
+    --elementCount;
+    rebalanceUpwards(parent);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::findNode(KeyType const &key) const {
+    auto current = root;
+    while (current != NIL) {
+        auto order = compare(key, nodes[current].key);
+        if (order == 0) {
+            return current;
+        }
+        current = (order < 0) ? nodes[current].leftChild : nodes[current].rightChild;
+    }
+    return NIL;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::firstNode(IndexType node) const {
+    if (node == NIL) {
+        return NIL;
+    }
+    while (nodes[node].leftChild != NIL) {
+        node = nodes[node].leftChild;
+    }
+    return node;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+IndexType CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::nextNode(IndexType node) const {
+    if (nodes[node].rightChild != NIL) {
+        return firstNode(nodes[node].rightChild);
+    }
+    auto parent = nodes[node].parent;
+    while (parent != NIL && nodes[parent].rightChild == node) {
+        node = parent;
+        parent = nodes[node].parent;
+    }
+    return parent;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+ValueType *CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::find(KeyType const &key) {
+    auto node = findNode(key);
+    return node == NIL ? nullptr : &valueOf(node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+ValueType const *CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::find(KeyType const &key) const {
+    auto node = findNode(key);
+    return node == NIL ? nullptr : &valueOf(node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+bool CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::contains(KeyType const &key) const {
+    return findNode(key) != NIL;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+size_t CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::size() const {
+    return elementCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::clear() {
+    std::vector<Node>().swap(nodes);
+    values.clear();
+    root = NIL;
+    freeList = NIL;
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+template<typename Visitor>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::forEach(Visitor &&visitor) const {
+    for (auto node = firstNode(root); node != NIL; node = nextNode(node)) {
+        visitor(nodes[node].key, valueOf(node));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+template<typename Visitor>
+void CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::forEachInRange(KeyType const &lo, KeyType const &hi,
+                                                                            Visitor &&visitor) const {
+    // Smallest key not less than lo
+    auto first = NIL;
+    auto current = root;
+    while (current != NIL) {
+        if (compare(nodes[current].key, lo) < 0) {
+            current = nodes[current].rightChild;
+        } else {
+            first = current;
+            current = nodes[current].leftChild;
+        }
+    }
+
+    for (auto node = first; node != NIL && compare(nodes[node].key, hi) <= 0; node = nextNode(node)) {
+        visitor(nodes[node].key, valueOf(node));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename IndexType,
+        template<typename> class ValueStorage>
+std::string CompactAVLTree<KeyType, ValueType, Compare, IndexType, ValueStorage>::toString() const {
+    // Stack item is either a node to expand or a literal to emit
+    struct Item {
+        IndexType node;
+        char const *literal;
+    };
+
+    std::ostringstream stringStream;
+    std::vector<Item> stack;
+    stack.push_back({root, nullptr});
+    while (!stack.empty()) {
+        auto item = stack.back();
+        stack.pop_back();
+
+        if (item.literal != nullptr) {
+            stringStream << item.literal;
+        } else if (item.node != NIL) {
+            auto const &node = nodes[item.node];
+            stringStream << "([" << node.key << "," << valueOf(item.node) << "],";
+            stack.push_back({NIL, ")"});
+            stack.push_back({node.rightChild, nullptr});
+            stack.push_back({NIL, ","});
+            stack.push_back({node.leftChild, nullptr});
+        }
+    }
+    return stringStream.str();
+}
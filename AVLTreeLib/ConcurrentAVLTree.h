@@ -0,0 +1,665 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/NodePool.h"
+
+
+/**
+ * AVL tree safe for concurrent use - lookups run without locks in parallel with a single writer at a time
+ *
+ * Writers are serialized by a mutex and bump a sequence counter around every change that can send a reader
+ * down a wrong path (rotations and relinking a removed node's successor), readers descend optimistically and
+ * retry when the counter changed during their descent. Linking a new leaf, unlinking a node with at most one
+ * child and replacing a value are single pointer stores and do not disturb readers.
+ *
+ * Keys and values of a published node never change, an assignment replaces the whole node, so a reader copies
+ * a consistent value. Unlinked nodes are retired and destroyed only after every reader that could have
+ * reached them has left (two-epoch reclamation), readers never touch freed memory.
+ *
+ * @tparam KeyType type of the keys
+ * @tparam ValueType type of the values, copied out by lookups
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam NodeAllocator allocator of the tree's nodes (NodePool or HeapAllocator), used only by writers
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
+class ConcurrentAVLTree {
+private:
+
+    /**
+     * Node of the tree, key and value are immutable after construction
+     *
+     * Child links are atomic because readers follow them while the writer rotates,
+     * height is read and written only by the writer holding the mutex
+     */
+    struct Node {
+        KeyType const key;
+        ValueType const value;
+        int height;
+        std::atomic<Node *> leftChild;
+        std::atomic<Node *> rightChild;
+
+        /**
+         * Initialize node with given key, value and children
+         *
+         * @param key node's key
+         * @param value node's value
+         * @param leftChild root of the left subtree
+         * @param rightChild root of the right subtree
+         * @param height height of the node's subtree
+         */
+        Node(KeyType const &key, ValueType const &value, Node *leftChild, Node *rightChild, int height);
+
+        /**
+         * Recalculate node's height from its children
+         */
+        void updateHeight();
+
+        /**
+         * Difference of subtree heights (left - right)
+         *
+         * @return node's balance factor
+         */
+        int getBalance() const;
+
+        /**
+         * Utility for accessing node's height, null safe
+         *
+         * @param node root node of a tree
+         * @return height of the subtree with given root (0 for nullptr)
+         */
+        static int nodeHeight(Node const *node);
+    };
+
+    /**
+     * Number of readers registered in one epoch, padded to its own cache line
+     */
+    struct ReaderCount {
+        std::atomic<size_t> count;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    /**
+     * Number of reader counters per epoch parity, readers spread over them by thread to avoid contention
+     */
+    static const size_t READER_STRIPES = 16;
+
+    /**
+     * Failed optimistic descents after which a reader takes the writer mutex instead
+     */
+    static const int OPTIMISTIC_ATTEMPTS = 8;
+
+    /**
+     * Longest descent a reader attempts, far above the height of any AVL tree fitting in memory;
+     * a longer walk can only come from following links in the middle of a rotation
+     */
+    static const int MAX_DESCENT = 128;
+
+    /**
+     * Number of retired nodes which triggers their reclamation
+     */
+    static const size_t RECLAIM_BATCH = 256;
+
+    std::atomic<Node *> root;
+
+    std::atomic<size_t> elementCount;
+
+    /**
+     * Sequence counter, odd while a writer is restructuring the tree
+     */
+    std::atomic<std::uint64_t> version;
+
+    /**
+     * Reclamation epoch, readers register under its parity
+     */
+    std::atomic<std::uint64_t> epoch;
+
+    /**
+     * Registered readers by epoch parity and stripe
+     */
+    mutable ReaderCount readerCounts[2][READER_STRIPES];
+
+    /**
+     * Serializes writers, also taken by readers which repeatedly failed validation
+     */
+    mutable std::mutex writerMutex;
+
+    /**
+     * Whether the current write operation already made the sequence counter odd
+     */
+    bool restructuring;
+
+    /**
+     * Nodes unlinked from the tree which readers may still be visiting
+     */
+    std::vector<Node *> retiredNodes;
+
+    NodeAllocator<Node> nodeAllocator;
+
+    Compare compare;
+
+    /**
+     * Stripe of the reader counters used by the calling thread
+     *
+     * @return index of the stripe
+     */
+    static size_t readerStripe();
+
+    /**
+     * Register calling thread as a reader of the current epoch
+     *
+     * @return epoch parity to pass to leaveRead
+     */
+    size_t enterRead() const;
+
+    /**
+     * Unregister a reader
+     *
+     * @param parity value returned by the matching enterRead
+     */
+    void leaveRead(size_t parity) const;
+
+    /**
+     * Descend to the node with given key
+     *
+     * Safe to call concurrently with a writer as long as the caller is registered as a reader
+     *
+     * @param key searched key
+     * @param found set to the node with the key or nullptr if the descent ended in an empty link
+     * @return whether the descent finished within MAX_DESCENT steps
+     */
+    bool descend(KeyType const &key, Node *&found) const;
+
+    /**
+     * Make the sequence counter odd before the first restructuring step of a write operation
+     */
+    void beginRestructuring();
+
+    /**
+     * Make the sequence counter even again if the write operation restructured the tree
+     */
+    void finishWrite();
+
+    /**
+     * Store a child link, skipping the store when the link does not change
+     *
+     * @param link parent's child link
+     * @param child new child
+     */
+    static void setChild(std::atomic<Node *> &link, Node *child);
+
+    /**
+     * Insert key-value pair into a subtree, replacing the node of an existing key
+     *
+     * @param subRoot root node of the subtree
+     * @param key inserted key
+     * @param value inserted value
+     * @return root node of the subtree after insertion and rebalancing
+     */
+    Node *insertInto(Node *subRoot, KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key from a subtree
+     *
+     * @param subRoot root node of the subtree
+     * @param key removed key
+     * @return root node of the subtree after removal and rebalancing
+     */
+    Node *removeFrom(Node *subRoot, KeyType const &key);
+
+    /**
+     * Unlink node with the smallest key of a subtree without retiring it
+     *
+     * @param subRoot root node of the subtree
+     * @param minimum set to the unlinked node
+     * @return root node of the subtree after unlinking and rebalancing
+     */
+    Node *detachMinimum(Node *subRoot, Node *&minimum);
+
+    /**
+     * Restore AVL property of a subtree whose children are balanced
+     *
+     * @param subRoot root node of the subtree
+     * @return root node of the subtree after rebalancing
+     */
+    Node *rebalance(Node *subRoot);
+
+    /**
+     * Perform left rotation of a subtree around given root node
+     *
+     * @param rotationRoot root node of the subtree to rotate
+     * @return new root node of the subtree after rotation
+     */
+    static Node *rotateLeft(Node *rotationRoot);
+
+    /**
+     * Perform right rotation of a subtree around given root node
+     *
+     * @param rotationRoot root node of the subtree to rotate
+     * @return new root node of the subtree after rotation
+     */
+    static Node *rotateRight(Node *rotationRoot);
+
+    /**
+     * Hand an unlinked node over to reclamation
+     *
+     * @param node node no longer reachable from the root
+     */
+    void retire(Node *node);
+
+    /**
+     * Wait until readers of the current epoch leave and destroy nodes retired before
+     */
+    void reclaimRetired();
+
+public:
+
+    /**
+     * Initialize empty tree
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit ConcurrentAVLTree(Compare const &compare = Compare());
+
+    ConcurrentAVLTree(ConcurrentAVLTree const &) = delete;
+
+    ConcurrentAVLTree &operator=(ConcurrentAVLTree const &) = delete;
+
+    /**
+     * Destroy all nodes, no other thread may use the tree anymore
+     */
+    ~ConcurrentAVLTree();
+
+    /**
+     * Insert key-value pair or replace value of an existing key
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value, nothing happens if the key is not present
+     *
+     * @param key removed key
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Copy value associated with key, lock-free unless writers keep invalidating the descent
+     *
+     * @param key searched key
+     * @param value set to a copy of the found value, untouched if the key is not present
+     * @return whether the key is present
+     */
+    bool find(KeyType const &key, ValueType &value) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::Node(KeyType const &key, ValueType const &value,
+                                                                          Node *leftChild, Node *rightChild, int height)
+        : key(key), value(value), height(height), leftChild(leftChild), rightChild(rightChild) {}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::updateHeight() {
+    auto leftHeight = nodeHeight(leftChild.load(std::memory_order_relaxed));
+    auto rightHeight = nodeHeight(rightChild.load(std::memory_order_relaxed));
+    height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+int ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::getBalance() const {
+    return nodeHeight(leftChild.load(std::memory_order_relaxed)) -
+           nodeHeight(rightChild.load(std::memory_order_relaxed));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+int ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::nodeHeight(Node const *node) {
+    return node == nullptr ? 0 : node->height;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::ConcurrentAVLTree(Compare const &compare)
+        : root(nullptr), elementCount(0), version(0), epoch(0), restructuring(false), compare(compare) {
+    for (auto &parityCounts : readerCounts) {
+        for (auto &readerCount : parityCounts) {
+            readerCount.count.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::~ConcurrentAVLTree() {
+    // Retired nodes may still link into the live tree, so their links are not followed
+    for (auto node : retiredNodes) {
+        nodeAllocator.destroy(node);
+    }
+
+    std::vector<Node *> pending(1, root.load(std::memory_order_relaxed));
+    while (!pending.empty()) {
+        auto node = pending.back();
+        pending.pop_back();
+        if (node != nullptr) {
+            pending.push_back(node->leftChild.load(std::memory_order_relaxed));
+            pending.push_back(node->rightChild.load(std::memory_order_relaxed));
+            nodeAllocator.destroy(node);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::readerStripe() {
+    static thread_local size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_STRIPES;
+    return stripe;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::enterRead() const {
+    auto stripe = readerStripe();
+    while (true) {
+        auto current = epoch.load();
+        readerCounts[current & 1][stripe].count.fetch_add(1);
+        // Registration counts only if the epoch did not advance meanwhile, otherwise the writer may not wait for it
+        if (epoch.load() == current) {
+            return current & 1;
+        }
+        readerCounts[current & 1][stripe].count.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::leaveRead(size_t parity) const {
+    readerCounts[parity][readerStripe()].count.fetch_sub(1, std::memory_order_release);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::descend(KeyType const &key, Node *&found) const {
+    auto node = root.load(std::memory_order_acquire);
+    for (int depth = 0; depth < MAX_DESCENT; ++depth) {
+        if (node == nullptr) {
+            found = nullptr;
+            return true;
+        }
+
+        auto order = compare(key, node->key);
+        if (order == 0) {
+            found = node;
+            return true;
+        }
+        node = (order < 0 ? node->leftChild : node->rightChild).load(std::memory_order_acquire);
+    }
+    return false;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::find(KeyType const &key, ValueType &value) const {
+    for (int attempt = 0; attempt < OPTIMISTIC_ATTEMPTS; ++attempt) {
+        auto before = version.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto parity = enterRead();
+        Node *found = nullptr;
+        auto finished = descend(key, found);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (finished && version.load(std::memory_order_relaxed) == before) {
+            // Registration keeps the node alive and its value never changes, copying needs no validation
+            if (found != nullptr) {
+                value = found->value;
+            }
+            leaveRead(parity);
+            return found != nullptr;
+        }
+        leaveRead(parity);
+    }
+
+    // Writers kept restructuring the path, fall back to excluding them
+    std::lock_guard<std::mutex> lock(writerMutex);
+    Node *found = nullptr;
+    descend(key, found);
+    if (found != nullptr) {
+        value = found->value;
+    }
+    return found != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::contains(KeyType const &key) const {
+    for (int attempt = 0; attempt < OPTIMISTIC_ATTEMPTS; ++attempt) {
+        auto before = version.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto parity = enterRead();
+        Node *found = nullptr;
+        auto finished = descend(key, found);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto valid = finished && version.load(std::memory_order_relaxed) == before;
+        leaveRead(parity);
+        if (valid) {
+            return found != nullptr;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    Node *found = nullptr;
+    descend(key, found);
+    return found != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::size() const {
+    return elementCount.load(std::memory_order_relaxed);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::beginRestructuring() {
+    if (!restructuring) {
+        restructuring = true;
+        version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::finishWrite() {
+    if (restructuring) {
+        restructuring = false;
+        version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    if (retiredNodes.size() >= RECLAIM_BATCH) {
+        reclaimRetired();
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::setChild(std::atomic<Node *> &link, Node *child) {
+    if (link.load(std::memory_order_relaxed) != child) {
+        link.store(child, std::memory_order_release);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::insert(KeyType const &key, ValueType const &value) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    setChild(root, insertInto(root.load(std::memory_order_relaxed), key, value));
+    finishWrite();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::remove(KeyType const &key) {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    setChild(root, removeFrom(root.load(std::memory_order_relaxed), key));
+    finishWrite();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::insertInto(Node *subRoot, KeyType const &key,
+                                                                          ValueType const &value) {
+    // Recursion depth is the height of the tree
+    if (subRoot == nullptr) {
+        elementCount.fetch_add(1, std::memory_order_relaxed);
+        return nodeAllocator.create(key, value, nullptr, nullptr, 1);
+    }
+
+    auto order = compare(key, subRoot->key);
+    if (order == 0) {
+        // Readers may be copying the old value, the node is replaced instead of modified
+        auto replacement = nodeAllocator.create(subRoot->key, value,
+                                                subRoot->leftChild.load(std::memory_order_relaxed),
+                                                subRoot->rightChild.load(std::memory_order_relaxed),
+                                                subRoot->height);
+        retire(subRoot);
+        return replacement;
+    }
+
+    auto &link = (order < 0) ? subRoot->leftChild : subRoot->rightChild;
+    setChild(link, insertInto(link.load(std::memory_order_relaxed), key, value));
+    return rebalance(subRoot);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::removeFrom(Node *subRoot, KeyType const &key) {
+    if (subRoot == nullptr) {
+        return nullptr;
+    }
+
+    auto order = compare(key, subRoot->key);
+    if (order != 0) {
+        auto &link = (order < 0) ? subRoot->leftChild : subRoot->rightChild;
+        setChild(link, removeFrom(link.load(std::memory_order_relaxed), key));
+        return rebalance(subRoot);
+    }
+
+    elementCount.fetch_sub(1, std::memory_order_relaxed);
+    retire(subRoot);
+    auto left = subRoot->leftChild.load(std::memory_order_relaxed);
+    auto right = subRoot->rightChild.load(std::memory_order_relaxed);
+    if (left == nullptr) {
+        return right;
+    }
+    if (right == nullptr) {
+        return left;
+    }
+
+    // Successor moves into the removed node's place, readers passing it meanwhile may miss keys
+    beginRestructuring();
+    Node *successor = nullptr;
+    right = detachMinimum(right, successor);
+    successor->leftChild.store(left, std::memory_order_release);
+    successor->rightChild.store(right, std::memory_order_release);
+    return rebalance(successor);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::detachMinimum(Node *subRoot, Node *&minimum) {
+    auto left = subRoot->leftChild.load(std::memory_order_relaxed);
+    if (left == nullptr) {
+        minimum = subRoot;
+        return subRoot->rightChild.load(std::memory_order_relaxed);
+    }
+
+    setChild(subRoot->leftChild, detachMinimum(left, minimum));
+    return rebalance(subRoot);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rebalance(Node *subRoot) {
+    subRoot->updateHeight();
+    int balance = subRoot->getBalance();
+    if (balance >= -1 && balance <= 1) {
+        return subRoot;
+    }
+
+    beginRestructuring();
+    if (balance > 1) {
+        auto left = subRoot->leftChild.load(std::memory_order_relaxed);
+        if (left->getBalance() < 0) {
+            subRoot->leftChild.store(rotateLeft(left), std::memory_order_release);  // left-right
+        }
+        return rotateRight(subRoot);
+    }
+
+    auto right = subRoot->rightChild.load(std::memory_order_relaxed);
+    if (right->getBalance() > 0) {
+        subRoot->rightChild.store(rotateRight(right), std::memory_order_release);  // right-left
+    }
+    return rotateLeft(subRoot);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateLeft(Node *rotationRoot) {
+    auto pivot = rotationRoot->rightChild.load(std::memory_order_relaxed);  // Always not null
+    rotationRoot->rightChild.store(pivot->leftChild.load(std::memory_order_relaxed), std::memory_order_release);
+    pivot->leftChild.store(rotationRoot, std::memory_order_release);
+    rotationRoot->updateHeight();
+    pivot->updateHeight();
+    return pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateRight(Node *rotationRoot) {
+    auto pivot = rotationRoot->leftChild.load(std::memory_order_relaxed);  // Always not null
+    rotationRoot->leftChild.store(pivot->rightChild.load(std::memory_order_relaxed), std::memory_order_release);
+    pivot->rightChild.store(rotationRoot, std::memory_order_release);
+    rotationRoot->updateHeight();
+    pivot->updateHeight();
+    return pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::retire(Node *node) {
+    retiredNodes.push_back(node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ConcurrentAVLTree<KeyType, ValueType, Compare, NodeAllocator>::reclaimRetired() {
+    // Readers registering from now on start at the root after the retired nodes were unlinked,
+    // only those registered under the previous parity can still hold them
+    auto previous = epoch.load(std::memory_order_relaxed);
+    epoch.store(previous + 1);
+    // The loads have to be seq_cst like the store above and the reader's increment and epoch check: with weaker
+    // loads the writer could see a zero count while the registering reader still sees the previous epoch
+    for (auto &readerCount : readerCounts[previous & 1]) {
+        while (readerCount.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto node : retiredNodes) {
+        nodeAllocator.destroy(node);
+    }
+    retiredNodes.clear();
+}
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/NodePool.h"
+
+
+/**
+ * AVL tree whose nodes hold no parent pointer
+ *
+ * Insert and remove record the links followed during the descent in a fixed-size path stack and rebalance
+ * bottom-up from it, a rotation rewrites the recorded link instead of a parent's child pointer. Nodes shrink
+ * by the parent pointer and rotations skip the parent stores. The tree keeps no subtree sizes either, so unlike
+ * AVLTree it has no rank or select.
+ *
+ * @tparam KeyType type of the keys
+ * @tparam ValueType type of the values
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam NodeAllocator allocator of the nodes, same concept as in AVLTree
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
+class ParentlessAVLTree {
+private:
+
+    /**
+     * Node of the tree, links point only downwards
+     */
+    struct Node {
+        Node *leftChild;
+        Node *rightChild;
+        KeyType key;
+        ValueType value;
+        int height;
+
+        Node(KeyType const &key, ValueType const &value);
+    };
+
+    /**
+     * Capacity of the path stack, AVL trees addressable by 64-bit sizes are at most 1.44 * 64 < 93 levels high
+     */
+    static const size_t MAX_PATH = 96;
+
+    Node *root;
+
+    size_t elementCount;
+
+    NodeAllocator<Node> nodeAllocator;
+
+    Compare compare;
+
+    /**
+     * Get height of a subtree
+     *
+     * @param node root of the subtree, may be nullptr
+     * @return height, 0 for nullptr
+     */
+    static int nodeHeight(Node const *node);
+
+    /**
+     * Recalculate height of a node from its children
+     *
+     * @param node updated node
+     */
+    static void updateHeight(Node *node);
+
+    /**
+     * Rotate subtree left, the right child becomes the subtree's root
+     *
+     * @param link link pointing to the subtree's root, rewritten to the new root
+     */
+    static void rotateLeft(Node **link);
+
+    /**
+     * Rotate subtree right, the left child becomes the subtree's root
+     *
+     * @param link link pointing to the subtree's root, rewritten to the new root
+     */
+    static void rotateRight(Node **link);
+
+    /**
+     * Restore balance along a recorded path, from its deepest link up to the root
+     *
+     * Stops as soon as a subtree keeps its height without rotating, ancestors above it are unaffected
+     *
+     * @param path links followed from the root, path[0] is &root
+     * @param depth number of recorded links
+     */
+    static void rebalancePath(Node **path[], size_t depth);
+
+    /**
+     * Destroy all nodes of a subtree
+     *
+     * @param subRoot root of the subtree
+     */
+    void destroySubtree(Node *subRoot);
+
+public:
+
+    /**
+     * Initialize empty tree
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit ParentlessAVLTree(Compare const &compare = Compare());
+
+    ~ParentlessAVLTree();
+
+    ParentlessAVLTree(ParentlessAVLTree const &) = delete;
+
+    ParentlessAVLTree &operator=(ParentlessAVLTree const &) = delete;
+
+    /**
+     * Get memory taken by one node, links and height included, without allocator overhead
+     *
+     * @return size of a node in bytes
+     */
+    static size_t nodeBytes();
+
+    /**
+     * Insert key-value pair or replace value of an existing key, iterative with a path stack
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value, nothing happens if the key is not present
+     *
+     * @param key removed key
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value or nullptr if not found
+     */
+    ValueType *find(KeyType const &key);
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value or nullptr if not found
+     */
+    ValueType const *find(KeyType const &key) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Remove all elements
+     */
+    void clear();
+
+    /**
+     * Call visitor for every element in increasing key order, iterative with a stack of ancestors
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param visitor callable invoked for each element
+     */
+    template<typename Visitor>
+    void forEach(Visitor &&visitor) const;
+
+    /**
+     * String representation of the tree in pre-order traversal, same format as AVLTree::toString
+     *
+     * @return pre-order traversal string
+     */
+    std::string toString() const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::Node::Node(KeyType const &key, ValueType const &value)
+        : leftChild(nullptr), rightChild(nullptr), key(key), value(value), height(1) {}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::ParentlessAVLTree(Compare const &compare)
+        : root(nullptr), elementCount(0), compare(compare) {}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::~ParentlessAVLTree() {
+    clear();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::nodeBytes() {
+    return sizeof(Node);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+int ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::nodeHeight(Node const *node) {
+    return node == nullptr ? 0 : node->height;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::updateHeight(Node *node) {
+    auto leftHeight = nodeHeight(node->leftChild);
+    auto rightHeight = nodeHeight(node->rightChild);
+    node->height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateLeft(Node **link) {
+    auto node = *link;
+    auto pivot = node->rightChild;
+    node->rightChild = pivot->leftChild;
+    pivot->leftChild = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    *link = pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rotateRight(Node **link) {
+    auto node = *link;
+    auto pivot = node->leftChild;
+    node->leftChild = pivot->rightChild;
+    pivot->rightChild = node;
+    updateHeight(node);
+    updateHeight(pivot);
+    *link = pivot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::rebalancePath(Node **path[], size_t depth) {
+    while (depth > 0) {
+        auto link = path[--depth];
+        auto node = *link;
+        auto oldHeight = node->height;
+        updateHeight(node);
+        auto balance = nodeHeight(node->leftChild) - nodeHeight(node->rightChild);
+
+        if (balance > 1) {
+            if (nodeHeight(node->leftChild->leftChild) < nodeHeight(node->leftChild->rightChild)) {
+                rotateLeft(&node->leftChild);
+            }
+            rotateRight(link);
+        } else if (balance < -1) {
+            if (nodeHeight(node->rightChild->rightChild) < nodeHeight(node->rightChild->leftChild)) {
+                rotateRight(&node->rightChild);
+            }
+            rotateLeft(link);
+        } else if (node->height == oldHeight) {
+            return;
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::insert(KeyType const &key, ValueType const &value) {
+    Node **path[MAX_PATH];
+    size_t depth = 0;
+    auto link = &root;
+    while (*link != nullptr) {
+        auto order = compare(key, (*link)->key);
+        if (order == 0) {
+            (*link)->value = value;
+            return;
+        }
+        path[depth++] = link;
+        link = (order < 0) ? &(*link)->leftChild : &(*link)->rightChild;
+    }
+
+    *link = nodeAllocator.create(key, value);
+    ++elementCount;
+    rebalancePath(path, depth);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::remove(KeyType const &key) {
+    Node **path[MAX_PATH];
+    size_t depth = 0;
+    auto link = &root;
+    while (*link != nullptr) {
+        auto order = compare(key, (*link)->key);
+        if (order == 0) {
+            break;
+        }
+        path[depth++] = link;
+        link = (order < 0) ? &(*link)->leftChild : &(*link)->rightChild;
+    }
+    auto removed = *link;
+    if (removed == nullptr) {
+        return;
+    }
+
+    if (removed->leftChild == nullptr || removed->rightChild == nullptr) {
+        *link = (removed->leftChild != nullptr) ? removed->leftChild : removed->rightChild;
+    } else {
+        // The successor is unlinked from the right subtree and takes the removed node's place
+        auto removedDepth = depth;
+        path[depth++] = link;
+        auto successorLink = &removed->rightChild;
+        while ((*successorLink)->leftChild != nullptr) {
+            path[depth++] = successorLink;
+            successorLink = &(*successorLink)->leftChild;
+        }
+        auto successor = *successorLink;
+        *successorLink = successor->rightChild;
+
+        successor->leftChild = removed->leftChild;
+        successor->rightChild = removed->rightChild;
+        successor->height = removed->height;
+        *link = successor;
+        // The link below the replaced node belonged to the removed node
+        if (removedDepth + 1 < depth) {
+            path[removedDepth + 1] = &successor->rightChild;
+        }
+    }
+
+    nodeAllocator.destroy(removed);
+    --elementCount;
+    rebalancePath(path, depth);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType *ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::find(KeyType const &key) {
+    auto node = root;
+    while (node != nullptr) {
+        auto order = compare(key, node->key);
+        if (order == 0) {
+            return &node->value;
+        }
+        node = (order < 0) ? node->leftChild : node->rightChild;
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType const *ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::find(KeyType const &key) const {
+    return const_cast<ParentlessAVLTree *>(this)->find(key);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::contains(KeyType const &key) const {
+    return find(key) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::size() const {
+    return elementCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot) {
+    while (subRoot != nullptr) {
+        if (subRoot->leftChild != nullptr) {
+            // Rotate right without maintaining heights, the nodes are about to be destroyed
+            auto left = subRoot->leftChild;
+            subRoot->leftChild = left->rightChild;
+            left->rightChild = subRoot;
+            subRoot = left;
+        } else {
+            auto right = subRoot->rightChild;
+            nodeAllocator.destroy(subRoot);
+            subRoot = right;
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::clear() {
+    if (!NodeAllocator<Node>::RELEASES_IN_BULK || !std::is_trivially_destructible<Node>::value) {
+        destroySubtree(root);
+    }
+    nodeAllocator.releaseAll();
+    root = nullptr;
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Visitor>
+void ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::forEach(Visitor &&visitor) const {
+    std::vector<Node const *> ancestors;
+    Node const *node = root;
+    while (node != nullptr || !ancestors.empty()) {
+        while (node != nullptr) {
+            ancestors.push_back(node);
+            node = node->leftChild;
+        }
+        node = ancestors.back();
+        ancestors.pop_back();
+        visitor(static_cast<KeyType const &>(node->key), static_cast<ValueType const &>(node->value));
+        node = node->rightChild;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string ParentlessAVLTree<KeyType, ValueType, Compare, NodeAllocator>::toString() const {
+    // Stack item is either a node to expand or a literal to emit
+    struct Item {
+        Node const *node;
+        char const *literal;
+    };
+
+    std::ostringstream stringStream;
+    std::vector<Item> stack;
+    stack.push_back({root, nullptr});
+    while (!stack.empty()) {
+        auto item = stack.back();
+        stack.pop_back();
+
+        if (item.literal != nullptr) {
+            stringStream << item.literal;
+        } else if (item.node != nullptr) {
+            stringStream << "([" << item.node->key << "," << item.node->value << "],";
+            stack.push_back({nullptr, ")"});
+            stack.push_back({item.node->rightChild, nullptr});
+            stack.push_back({nullptr, ","});
+            stack.push_back({item.node->leftChild, nullptr});
+        }
+    }
+    return stringStream.str();
+}
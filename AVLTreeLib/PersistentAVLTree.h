@@ -0,0 +1,500 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include "../CommonLib/Compare.h"
+
+
+/**
+ * Persistent AVL tree - insert and remove copy only the path from the root to the changed node
+ *
+ * Nodes are immutable and shared between versions of the tree through reference counted pointers,
+ * untouched subtrees are never copied. A snapshot is a handle to the current root taken in O(1),
+ * it stays unchanged by later writes and its nodes are freed when the last version referencing them is gone.
+ *
+ * The tree itself is meant for a single writer thread, snapshots can be handed over to and queried from
+ * any number of other threads without locks.
+ *
+ * @tparam KeyType type of the keys, copied along the modified path
+ * @tparam ValueType type of the values, copied along the modified path
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>>
+class PersistentAVLTree {
+private:
+
+    struct Node;
+
+    /**
+     * Shared reference to an immutable node
+     */
+    typedef std::shared_ptr<Node const> NodePtr;
+
+    /**
+     * Immutable node, children are shared with other versions of the tree
+     */
+    struct Node {
+        KeyType key;
+        ValueType value;
+        int height;
+        NodePtr leftChild;
+        NodePtr rightChild;
+
+        /**
+         * Initialize node with given key, value and children, height is calculated from the children
+         *
+         * @param key node's key
+         * @param value node's value
+         * @param leftChild root of the left subtree
+         * @param rightChild root of the right subtree
+         */
+        Node(KeyType const &key, ValueType const &value, NodePtr leftChild, NodePtr rightChild);
+
+        /**
+         * Utility for accessing node's height, null safe
+         *
+         * @param node root node of a tree
+         * @return height of the subtree with given root (0 for nullptr)
+         */
+        static int nodeHeight(NodePtr const &node);
+    };
+
+    NodePtr root;
+
+    size_t elementCount;
+
+    Compare compare;
+
+    /**
+     * Find node with given key in a subtree
+     *
+     * @param subRoot root node of the subtree
+     * @param key searched key
+     * @param compare comparator of the keys
+     * @return found node or nullptr
+     */
+    static Node const *findNode(Node const *subRoot, KeyType const &key, Compare const &compare);
+
+    /**
+     * Create node out of a key-value pair and two subtrees whose heights differ by at most 2,
+     * rotating copies of the taller side's nodes to restore AVL property
+     *
+     * @param key key of the new node
+     * @param value value of the new node
+     * @param left left subtree, all keys less than key
+     * @param right right subtree, all keys greater than key
+     * @return root of the balanced subtree
+     */
+    static NodePtr balance(KeyType const &key, ValueType const &value, NodePtr const &left, NodePtr const &right);
+
+    /**
+     * Insert key-value pair into a subtree, copying the nodes on the path to it
+     *
+     * @param subRoot root node of the subtree
+     * @param key inserted key
+     * @param value inserted value
+     * @param inserted set to true if the key was not present before
+     * @return root node of the new version of the subtree
+     */
+    NodePtr insertInto(NodePtr const &subRoot, KeyType const &key, ValueType const &value, bool &inserted) const;
+
+    /**
+     * Remove key from a subtree, copying the nodes on the path to it
+     *
+     * @param subRoot root node of the subtree
+     * @param key removed key
+     * @return root node of the new version of the subtree, subRoot itself if the key is not present
+     */
+    NodePtr removeFrom(NodePtr const &subRoot, KeyType const &key) const;
+
+    /**
+     * Remove node with the smallest key from a subtree
+     *
+     * @param subRoot root node of the subtree, not null
+     * @param minimum set to the removed node
+     * @return root node of the new version of the subtree
+     */
+    static NodePtr removeMinimum(NodePtr const &subRoot, Node const *&minimum);
+
+    /**
+     * Call visitor on every element of a subtree in key order
+     *
+     * @param subRoot root node of the subtree
+     * @param visitor callable (key, value)
+     */
+    template<typename Visitor>
+    static void forEachInSubtree(Node const *subRoot, Visitor &visitor);
+
+    /**
+     * Write string representation of a subtree like AVLTree::toString directly to a stream
+     *
+     * @param stream output stream
+     * @param subRoot root node of the subtree
+     */
+    static void writeSubtree(std::ostream &stream, Node const *subRoot);
+
+public:
+
+    /**
+     * Read-only view of the tree at the moment it was taken
+     *
+     * Copying a snapshot shares all nodes, snapshots are safe to use concurrently with the tree's writer
+     * as long as each thread uses its own handle
+     */
+    class Snapshot {
+    private:
+        friend class PersistentAVLTree;
+
+        NodePtr root;
+        size_t elementCount;
+        Compare compare;
+
+        Snapshot(NodePtr root, size_t elementCount, Compare const &compare);
+
+    public:
+
+        /**
+         * Initialize snapshot of an empty tree
+         */
+        Snapshot();
+
+        /**
+         * Find value associated with key
+         *
+         * @param key searched key
+         * @return pointer to the value, valid while the snapshot exists, or nullptr if not found
+         */
+        ValueType const *find(KeyType const &key) const;
+
+        /**
+         * Check whether key is present
+         *
+         * @param key searched key
+         * @return whether key is present
+         */
+        bool contains(KeyType const &key) const;
+
+        /**
+         * Get number of elements in the snapshot
+         *
+         * @return number of elements
+         */
+        size_t size() const;
+
+        /**
+         * Call visitor on every element in key order
+         *
+         * @param visitor callable (KeyType const &, ValueType const &)
+         */
+        template<typename Visitor>
+        void forEach(Visitor visitor) const;
+    };
+
+    /**
+     * Initialize empty tree
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit PersistentAVLTree(Compare const &compare = Compare());
+
+    /**
+     * Insert key-value pair or replace value of an existing key, O(log n) new nodes
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value, nothing is copied if the key is not present
+     *
+     * @param key removed key
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value, valid until the next modification, or nullptr if not found
+     */
+    ValueType const *find(KeyType const &key) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Remove all elements, nodes shared with snapshots stay alive
+     */
+    void clear();
+
+    /**
+     * Take O(1) snapshot of the current state
+     *
+     * @return read-only view unaffected by later modifications
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * Generate string representation of the tree ([key,value],left subtree,right subtree)
+     *
+     * @return string representation of the tree
+     */
+    std::string toString() const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+PersistentAVLTree<KeyType, ValueType, Compare>::Node::Node(KeyType const &key, ValueType const &value,
+                                                           NodePtr leftChild, NodePtr rightChild)
+        : key(key), value(value), leftChild(std::move(leftChild)), rightChild(std::move(rightChild)) {
+    auto leftHeight = nodeHeight(this->leftChild);
+    auto rightHeight = nodeHeight(this->rightChild);
+    height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+int PersistentAVLTree<KeyType, ValueType, Compare>::Node::nodeHeight(NodePtr const &node) {
+    return node == nullptr ? 0 : node->height;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+PersistentAVLTree<KeyType, ValueType, Compare>::PersistentAVLTree(Compare const &compare)
+        : elementCount(0), compare(compare) {}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::Node const *
+PersistentAVLTree<KeyType, ValueType, Compare>::findNode(Node const *subRoot, KeyType const &key,
+                                                         Compare const &compare) {
+    while (subRoot != nullptr) {
+        auto order = compare(key, subRoot->key);
+        if (order == 0) {
+            return subRoot;
+        }
+        subRoot = (order < 0) ? subRoot->leftChild.get() : subRoot->rightChild.get();
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::NodePtr
+PersistentAVLTree<KeyType, ValueType, Compare>::balance(KeyType const &key, ValueType const &value,
+                                                        NodePtr const &left, NodePtr const &right) {
+    auto leftHeight = Node::nodeHeight(left);
+    auto rightHeight = Node::nodeHeight(right);
+
+    if (leftHeight > rightHeight + 1) {
+        if (Node::nodeHeight(left->leftChild) >= Node::nodeHeight(left->rightChild)) {
+            // left-left, single right rotation
+            auto lowered = std::make_shared<Node const>(key, value, left->rightChild, right);
+            return std::make_shared<Node const>(left->key, left->value, left->leftChild, lowered);
+        }
+        // left-right, the left child's right child becomes the root
+        auto pivot = left->rightChild;
+        auto newLeft = std::make_shared<Node const>(left->key, left->value, left->leftChild, pivot->leftChild);
+        auto newRight = std::make_shared<Node const>(key, value, pivot->rightChild, right);
+        return std::make_shared<Node const>(pivot->key, pivot->value, newLeft, newRight);
+    }
+
+    if (rightHeight > leftHeight + 1) {
+        if (Node::nodeHeight(right->rightChild) >= Node::nodeHeight(right->leftChild)) {
+            // right-right, single left rotation
+            auto lowered = std::make_shared<Node const>(key, value, left, right->leftChild);
+            return std::make_shared<Node const>(right->key, right->value, lowered, right->rightChild);
+        }
+        // right-left, the right child's left child becomes the root
+        auto pivot = right->leftChild;
+        auto newLeft = std::make_shared<Node const>(key, value, left, pivot->leftChild);
+        auto newRight = std::make_shared<Node const>(right->key, right->value, pivot->rightChild, right->rightChild);
+        return std::make_shared<Node const>(pivot->key, pivot->value, newLeft, newRight);
+    }
+
+    return std::make_shared<Node const>(key, value, left, right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::NodePtr
+PersistentAVLTree<KeyType, ValueType, Compare>::insertInto(NodePtr const &subRoot, KeyType const &key,
+                                                           ValueType const &value, bool &inserted) const {
+    // Recursion depth is the height of the tree
+    if (subRoot == nullptr) {
+        inserted = true;
+        return std::make_shared<Node const>(key, value, nullptr, nullptr);
+    }
+
+    auto order = compare(key, subRoot->key);
+    if (order == 0) {
+        return std::make_shared<Node const>(subRoot->key, value, subRoot->leftChild, subRoot->rightChild);
+    }
+    if (order < 0) {
+        return balance(subRoot->key, subRoot->value,
+                       insertInto(subRoot->leftChild, key, value, inserted), subRoot->rightChild);
+    }
+    return balance(subRoot->key, subRoot->value,
+                   subRoot->leftChild, insertInto(subRoot->rightChild, key, value, inserted));
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::NodePtr
+PersistentAVLTree<KeyType, ValueType, Compare>::removeFrom(NodePtr const &subRoot, KeyType const &key) const {
+    if (subRoot == nullptr) {
+        return subRoot;
+    }
+
+    auto order = compare(key, subRoot->key);
+    if (order < 0) {
+        auto left = removeFrom(subRoot->leftChild, key);
+        return (left == subRoot->leftChild) ? subRoot : balance(subRoot->key, subRoot->value, left,
+                                                                subRoot->rightChild);
+    }
+    if (order > 0) {
+        auto right = removeFrom(subRoot->rightChild, key);
+        return (right == subRoot->rightChild) ? subRoot : balance(subRoot->key, subRoot->value,
+                                                                  subRoot->leftChild, right);
+    }
+
+    if (subRoot->leftChild == nullptr) {
+        return subRoot->rightChild;
+    }
+    if (subRoot->rightChild == nullptr) {
+        return subRoot->leftChild;
+    }
+
+    // Successor takes the removed node's place
+    Node const *successor = nullptr;
+    auto right = removeMinimum(subRoot->rightChild, successor);
+    return balance(successor->key, successor->value, subRoot->leftChild, right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::NodePtr
+PersistentAVLTree<KeyType, ValueType, Compare>::removeMinimum(NodePtr const &subRoot, Node const *&minimum) {
+    if (subRoot->leftChild == nullptr) {
+        minimum = subRoot.get();
+        return subRoot->rightChild;
+    }
+    return balance(subRoot->key, subRoot->value, removeMinimum(subRoot->leftChild, minimum), subRoot->rightChild);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+void PersistentAVLTree<KeyType, ValueType, Compare>::insert(KeyType const &key, ValueType const &value) {
+    bool inserted = false;
+    root = insertInto(root, key, value, inserted);
+    if (inserted) {
+        ++elementCount;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+void PersistentAVLTree<KeyType, ValueType, Compare>::remove(KeyType const &key) {
+    auto newRoot = removeFrom(root, key);
+    if (newRoot != root) {
+        --elementCount;
+        root = std::move(newRoot);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+ValueType const *PersistentAVLTree<KeyType, ValueType, Compare>::find(KeyType const &key) const {
+    auto node = findNode(root.get(), key, compare);
+    return node == nullptr ? nullptr : &node->value;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+bool PersistentAVLTree<KeyType, ValueType, Compare>::contains(KeyType const &key) const {
+    return findNode(root.get(), key, compare) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t PersistentAVLTree<KeyType, ValueType, Compare>::size() const {
+    return elementCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+void PersistentAVLTree<KeyType, ValueType, Compare>::clear() {
+    root.reset();
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+typename PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot
+PersistentAVLTree<KeyType, ValueType, Compare>::snapshot() const {
+    return Snapshot(root, elementCount, compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename Visitor>
+void PersistentAVLTree<KeyType, ValueType, Compare>::forEachInSubtree(Node const *subRoot, Visitor &visitor) {
+    if (subRoot == nullptr) {
+        return;
+    }
+    forEachInSubtree(subRoot->leftChild.get(), visitor);
+    visitor(subRoot->key, subRoot->value);
+    forEachInSubtree(subRoot->rightChild.get(), visitor);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+void PersistentAVLTree<KeyType, ValueType, Compare>::writeSubtree(std::ostream &stream, Node const *subRoot) {
+    // Recursion depth is the height of the tree
+    if (subRoot == nullptr) {
+        return;
+    }
+
+    stream << "([" << subRoot->key << "," << subRoot->value << "],";
+    writeSubtree(stream, subRoot->leftChild.get());
+    stream << ",";
+    writeSubtree(stream, subRoot->rightChild.get());
+    stream << ")";
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+std::string PersistentAVLTree<KeyType, ValueType, Compare>::toString() const {
+    std::ostringstream stringStream;
+    writeSubtree(stringStream, root.get());
+    return stringStream.str();
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::Snapshot()
+        : elementCount(0) {}
+
+template<typename KeyType, typename ValueType, typename Compare>
+PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::Snapshot(NodePtr root, size_t elementCount,
+                                                                   Compare const &compare)
+        : root(std::move(root)), elementCount(elementCount), compare(compare) {}
+
+template<typename KeyType, typename ValueType, typename Compare>
+ValueType const *PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::find(KeyType const &key) const {
+    auto node = findNode(root.get(), key, compare);
+    return node == nullptr ? nullptr : &node->value;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+bool PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::contains(KeyType const &key) const {
+    return findNode(root.get(), key, compare) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::size() const {
+    return elementCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename Visitor>
+void PersistentAVLTree<KeyType, ValueType, Compare>::Snapshot::forEach(Visitor visitor) const {
+    forEachInSubtree(root.get(), visitor);
+}
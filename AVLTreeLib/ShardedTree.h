@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "AVLTree.h"
+
+
+/**
+ * Concurrent map partitioning keys across independent AVLTree shards, each guarded by its own mutex
+ *
+ * Operations on keys of different shards proceed in parallel, so writers do not serialize on a single root.
+ * Keys are assigned to shards either by hash, spreading any key distribution evenly, or by ranges between
+ * sorted split keys, which keeps scans ordered across shards.
+ *
+ * Scans lock one shard at a time, they see each shard consistently but not the whole map at a single moment.
+ *
+ * @tparam KeyType type of the keys
+ * @tparam ValueType type of the values, copied out by lookups
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam Hash hash of the keys used by hash partitioning
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        typename Hash = std::hash<KeyType>>
+class ShardedTree {
+private:
+
+    /**
+     * Partition with its own lock, allocated separately so that locks of different shards do not share cache lines
+     */
+    struct Shard {
+        std::mutex mutex;
+        AVLTree<KeyType, ValueType, Compare> tree;
+
+        explicit Shard(Compare const &compare);
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    /**
+     * Sorted lower bounds of shards 1..n-1 in range partitioning, empty in hash partitioning
+     */
+    std::vector<KeyType> splitKeys;
+
+    Compare compare;
+
+    Hash hash;
+
+    /**
+     * Get shard responsible for a key
+     *
+     * @param key examined key
+     * @return index of the shard
+     */
+    size_t shardIndex(KeyType const &key) const;
+
+public:
+
+    /**
+     * Initialize hash partitioned map
+     *
+     * Scans visit shards one after another, keys are ordered only within a shard
+     *
+     * @param shardCount number of shards, at least 1
+     * @param compare three-way comparator of the keys
+     * @param hash hash of the keys
+     */
+    explicit ShardedTree(size_t shardCount, Compare const &compare = Compare(), Hash const &hash = Hash());
+
+    /**
+     * Initialize range partitioned map with splitKeys.size() + 1 shards
+     *
+     * Shard 0 holds keys less than splitKeys[0], shard i holds keys in [splitKeys[i - 1], splitKeys[i]),
+     * the last shard holds the rest. Scans visit keys in increasing order.
+     *
+     * @param splitKeys strictly increasing shard boundaries
+     * @param compare three-way comparator of the keys
+     */
+    explicit ShardedTree(std::vector<KeyType> splitKeys, Compare const &compare = Compare());
+
+    /**
+     * Get number of shards
+     *
+     * @return number of shards
+     */
+    size_t shardCount() const;
+
+    /**
+     * Check whether scans visit keys in increasing order across shards
+     *
+     * @return true for range partitioning
+     */
+    bool isRangePartitioned() const;
+
+    /**
+     * Insert key-value pair or replace value of an existing key, locks only the key's shard
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value, nothing happens if the key is not present
+     *
+     * @param key removed key
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Copy value associated with key
+     *
+     * @param key searched key
+     * @param value set to a copy of the found value, untouched if the key is not present
+     * @return whether the key is present
+     */
+    bool find(KeyType const &key, ValueType &value) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Get number of stored elements, summed over shards locked one at a time
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Call visitor for every element, in increasing key order in range partitioning
+     *
+     * The visitor runs with a shard locked and must not call back into the map
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param visitor callable invoked for each element
+     */
+    template<typename Visitor>
+    void forEach(Visitor &&visitor) const;
+
+    /**
+     * Call visitor for every key in range [lo, hi] (inclusive), in increasing order in range partitioning
+     *
+     * Range partitioning visits only the shards overlapping the range, hash partitioning searches all of them.
+     * The visitor runs with a shard locked and must not call back into the map
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @param visitor callable invoked for each key in the range
+     */
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+ShardedTree<KeyType, ValueType, Compare, Hash>::Shard::Shard(Compare const &compare)
+        : tree(compare) {}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+ShardedTree<KeyType, ValueType, Compare, Hash>::ShardedTree(size_t shardCount, Compare const &compare,
+                                                            Hash const &hash)
+        : compare(compare), hash(hash) {
+    if (shardCount == 0) {
+        shardCount = 1;
+    }
+    for (size_t idx = 0; idx < shardCount; ++idx) {
+        shards.emplace_back(new Shard(compare));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+ShardedTree<KeyType, ValueType, Compare, Hash>::ShardedTree(std::vector<KeyType> splitKeys, Compare const &compare)
+        : splitKeys(std::move(splitKeys)), compare(compare) {
+    for (size_t idx = 0; idx <= this->splitKeys.size(); ++idx) {
+        shards.emplace_back(new Shard(compare));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+size_t ShardedTree<KeyType, ValueType, Compare, Hash>::shardIndex(KeyType const &key) const {
+    if (splitKeys.empty()) {
+        // Identity hashes of integers would map strided keys to few shards, multiplying mixes the high bits in
+        auto mixed = ((std::uint64_t) hash(key) * 0x9E3779B97F4A7C15ULL) >> 32;
+        return (size_t) (mixed % shards.size());
+    }
+
+    // Number of split keys not greater than key
+    size_t low = 0;
+    size_t high = splitKeys.size();
+    while (low < high) {
+        auto middle = low + (high - low) / 2;
+        if (compare(splitKeys[middle], key) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+size_t ShardedTree<KeyType, ValueType, Compare, Hash>::shardCount() const {
+    return shards.size();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+bool ShardedTree<KeyType, ValueType, Compare, Hash>::isRangePartitioned() const {
+    return !splitKeys.empty();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+void ShardedTree<KeyType, ValueType, Compare, Hash>::insert(KeyType const &key, ValueType const &value) {
+    auto &shard = *shards[shardIndex(key)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.tree.insert(key, value);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+void ShardedTree<KeyType, ValueType, Compare, Hash>::remove(KeyType const &key) {
+    auto &shard = *shards[shardIndex(key)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.tree.remove(key);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+bool ShardedTree<KeyType, ValueType, Compare, Hash>::find(KeyType const &key, ValueType &value) const {
+    auto &shard = *shards[shardIndex(key)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.tree.find(key);
+    if (found != nullptr) {
+        value = *found;
+    }
+    return found != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+bool ShardedTree<KeyType, ValueType, Compare, Hash>::contains(KeyType const &key) const {
+    auto &shard = *shards[shardIndex(key)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.tree.find(key) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+size_t ShardedTree<KeyType, ValueType, Compare, Hash>::size() const {
+    size_t total = 0;
+    for (auto const &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->tree.size();
+    }
+    return total;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+template<typename Visitor>
+void ShardedTree<KeyType, ValueType, Compare, Hash>::forEach(Visitor &&visitor) const {
+    for (auto const &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        AVLTree<KeyType, ValueType, Compare> const &tree = shard->tree;
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            visitor(it.key(), it.value());
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, typename Hash>
+template<typename Visitor>
+void ShardedTree<KeyType, ValueType, Compare, Hash>::forEachInRange(KeyType const &lo, KeyType const &hi,
+                                                                    Visitor &&visitor) const {
+    size_t first = 0;
+    size_t last = shards.size() - 1;
+    if (isRangePartitioned()) {
+        first = shardIndex(lo);
+        last = shardIndex(hi);
+    }
+
+    for (auto idx = first; idx <= last && idx < shards.size(); ++idx) {
+        std::lock_guard<std::mutex> lock(shards[idx]->mutex);
+        AVLTree<KeyType, ValueType, Compare> const &tree = shards[idx]->tree;
+        tree.forEachInRange(lo, hi, visitor);
+    }
+}
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "../benchmark/benchmark.h"
+#include "../AVLTreeLib/AVLTree.h"
+#include "../BTreeLib/BTree.h"
+
+/**
+ * Creation, search and removal times of one tree type on the AVL benchmark's workload
+ */
+struct Timings {
+    size_t creationNanos;
+    size_t searchNanos;
+    size_t removalNanos;
+    size_t foundKeys;
+};
+
+/**
+ * Measure a tree type on random unsigned long keys
+ *
+ * Creation inserts the first sampleSize numbers, search looks up the first sampleSize numbers in a tree
+ * of all numbers and removal removes the first sampleSize numbers in shuffled order from a tree of all numbers
+ *
+ * @tparam TreeType examined tree with insert, find and remove
+ * @param numbers random keys
+ * @param sampleSize number of timed operations
+ * @param shuffleSeed seed of the removal order, shared by all tree types
+ * @return measured times
+ */
+template<typename TreeType>
+Timings measureTree(std::vector<unsigned long> const &numbers, size_t sampleSize, unsigned shuffleSeed) {
+    Timings timings{};
+    {
+        Benchmark<std::chrono::nanoseconds> timer;
+        TreeType tree;
+        for (size_t idx = 0; idx < sampleSize; idx++) {
+            tree.insert(numbers[idx], numbers[idx]);
+        }
+        timings.creationNanos = timer.elapsed();
+    }
+
+    TreeType tree;
+    for (auto number : numbers) {
+        tree.insert(number, number);
+    }
+
+    Benchmark<std::chrono::nanoseconds> searchTimer;
+    // Counting found keys keeps the lookups from being optimized away
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        timings.foundKeys += tree.find(numbers[idx]) != nullptr;
+    }
+    timings.searchNanos = searchTimer.elapsed();
+
+    std::vector<size_t> indices;
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        indices.push_back(idx);
+    }
+    std::shuffle(indices.begin(), indices.end(), std::default_random_engine(shuffleSeed));
+
+    Benchmark<std::chrono::nanoseconds> removalTimer;
+    for (auto index : indices) {
+        tree.remove(numbers[index]);
+    }
+    timings.removalNanos = removalTimer.elapsed();
+    return timings;
+}
+
+int main() {
+    std::vector<int> sampleSizes = {10000, 20000, 30000, 40000, 50000, 60000, 70000, 80000, 90000, 100000};
+
+    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 generator((unsigned long) seed);
+    std::vector<unsigned long> randomNumbers;
+    for (int i = 0; i < sampleSizes[sampleSizes.size() - 1]; i++) {
+        randomNumbers.push_back(generator());
+    }
+
+    std::map<int, Timings> avlTimings, bTreeTimings;
+    for (auto sampleSize : sampleSizes) {
+        auto shuffleSeed = (unsigned) generator();
+        avlTimings[sampleSize] = measureTree<AVLTree<unsigned long, unsigned long>>(
+                randomNumbers, sampleSize, shuffleSeed);
+        bTreeTimings[sampleSize] = measureTree<BTree<unsigned long, unsigned long>>(
+                randomNumbers, sampleSize, shuffleSeed);
+    }
+
+    std::cout << "B-tree node search: " << BTree<unsigned long, unsigned long>::searchKernel() << "\n";
+
+    std::cout << "Creation time benchmark\nSize\tAVL (ns)\tB-tree (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t" << avlTimings[sampleSize].creationNanos << "\t"
+                  << bTreeTimings[sampleSize].creationNanos << std::endl;
+    }
+
+    std::cout << "Search time benchmark\nSize\tAVL (ns)\tB-tree (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t" << avlTimings[sampleSize].searchNanos << "\t"
+                  << bTreeTimings[sampleSize].searchNanos << std::endl;
+        if (avlTimings[sampleSize].foundKeys != bTreeTimings[sampleSize].foundKeys) {
+            std::cerr << "Trees found different numbers of keys\n";
+        }
+    }
+
+    std::cout << "Removal time benchmark\nSize\tAVL (ns)\tB-tree (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t" << avlTimings[sampleSize].removalNanos << "\t"
+                  << bTreeTimings[sampleSize].removalNanos << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,740 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/NodePool.h"
+#include "NodeSearch.h"
+
+
+/**
+ * Generic implementation of B-tree - balanced multiway search tree with unique keys.
+ *
+ * Every node except the root holds between MIN_DEGREE - 1 and 2 * MIN_DEGREE - 1 keys, all leaves are
+ * on the same level. Node's keys fill KEY_LINES cache lines and are stored apart from values and children,
+ * so the search inside a node reads only keys, vectorized for integer keys (see NodeSearch).
+ * Insertion and removal work top-down in a single pass, splitting full nodes and refilling
+ * minimal ones on the way down.
+ *
+ * @tparam KeyType type of the keys, has to be default constructible
+ * @tparam ValueType type of the values, has to be default constructible
+ * @tparam Compare three-way comparator of the keys, returns negative, zero or positive int (see ThreeWayCompare)
+ * @tparam NodeAllocator allocator of the tree's nodes (NodePool or HeapAllocator)
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
+class BTree {
+private:
+
+    /**
+     * Size of a cache line in bytes
+     */
+    static const size_t CACHE_LINE_BYTES = 64;
+
+    /**
+     * Number of cache lines taken by a node's keys
+     */
+    static const size_t KEY_LINES = 4;
+
+    /**
+     * Size of a node's key array, whole cache lines of keys with at least 4 slots
+     */
+    static const size_t KEY_CAPACITY = (KEY_LINES * CACHE_LINE_BYTES / sizeof(KeyType) >= 4)
+                                       ? KEY_LINES * CACHE_LINE_BYTES / sizeof(KeyType) : 4;
+
+    /**
+     * Minimum degree of the tree, a full node has 2 * MIN_DEGREE - 1 keys, one slot of the key array is spare
+     */
+    static const size_t MIN_DEGREE = KEY_CAPACITY / 2;
+
+    /**
+     * Maximum number of keys in a node
+     */
+    static const size_t MAX_KEYS = 2 * MIN_DEGREE - 1;
+
+    /**
+     * Number of spaces per nesting level when displaying tree
+     */
+    static const auto PRINT_NEST_INDENT = 4;
+
+    /**
+     * Leaf node of a B-tree, also the common part of internal nodes
+     *
+     * Keys come first and the node starts at a cache line boundary, so that a node's search touches only
+     * its first KEY_LINES cache lines
+     */
+    struct alignas(CACHE_LINE_BYTES) Node {
+        KeyType keys[KEY_CAPACITY];
+        ValueType values[KEY_CAPACITY];
+        unsigned count;
+        bool leaf;
+
+        /**
+         * Initialize empty node, all key slots are value-initialized for the vectorized search
+         *
+         * @param leaf whether the node has no children
+         */
+        explicit Node(bool leaf);
+
+        /**
+         * Default string representation of node's entries [<key>,<value>][<key>,<value>]...
+         *
+         * @param separator inserted after each comma
+         * @return string representation of node's entries
+         */
+        std::string toString(std::string const &separator = "") const;
+    };
+
+    /**
+     * Internal node of a B-tree, has count + 1 children
+     */
+    struct InternalNode : Node {
+        Node *children[KEY_CAPACITY + 1];
+
+        InternalNode();
+    };
+
+    /**
+     * Root node of the tree
+     */
+    Node *root;
+
+    /**
+     * Number of elements stored in the tree
+     */
+    size_t elementCount;
+
+    /**
+     * Allocator owning the leaves
+     */
+    NodeAllocator<Node> leafAllocator;
+
+    /**
+     * Allocator owning the internal nodes
+     */
+    NodeAllocator<InternalNode> internalAllocator;
+
+    /**
+     * Three-way comparator of the keys
+     */
+    Compare compare;
+
+    /**
+     * Get position of the first key not less than given key in a node
+     *
+     * @param node searched node
+     * @param key searched key
+     * @return number of node's keys less than key
+     */
+    size_t lowerBound(Node const *node, KeyType const &key) const;
+
+    /**
+     * Utility for accessing children of a node known to be internal
+     *
+     * @param node internal node
+     * @param idx position of the child
+     * @return idx-th child
+     */
+    static Node *&child(Node *node, size_t idx);
+
+    /**
+     * Give node back to the allocator it came from
+     *
+     * @param node destroyed node
+     */
+    void destroyNode(Node *node);
+
+    /**
+     * Destroy all nodes of a subtree, recursion depth is the tree's height
+     *
+     * @param subRoot root node of the subtree to destroy
+     */
+    void destroySubtree(Node *subRoot);
+
+    /**
+     * Move key, value and child at position idx of a node one slot to the right
+     */
+    static void shiftRight(Node *node, size_t idx);
+
+    /**
+     * Split full child of a node into two nodes of MIN_DEGREE - 1 keys, its median key moves up to the parent
+     *
+     * @param parent non-full internal node
+     * @param idx position of the full child
+     */
+    void splitChild(Node *parent, size_t idx);
+
+    /**
+     * Merge child idx + 1 of a node and the separating key into child idx
+     *
+     * Both children have MIN_DEGREE - 1 keys, so the result is full
+     *
+     * @param parent internal node with at least one key (or the root)
+     * @param idx position of the left child
+     */
+    void mergeChildren(Node *parent, size_t idx);
+
+    /**
+     * Make sure child idx of a node has at least MIN_DEGREE keys before descending into it
+     *
+     * Borrows a key through the parent from a sibling with spare keys, or merges with a sibling
+     *
+     * @param parent internal node
+     * @param idx position of the child
+     * @return position of the child to descend into, changes when merged with its left sibling
+     */
+    size_t refillChild(Node *parent, size_t idx);
+
+    /**
+     * Remove key from a subtree whose root has at least MIN_DEGREE keys (or is the tree's root)
+     *
+     * @param subRoot root node of the subtree
+     * @param key key to remove
+     * @return whether the key was present
+     */
+    bool removeFromSubtree(Node *subRoot, KeyType const &key);
+
+    /**
+     * Print subtree on given indentation level, one line per node
+     *
+     * @tparam StreamType type of the output stream
+     * @param stream output stream
+     * @param subRoot root node of the subtree to print
+     * @param indent number of spaces
+     */
+    template<typename StreamType>
+    static void printSubtree(StreamType &stream, Node const *subRoot, int indent);
+
+    /**
+     * Write string representation of the subtree (<entries>,<child>,<child>...) directly to a stream
+     *
+     * Recursion depth is the height of the tree, which stays small for any realistic size
+     *
+     * @tparam StreamType type of the output stream
+     * @param stream output stream
+     * @param subRoot root node of the subtree
+     */
+    template<typename StreamType>
+    static void writeSubtree(StreamType &stream, Node const *subRoot);
+
+public:
+
+    /**
+     * Initialize empty tree
+     */
+    BTree();
+
+    /**
+     * Initialize empty tree ordered by given comparator
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit BTree(Compare const &compare);
+
+    BTree(BTree const &other) = delete;
+
+    BTree &operator=(BTree const &other) = delete;
+
+    /**
+     * Take over nodes of another tree in O(1), leaving it empty
+     *
+     * @param other moved tree
+     */
+    BTree(BTree &&other) noexcept;
+
+    /**
+     * Replace contents with nodes of another tree in O(1), leaving it empty
+     *
+     * @param other moved tree
+     * @return this tree
+     */
+    BTree &operator=(BTree &&other) noexcept;
+
+    /**
+     * Destroy tree
+     */
+    ~BTree();
+
+    /**
+     * Remove all elements from the tree
+     */
+    void clear();
+
+    /**
+     * Get number of elements stored in the tree
+     *
+     * @return number of elements stored in the tree
+     */
+    size_t size() const;
+
+    /**
+     * Insert key-value pair into the tree
+     * If the key already exists, its corresponding value gets replaced
+     *
+     * @param key key mapping to the value
+     * @param value mapped value
+     */
+    void insert(KeyType const &key, ValueType const &value);
+
+    /**
+     * Remove key and its value from the tree, does nothing if the key is not present
+     *
+     * @param key key to remove
+     */
+    void remove(KeyType const &key);
+
+    /**
+     * Find value related to the given key
+     *
+     * @param key key mapped to searched value
+     * @return pointer to the value or nullptr if not found
+     */
+    ValueType *find(KeyType const &key);
+
+    /**
+     * String representation of the tree in pre-order traversal
+     *
+     * @return pre-order traversal string
+     */
+    std::string toString() const;
+
+    /**
+     * Display tree (pre-order traversal, one node per line) to a stream
+     *
+     * @tparam StreamType type of output stream
+     * @param stream output stream
+     */
+    template<typename StreamType>
+    void print(StreamType &stream) const;
+
+    /**
+     * Name of the in-node search kernel used for this key type and comparator
+     *
+     * @return "AVX2", "SSE4.2" or "scalar"
+     */
+    static char const *searchKernel();
+};
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::Node::Node(bool leaf)
+        : keys(), values() {
+    this->count = 0;
+    this->leaf = leaf;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::InternalNode::InternalNode()
+        : Node(false), children() {
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string BTree<KeyType, ValueType, Compare, NodeAllocator>::Node::toString(std::string const &separator) const {
+    std::ostringstream stringStream;
+    for (unsigned idx = 0; idx < count; ++idx) {
+        stringStream << "[" << keys[idx] << "," << separator << values[idx] << "]";
+    }
+    return stringStream.str();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::BTree() {
+    root = nullptr;
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::BTree(Compare const &compare)
+        : compare(compare) {
+    root = nullptr;
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::BTree(BTree &&other) noexcept
+        : leafAllocator(std::move(other.leafAllocator)), internalAllocator(std::move(other.internalAllocator)),
+          compare(std::move(other.compare)) {
+    root = other.root;
+    elementCount = other.elementCount;
+    other.root = nullptr;
+    other.elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator> &
+BTree<KeyType, ValueType, Compare, NodeAllocator>::operator=(BTree &&other) noexcept {
+    if (this != &other) {
+        clear();
+        leafAllocator = std::move(other.leafAllocator);
+        internalAllocator = std::move(other.internalAllocator);
+        compare = std::move(other.compare);
+        root = other.root;
+        elementCount = other.elementCount;
+        other.root = nullptr;
+        other.elementCount = 0;
+    }
+    return *this;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BTree<KeyType, ValueType, Compare, NodeAllocator>::~BTree() {
+    clear();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::clear() {
+    if (!NodeAllocator<Node>::RELEASES_IN_BULK || !std::is_trivially_destructible<InternalNode>::value) {
+        destroySubtree(root);
+    }
+    leafAllocator.releaseAll();
+    internalAllocator.releaseAll();
+    root = nullptr;
+    elementCount = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BTree<KeyType, ValueType, Compare, NodeAllocator>::size() const {
+    return elementCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+char const *BTree<KeyType, ValueType, Compare, NodeAllocator>::searchKernel() {
+    return NodeSearch<KeyType, Compare>::KERNEL;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BTree<KeyType, ValueType, Compare, NodeAllocator>::lowerBound(Node const *node, KeyType const &key) const {
+    return NodeSearch<KeyType, Compare>::template lowerBound<KEY_CAPACITY>(node->keys, node->count, key, compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BTree<KeyType, ValueType, Compare, NodeAllocator>::Node *&
+BTree<KeyType, ValueType, Compare, NodeAllocator>::child(Node *node, size_t idx) {
+    return static_cast<InternalNode *>(node)->children[idx];
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::destroyNode(Node *node) {
+    if (node->leaf) {
+        leafAllocator.destroy(node);
+    } else {
+        internalAllocator.destroy(static_cast<InternalNode *>(node));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot) {
+    if (subRoot == nullptr) {
+        return;
+    }
+    if (!subRoot->leaf) {
+        for (unsigned idx = 0; idx <= subRoot->count; ++idx) {
+            destroySubtree(child(subRoot, idx));
+        }
+    }
+    destroyNode(subRoot);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType *BTree<KeyType, ValueType, Compare, NodeAllocator>::find(KeyType const &key) {
+    Node *node = root;
+    while (node != nullptr) {
+        auto idx = lowerBound(node, key);
+        if (idx < node->count && compare(key, node->keys[idx]) == 0) {
+            return &(node->values[idx]);
+        }
+        node = node->leaf ? nullptr : child(node, idx);
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::shiftRight(Node *node, size_t idx) {
+    for (auto slot = (size_t) node->count; slot > idx; --slot) {
+        node->keys[slot] = std::move(node->keys[slot - 1]);
+        node->values[slot] = std::move(node->values[slot - 1]);
+    }
+    if (!node->leaf) {
+        for (auto slot = (size_t) node->count + 1; slot > idx + 1; --slot) {
+            child(node, slot) = child(node, slot - 1);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::splitChild(Node *parent, size_t idx) {
+    auto full = child(parent, idx);
+    Node *sibling = full->leaf ? leafAllocator.create(true) : internalAllocator.create();
+
+    // Upper MIN_DEGREE - 1 keys and MIN_DEGREE children move to the new right sibling
+    for (size_t slot = 0; slot < MIN_DEGREE - 1; ++slot) {
+        sibling->keys[slot] = std::move(full->keys[slot + MIN_DEGREE]);
+        sibling->values[slot] = std::move(full->values[slot + MIN_DEGREE]);
+    }
+    if (!full->leaf) {
+        for (size_t slot = 0; slot < MIN_DEGREE; ++slot) {
+            child(sibling, slot) = child(full, slot + MIN_DEGREE);
+        }
+    }
+    sibling->count = MIN_DEGREE - 1;
+    full->count = MIN_DEGREE - 1;
+
+    // Median moves up between the halves
+    shiftRight(parent, idx);
+    parent->keys[idx] = std::move(full->keys[MIN_DEGREE - 1]);
+    parent->values[idx] = std::move(full->values[MIN_DEGREE - 1]);
+    child(parent, idx + 1) = sibling;
+    ++parent->count;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::insert(KeyType const &key, ValueType const &value) {
+    if (root == nullptr) {
+        root = leafAllocator.create(true);
+    }
+    if (root->count == MAX_KEYS) {
+        // Only way for the tree to grow in height
+        auto newRoot = internalAllocator.create();
+        newRoot->children[0] = root;
+        root = newRoot;
+        splitChild(root, 0);
+    }
+
+    Node *node = root;
+    while (true) {
+        auto idx = lowerBound(node, key);
+        if (idx < node->count && compare(key, node->keys[idx]) == 0) {
+            node->values[idx] = value;
+            return;
+        }
+
+        if (node->leaf) {
+            shiftRight(node, idx);
+            node->keys[idx] = key;
+            node->values[idx] = value;
+            ++node->count;
+            ++elementCount;
+            return;
+        }
+
+        if (child(node, idx)->count == MAX_KEYS) {
+            splitChild(node, idx);
+            auto order = compare(key, node->keys[idx]);
+            if (order == 0) {
+                node->values[idx] = value;
+                return;
+            }
+            if (order > 0) {
+                ++idx;
+            }
+        }
+        node = child(node, idx);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::mergeChildren(Node *parent, size_t idx) {
+    auto left = child(parent, idx);
+    auto right = child(parent, idx + 1);
+
+    left->keys[MIN_DEGREE - 1] = std::move(parent->keys[idx]);
+    left->values[MIN_DEGREE - 1] = std::move(parent->values[idx]);
+    for (size_t slot = 0; slot < right->count; ++slot) {
+        left->keys[slot + MIN_DEGREE] = std::move(right->keys[slot]);
+        left->values[slot + MIN_DEGREE] = std::move(right->values[slot]);
+    }
+    if (!left->leaf) {
+        for (size_t slot = 0; slot <= right->count; ++slot) {
+            child(left, slot + MIN_DEGREE) = child(right, slot);
+        }
+    }
+    left->count = MAX_KEYS;
+
+    // Close the gap after the separating key and the right child in the parent
+    for (auto slot = idx; slot + 1 < parent->count; ++slot) {
+        parent->keys[slot] = std::move(parent->keys[slot + 1]);
+        parent->values[slot] = std::move(parent->values[slot + 1]);
+        child(parent, slot + 1) = child(parent, slot + 2);
+    }
+    --parent->count;
+    destroyNode(right);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BTree<KeyType, ValueType, Compare, NodeAllocator>::refillChild(Node *parent, size_t idx) {
+    auto target = child(parent, idx);
+    if (target->count >= MIN_DEGREE) {
+        return idx;
+    }
+
+    if (idx > 0 && child(parent, idx - 1)->count >= MIN_DEGREE) {
+        // Rotate right: separator moves down to the front of the target, sibling's last key moves up
+        auto sibling = child(parent, idx - 1);
+        shiftRight(target, 0);
+        if (!target->leaf) {
+            child(target, 1) = child(target, 0);
+            child(target, 0) = child(sibling, sibling->count);
+        }
+        target->keys[0] = std::move(parent->keys[idx - 1]);
+        target->values[0] = std::move(parent->values[idx - 1]);
+        ++target->count;
+        parent->keys[idx - 1] = std::move(sibling->keys[sibling->count - 1]);
+        parent->values[idx - 1] = std::move(sibling->values[sibling->count - 1]);
+        --sibling->count;
+        return idx;
+    }
+
+    if (idx < parent->count && child(parent, idx + 1)->count >= MIN_DEGREE) {
+        // Rotate left: separator moves down to the end of the target, sibling's first key moves up
+        auto sibling = child(parent, idx + 1);
+        target->keys[target->count] = std::move(parent->keys[idx]);
+        target->values[target->count] = std::move(parent->values[idx]);
+        if (!target->leaf) {
+            child(target, target->count + 1) = child(sibling, 0);
+        }
+        ++target->count;
+        parent->keys[idx] = std::move(sibling->keys[0]);
+        parent->values[idx] = std::move(sibling->values[0]);
+
+        for (size_t slot = 0; slot + 1 < sibling->count; ++slot) {
+            sibling->keys[slot] = std::move(sibling->keys[slot + 1]);
+            sibling->values[slot] = std::move(sibling->values[slot + 1]);
+        }
+        if (!sibling->leaf) {
+            for (size_t slot = 0; slot < sibling->count; ++slot) {
+                child(sibling, slot) = child(sibling, slot + 1);
+            }
+        }
+        --sibling->count;
+        return idx;
+    }
+
+    // Both siblings are minimal too
+    if (idx < parent->count) {
+        mergeChildren(parent, idx);
+        return idx;
+    }
+    mergeChildren(parent, idx - 1);
+    return idx - 1;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool BTree<KeyType, ValueType, Compare, NodeAllocator>::removeFromSubtree(Node *subRoot, KeyType const &key) {
+    Node *node = subRoot;
+    while (true) {
+        auto idx = lowerBound(node, key);
+        bool found = idx < node->count && compare(key, node->keys[idx]) == 0;
+
+        if (node->leaf) {
+            if (!found) {
+                return false;
+            }
+            for (auto slot = idx; slot + 1 < node->count; ++slot) {
+                node->keys[slot] = std::move(node->keys[slot + 1]);
+                node->values[slot] = std::move(node->values[slot + 1]);
+            }
+            --node->count;
+            return true;
+        }
+
+        if (found) {
+            auto left = child(node, idx);
+            auto right = child(node, idx + 1);
+            if (left->count >= MIN_DEGREE || right->count >= MIN_DEGREE) {
+                // Replace with the in-order predecessor (or successor) and remove that from the child instead
+                bool fromLeft = left->count >= MIN_DEGREE;
+                Node *source = fromLeft ? left : right;
+                while (!source->leaf) {
+                    source = child(source, fromLeft ? source->count : 0);
+                }
+                auto sourceIdx = fromLeft ? source->count - 1 : 0;
+                KeyType replacement = source->keys[sourceIdx];
+                node->values[idx] = std::move(source->values[sourceIdx]);
+                node->keys[idx] = replacement;
+                return removeFromSubtree(fromLeft ? left : right, replacement);
+            }
+
+            mergeChildren(node, idx);
+            node = left;
+            continue;
+        }
+
+        node = child(node, refillChild(node, idx));
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::remove(KeyType const &key) {
+    if (root == nullptr) {
+        return;
+    }
+
+    if (removeFromSubtree(root, key)) {
+        --elementCount;
+    }
+
+    // Root emptied by a merge of its only two children, the only way for the tree to shrink in height
+    if (root->count == 0) {
+        auto oldRoot = root;
+        root = root->leaf ? nullptr : child(root, 0);
+        destroyNode(oldRoot);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::writeSubtree(StreamType &stream, Node const *subRoot) {
+    if (subRoot == nullptr) {
+        return;
+    }
+
+    stream << "(";
+    for (unsigned idx = 0; idx < subRoot->count; ++idx) {
+        stream << "[" << subRoot->keys[idx] << "," << subRoot->values[idx] << "]";
+    }
+    if (!subRoot->leaf) {
+        auto internal = static_cast<InternalNode const *>(subRoot);
+        for (unsigned idx = 0; idx <= subRoot->count; ++idx) {
+            stream << ",";
+            writeSubtree(stream, internal->children[idx]);
+        }
+    }
+    stream << ")";
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string BTree<KeyType, ValueType, Compare, NodeAllocator>::toString() const {
+    std::ostringstream stringStream;
+    writeSubtree(stringStream, root);
+    return stringStream.str();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::printSubtree(StreamType &stream, Node const *subRoot, int indent) {
+    if (subRoot == nullptr) {
+        return;
+    }
+
+    stream << std::string(indent, ' ') << subRoot->toString(" ") << '\n';
+    if (!subRoot->leaf) {
+        auto internal = static_cast<InternalNode const *>(subRoot);
+        for (unsigned idx = 0; idx <= subRoot->count; ++idx) {
+            printSubtree(stream, internal->children[idx], indent + PRINT_NEST_INDENT);
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BTree<KeyType, ValueType, Compare, NodeAllocator>::print(StreamType &stream) const {
+    printSubtree(stream, root, 0);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::ostream &operator<<(std::ostream &stream, BTree<KeyType, ValueType, Compare, NodeAllocator> const &tree) {
+    tree.print(stream);
+    return stream;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include "../CommonLib/Compare.h"
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Lower bound search inside a sorted key array of a B-tree node, generic version
+ *
+ * Binary search calling the three-way comparator, used for keys without a vectorized kernel
+ * and for user-supplied comparators
+ *
+ * @tparam KeyType type of the keys
+ * @tparam Compare three-way comparator of the keys
+ */
+template<typename KeyType, typename Compare, typename Enable = void>
+struct NodeSearch {
+    /**
+     * Name of the search kernel compiled in, for benchmark reports
+     */
+    static constexpr char const *KERNEL = "scalar";
+
+    /**
+     * Find position of the first key not less than given key
+     *
+     * @tparam Capacity size of the key array
+     * @param keys sorted keys
+     * @param count number of valid keys
+     * @param key searched key
+     * @param compare comparator the keys are sorted by
+     * @return number of keys less than key
+     */
+    template<size_t Capacity>
+    static size_t lowerBound(KeyType const *keys, size_t count, KeyType const &key, Compare const &compare) {
+        size_t low = 0;
+        size_t high = count;
+        while (low < high) {
+            auto middle = low + (high - low) / 2;
+            if (compare(keys[middle], key) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+};
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+
+/**
+ * Vectorized lower bound for 32 and 64 bit integer keys in their natural order
+ *
+ * All capacity slots are compared, lanes past count are masked out of the result afterwards,
+ * so the loop has no data-dependent branches. Sorted keys make the lanes less than the searched key
+ * a prefix, their count is the position. Unsigned keys get their sign bit flipped to use signed comparisons.
+ *
+ * @tparam KeyType 32 or 64 bit integer type
+ */
+template<typename KeyType>
+struct NodeSearch<KeyType, ThreeWayCompare<KeyType, std::less<KeyType>>,
+        typename std::enable_if<std::is_integral<KeyType>::value &&
+                                (sizeof(KeyType) == 4 || sizeof(KeyType) == 8)>::type> {
+#if defined(__AVX2__)
+    static constexpr char const *KERNEL = "AVX2";
+#else
+    static constexpr char const *KERNEL = "SSE4.2";
+#endif
+
+    /**
+     * Number of keys in a node's key array has to be a multiple of this
+     */
+    static const size_t LANES_MULTIPLE = 64 / sizeof(KeyType);
+
+    /**
+     * Find position of the first key not less than given key
+     *
+     * @tparam Capacity size of the key array, multiple of LANES_MULTIPLE
+     * @param keys sorted keys, all Capacity slots have to be initialized
+     * @param count number of valid keys
+     * @param key searched key
+     * @return number of keys less than key
+     */
+    template<size_t Capacity>
+    static size_t lowerBound(KeyType const *keys, size_t count, KeyType const &key,
+                             ThreeWayCompare<KeyType, std::less<KeyType>> const &) {
+        static_assert(Capacity % LANES_MULTIPLE == 0, "key array has to span whole cache lines");
+        static_assert(Capacity <= 64, "less-than mask has 64 bits");
+
+        std::uint64_t lessMask = 0;
+        if (sizeof(KeyType) == 8) {
+            auto bias = std::is_signed<KeyType>::value ? 0 : (long long) (1ULL << 63);
+#if defined(__AVX2__)
+            auto needle = _mm256_set1_epi64x((long long) key ^ bias);
+            auto flip = _mm256_set1_epi64x(bias);
+            for (size_t idx = 0; idx < Capacity; idx += 4) {
+                auto lanes = _mm256_xor_si256(_mm256_loadu_si256((__m256i const *) (keys + idx)), flip);
+                auto less = _mm256_cmpgt_epi64(needle, lanes);
+                lessMask |= (std::uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(less)) << idx;
+            }
+#else
+            auto needle = _mm_set1_epi64x((long long) key ^ bias);
+            auto flip = _mm_set1_epi64x(bias);
+            for (size_t idx = 0; idx < Capacity; idx += 2) {
+                auto lanes = _mm_xor_si128(_mm_loadu_si128((__m128i const *) (keys + idx)), flip);
+                auto less = _mm_cmpgt_epi64(needle, lanes);
+                lessMask |= (std::uint64_t) _mm_movemask_pd(_mm_castsi128_pd(less)) << idx;
+            }
+#endif
+        } else {
+            auto bias = std::is_signed<KeyType>::value ? 0 : (int) (1U << 31);
+#if defined(__AVX2__)
+            auto needle = _mm256_set1_epi32((int) key ^ bias);
+            auto flip = _mm256_set1_epi32(bias);
+            for (size_t idx = 0; idx < Capacity; idx += 8) {
+                auto lanes = _mm256_xor_si256(_mm256_loadu_si256((__m256i const *) (keys + idx)), flip);
+                auto less = _mm256_cmpgt_epi32(needle, lanes);
+                lessMask |= (std::uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(less)) << idx;
+            }
+#else
+            auto needle = _mm_set1_epi32((int) key ^ bias);
+            auto flip = _mm_set1_epi32(bias);
+            for (size_t idx = 0; idx < Capacity; idx += 4) {
+                auto lanes = _mm_xor_si128(_mm_loadu_si128((__m128i const *) (keys + idx)), flip);
+                auto less = _mm_cmpgt_epi32(needle, lanes);
+                lessMask |= (std::uint64_t) _mm_movemask_ps(_mm_castsi128_ps(less)) << idx;
+            }
+#endif
+        }
+
+        if (count < 64) {
+            lessMask &= (1ULL << count) - 1;
+        }
+        return (size_t) _mm_popcnt_u64(lessMask);
+    }
+};
+
+#endif
@@ -2,9 +2,106 @@
 #include <random>
 #include <algorithm>
 #include <map>
+#include <string>
+#include <thread>
 #include "../benchmark/benchmark.h"
+#include "../benchmark/allocations.h"
 #include "../BinarySearchTreeLib/BinarySearchTree.h"
 
+/**
+ * Measure insertion and teardown time of a tree with given node allocator
+ *
+ * @tparam TreeType tree instantiated with the examined allocator
+ * @param numbers keys to insert
+ * @param sampleSize number of keys to insert
+ * @param insertNanos output, time of inserting sampleSize keys
+ * @param teardownNanos output, time of destroying all nodes
+ */
+template<typename TreeType>
+void measureAllocator(std::vector<unsigned long> const &numbers, size_t sampleSize,
+                      size_t &insertNanos, size_t &teardownNanos) {
+    TreeType tree;
+    Benchmark<std::chrono::nanoseconds> insertTimer;
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        tree.insert(numbers[idx], numbers[idx]);
+    }
+    insertNanos = insertTimer.elapsed();
+
+    Benchmark<std::chrono::nanoseconds> teardownTimer;
+    tree.clear();
+    teardownNanos = teardownTimer.elapsed();
+}
+
+/**
+ * Size of heavyweight string values in bytes, large enough to defeat small string optimization
+ */
+const size_t HEAVY_VALUE_BYTES = 256;
+
+/**
+ * Measure heap allocations of inserting heavyweight string values
+ *
+ * @tparam InsertFunction callable (tree, key, value) performing one insertion
+ * @param numbers keys to insert
+ * @param sampleSize number of keys to insert
+ * @param insertFunction insertion variant under test, may consume the prepared value
+ * @param nanos output, time of inserting sampleSize keys
+ * @return average number of heap allocations per insert
+ */
+template<typename InsertFunction>
+double measureHeavyInsert(std::vector<unsigned long> const &numbers, size_t sampleSize,
+                          InsertFunction insertFunction, size_t &nanos) {
+    std::vector<std::string> values(sampleSize, std::string(HEAVY_VALUE_BYTES, 'x'));
+    BinarySearchTree<unsigned long, std::string> tree;
+
+    auto allocationsBefore = allocationCount();
+    Benchmark<std::chrono::nanoseconds> timer;
+    for (size_t idx = 0; idx < sampleSize; idx++) {
+        insertFunction(tree, numbers[idx], values[idx]);
+    }
+    nanos = timer.elapsed();
+    return (double) (allocationCount() - allocationsBefore) / sampleSize;
+}
+
+/**
+ * Number of operations per second
+ */
+double throughput(size_t operations, size_t nanos) {
+    return nanos == 0 ? 0.0 : operations * 1e9 / nanos;
+}
+
+/**
+ * Number of pairs loaded by the parallel bulk load benchmark
+ */
+const size_t PARALLEL_LOAD_SIZE = 4000000;
+
+/**
+ * Measure bulk loading of random pairs with increasing numbers of threads, 1 up to the hardware concurrency
+ *
+ * @param generator source of the pairs
+ * @param loadNanos output, time of bulkLoad by number of threads
+ */
+void measureParallelLoad(std::mt19937 &generator, std::map<size_t, size_t> &loadNanos) {
+    std::vector<std::pair<unsigned long, unsigned long>> pairs;
+    for (size_t idx = 0; idx < PARALLEL_LOAD_SIZE; idx++) {
+        auto number = (unsigned long) generator() << 32 | generator();
+        pairs.emplace_back(number, number);
+    }
+
+    size_t maxThreads = std::thread::hardware_concurrency();
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads > 0 ? maxThreads : 1);
+
+    for (auto threads : threadCounts) {
+        BinarySearchTree<unsigned long, unsigned long> tree;
+        Benchmark<std::chrono::nanoseconds> timer;
+        tree.bulkLoad(pairs.begin(), pairs.end(), true, threads);
+        loadNanos[threads] = timer.elapsed();
+    }
+}
+
 int main() {
     std::vector<int> sampleSizes = {10000, 20000, 30000, 40000, 50000, 60000, 70000, 80000, 90000, 100000};
 
@@ -23,7 +120,7 @@ int main() {
     for (auto sampleSize : sampleSizes) {
         Benchmark<std::chrono::nanoseconds> timer;
 
-        auto tree = BinarySearchTree<unsigned long, unsigned long>();
+        BinarySearchTree<unsigned long, unsigned long> tree;
         for (size_t idx = 0; idx < sampleSize; idx++) {
             auto number = randomNumbers[idx];
             tree.insert(number, number);
@@ -33,7 +130,7 @@ int main() {
     }
 
     // Tree search benchmark
-    auto tree = BinarySearchTree<unsigned long, unsigned long>();
+    BinarySearchTree<unsigned long, unsigned long> tree;
     for (auto number : randomNumbers) {
         tree.insert(number, number);
     }
@@ -53,7 +150,7 @@ int main() {
     auto rng = std::default_random_engine {};
     for (auto sampleSize: sampleSizes)
     {
-        auto tree_2 = BinarySearchTree<unsigned long, unsigned long>();
+        BinarySearchTree<unsigned long, unsigned long> tree_2;
         for (auto number: randomNumbers) {
             tree_2.insert(number, number);
         }
@@ -76,6 +173,61 @@ int main() {
     }
 
 
+    // Bulk construction benchmark, compared with the insertion loop from the creation benchmark
+    std::map<int, size_t> bulkLoadTimeNanos;
+    std::map<int, size_t> buildFromSortedTimeNanos;
+    for (auto sampleSize : sampleSizes) {
+        std::vector<std::pair<unsigned long, unsigned long>> pairs;
+        for (int idx = 0; idx < sampleSize; idx++) {
+            pairs.emplace_back(randomNumbers[idx], randomNumbers[idx]);
+        }
+
+        BinarySearchTree<unsigned long, unsigned long> unsortedTree;
+        Benchmark<std::chrono::nanoseconds> bulkLoadTimer;
+        unsortedTree.bulkLoad(pairs.begin(), pairs.end());
+        bulkLoadTimeNanos[sampleSize] = bulkLoadTimer.elapsed();
+
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+        BinarySearchTree<unsigned long, unsigned long> sortedTree;
+        Benchmark<std::chrono::nanoseconds> buildTimer;
+        sortedTree.buildFromSorted(pairs.begin(), pairs.end());
+        buildFromSortedTimeNanos[sampleSize] = buildTimer.elapsed();
+    }
+
+    // Parallel bulk load benchmark, startup time by number of threads
+    std::map<size_t, size_t> parallelLoadNanos;
+    measureParallelLoad(generator, parallelLoadNanos);
+
+    // Heavyweight value benchmark, heap allocations per insert when copying, moving and constructing in place
+    std::map<int, double> copyAllocations, moveAllocations, emplaceAllocations;
+    std::map<int, size_t> copyTimeNanos, moveTimeNanos, emplaceTimeNanos;
+    typedef BinarySearchTree<unsigned long, std::string> HeavyTree;
+    for (auto sampleSize : sampleSizes) {
+        copyAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &value) {
+                    tree.insert(key, value);
+                }, copyTimeNanos[sampleSize]);
+        moveAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &value) {
+                    tree.insert(std::move(key), std::move(value));
+                }, moveTimeNanos[sampleSize]);
+        emplaceAllocations[sampleSize] = measureHeavyInsert(
+                randomNumbers, sampleSize, [](HeavyTree &tree, unsigned long key, std::string &) {
+                    tree.tryEmplace(key, HEAVY_VALUE_BYTES, 'x');
+                }, emplaceTimeNanos[sampleSize]);
+    }
+
+    // Node allocator benchmark, slab pool versus one heap allocation per node
+    std::map<int, size_t> poolInsertNanos, heapInsertNanos, poolTeardownNanos, heapTeardownNanos;
+    for (auto sampleSize : sampleSizes) {
+        measureAllocator<BinarySearchTree<unsigned long, unsigned long, ThreeWayCompare<unsigned long>, NodePool>>(
+                randomNumbers, sampleSize, poolInsertNanos[sampleSize], poolTeardownNanos[sampleSize]);
+        measureAllocator<BinarySearchTree<unsigned long, unsigned long, ThreeWayCompare<unsigned long>, HeapAllocator>>(
+                randomNumbers, sampleSize, heapInsertNanos[sampleSize], heapTeardownNanos[sampleSize]);
+    }
+
     std::cout << "Creation time benchmark\nSize\ttime (ns)\n";
     std::map<int, size_t>::iterator it;
     for (it = creationTimeNanos.begin(); it != creationTimeNanos.end(); it++) {
@@ -98,5 +250,40 @@ int main() {
 
     }
 
+
+    std::cout << "\nBulk construction benchmark\nSize\tinsert loop (ns)\tbulkLoad (ns)\tbuildFromSorted (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << creationTimeNanos[sampleSize] << "\t"
+                  << bulkLoadTimeNanos[sampleSize] << "\t"
+                  << buildFromSortedTimeNanos[sampleSize] << std::endl;
+    }
+
+    std::cout << "\nParallel bulk load benchmark (" << PARALLEL_LOAD_SIZE << " pairs)\nThreads\tbulkLoad (ns)\n";
+    for (auto const &load : parallelLoadNanos) {
+        std::cout << load.first << "\t" << load.second << std::endl;
+    }
+
+    std::cout << "\nHeavyweight value benchmark (" << HEAVY_VALUE_BYTES << " byte strings)\n"
+              << "Size\tcopy (allocs/insert)\tmove (allocs/insert)\ttryEmplace (allocs/insert)"
+              << "\tcopy (ns)\tmove (ns)\ttryEmplace (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << copyAllocations[sampleSize] << "\t"
+                  << moveAllocations[sampleSize] << "\t"
+                  << emplaceAllocations[sampleSize] << "\t"
+                  << copyTimeNanos[sampleSize] << "\t"
+                  << moveTimeNanos[sampleSize] << "\t"
+                  << emplaceTimeNanos[sampleSize] << std::endl;
+    }
+
+    std::cout << "\nAllocator benchmark\nSize\tpool (inserts/s)\theap (inserts/s)\tpool teardown (ns)\theap teardown (ns)\n";
+    for (auto sampleSize : sampleSizes) {
+        std::cout << sampleSize << "\t"
+                  << throughput(sampleSize, poolInsertNanos[sampleSize]) << "\t"
+                  << throughput(sampleSize, heapInsertNanos[sampleSize]) << "\t"
+                  << poolTeardownNanos[sampleSize] << "\t"
+                  << heapTeardownNanos[sampleSize] << std::endl;
+    }
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <random>
 #include <chrono>
 #include <thread>
+#include <vector>
 #include "../BinarySearchTreeLib/BinarySearchTree.h"
 
 class Key {
@@ -57,6 +58,18 @@ public:
         ++cmpCount;
         return value >= v.value;
     }
+
+    int compare(Key const &v) const {
+        ++cmpCount;
+        return (value < v.value) ? -1 : (value > v.value) ? 1 : 0;
+    }
+};
+
+// three-way comparator of keys, a single counted comparison per visited node
+struct KeyCompare {
+    int operator()(Key const &lhs, Key const &rhs) const {
+        return lhs.compare(rhs);
+    }
 };
 
 unsigned long long Key::cmpCount = 0ULL;
@@ -82,24 +95,31 @@ int main() {
         std::cin >> size;
         if (size > 0) {
             BinarySearchTree<Key, unsigned long> tree;
+            BinarySearchTree<Key, unsigned long, KeyCompare> threeWayTree;
             while (tree.size() < size) {
                 unsigned long n = generator();
 
                 Key key(n);
 
                 tree.insert(key, n);
+                threeWayTree.insert(key, n);
             }
             if (tree.size() <= 100)
                 std::cout << tree;
 
+            std::vector<Key> searched;
+            for (unsigned int i = 0; i < 10; ++i)
+                searched.emplace_back(generator());
+
             Key::resetCounter();
-            unsigned int i;
-            for (i = 0; i < 10; ++i) {
-                unsigned long n = generator();
-                Key key(n);
-                tree.find(Key(key));
-            }
-            std::cout << "Cmp count: " << Key::getCmpCount() / i << "\n";
+            for (auto const &key : searched)
+                tree.find(key);
+            std::cout << "Cmp count: " << Key::getCmpCount() / searched.size() << "\n";
+
+            Key::resetCounter();
+            for (auto const &key : searched)
+                threeWayTree.find(key);
+            std::cout << "Cmp count (three-way): " << Key::getCmpCount() / searched.size() << "\n";
         }
     } while (size > 0);
     return 0;
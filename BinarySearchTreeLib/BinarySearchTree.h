@@ -1,267 +1,1068 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <ostream>
 #include <iomanip>
-
-
-template<typename KeyType, typename ValueType>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../CommonLib/Compare.h"
+#include "../CommonLib/FrozenTree.h"
+#include "../CommonLib/MappedTree.h"
+#include "../CommonLib/NodePool.h"
+#include "../CommonLib/NodeValue.h"
+#include "../CommonLib/Parallel.h"
+#include "../CommonLib/Prefetch.h"
+#include "../CommonLib/TreeIterator.h"
+
+
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
 class BinarySearchTree {
 private:
-    struct Node {
+    struct Node : NodeValue<ValueType> {
         Node *leftChild;
         Node *rightChild;
-        ValueType value;
+        Node *parent;
         KeyType key;
+        size_t subtreeSize;
 
 
-        Node(KeyType key, ValueType value);
-
-        ~Node();
+        template<typename K, typename... Args>
+        Node(K &&key, Args &&... valueArgs);
 
         std::string toString(const std::string &separator = "") const;
 
+        template<typename StreamType>
+        void write(StreamType &stream, const char *separator) const;
+
+        static size_t nodeSubtreeSize(Node const *node);
+
     };
 
 private:
     Node *root;
 
+    NodeAllocator<Node> nodeAllocator;
+
+    Compare compare;
+
     static const auto PRINT_NEST_INDENT = 4;
 
-    Node **findClosest(KeyType const &key, Node **starting_point);
+    static const size_t BATCH_WIDTH = 16;
 
-    static std::string subTreeToString(Node *subRoot);
+    static const size_t PARALLEL_BUILD_GRAIN = 16384;
+
+    Node **findClosest(KeyType const &key, Node **starting_point, int &order) const;
+
+    Node **findInsertionPoint(KeyType const &key, Node *&parent);
+
+    void attachNode(Node **link, Node *parent, Node *node);
+
+    template<typename K, typename V>
+    void insertOrAssign(K &&key, V &&value);
+
+    template<typename K, typename... Args>
+    std::pair<ValueType *, bool> emplaceIfAbsent(K &&key, Args &&... valueArgs);
+
+    template<typename StreamType>
+    static void writeSubtree(StreamType &stream, Node *subRoot, size_t maxDepth);
 
     template<typename StreamType>
-    static void printSubtree(StreamType &stream, Node *subRoot, int indent, std::string const &prefix);
+    void printSubtree(StreamType &stream, Node *subRoot, size_t maxDepth, KeyType const *lo, KeyType const *hi) const;
 
-    static std::string indentWhitespace(int width);
+    size_t countNotGreater(KeyType const &key) const;
 
-    size_t sizeOfSubtree(Node *subRoot) const;
+    Node *boundNode(KeyType const &key, bool includeKey) const;
+
+    Node *floorNode(KeyType const &key) const;
+
+    void destroySubtree(Node *subRoot);
+
+    static void destroySubtree(Node *subRoot, NodeAllocator<Node> &allocator);
+
+    template<typename ForwardIterator>
+    Node *buildSubtree(ForwardIterator &current, size_t count, NodeAllocator<Node> &allocator);
+
+    // subtree of a concurrent build left for one thread
+    template<typename ForwardIterator>
+    struct BuildTask {
+        ForwardIterator first;
+        size_t count;
+        Node *parent;
+        Node **link;
+    };
+
+    template<typename ForwardIterator>
+    void splitBuild(ForwardIterator first, size_t count, Node *parent, Node **link, size_t threadCount,
+                    std::vector<BuildTask<ForwardIterator>> &tasks);
+
+    Node *cloneSubtree(Node const *source);
 
 public:
 
+    using Iterator = TreeIterator<Node, KeyType, ValueType, false>;
+
+    using ConstIterator = TreeIterator<Node, KeyType, ValueType, true>;
+
+    using Cursor = TreeCursor<Node, KeyType, ValueType, Compare>;
+
     BinarySearchTree();
 
+    explicit BinarySearchTree(Compare const &compare);
+
+    BinarySearchTree(BinarySearchTree const &other);
+
+    BinarySearchTree(BinarySearchTree &&other) noexcept;
+
+    BinarySearchTree &operator=(BinarySearchTree const &other);
+
+    BinarySearchTree &operator=(BinarySearchTree &&other) noexcept;
+
     ~BinarySearchTree();
 
+    void clear();
+
+    template<typename ForwardIterator>
+    void buildFromSorted(ForwardIterator first, ForwardIterator last, size_t threadCount = 1);
+
+    template<typename InputIterator>
+    void bulkLoad(InputIterator first, InputIterator last, bool deduplicate = true, size_t threadCount = 1);
+
     size_t size() const;
 
+    static size_t nodeBytes();
+
+    size_t rank(KeyType const &key) const;
+
+    KeyType const *select(size_t k) const;
+
+    size_t countInRange(KeyType const &lo, KeyType const &hi) const;
+
     void insert(KeyType const &key, ValueType const &value);
 
+    void insert(KeyType &&key, ValueType &&value);
+
+    template<typename K, typename... Args>
+    std::pair<ValueType *, bool> emplace(K &&key, Args &&... valueArgs);
+
+    template<typename... Args>
+    std::pair<ValueType *, bool> tryEmplace(KeyType const &key, Args &&... valueArgs);
+
+    template<typename... Args>
+    std::pair<ValueType *, bool> tryEmplace(KeyType &&key, Args &&... valueArgs);
+
     ValueType *find(KeyType const &key);
 
+    bool contains(KeyType const &key) const;
+
+    void findBatch(std::vector<KeyType> const &keys, std::vector<ValueType *> &outValues);
+
+    Iterator begin();
+
+    Iterator end();
+
+    ConstIterator begin() const;
+
+    ConstIterator end() const;
+
+    Iterator lowerBound(KeyType const &key);
+
+    ConstIterator lowerBound(KeyType const &key) const;
+
+    Iterator upperBound(KeyType const &key);
+
+    ConstIterator upperBound(KeyType const &key) const;
+
+    Iterator floor(KeyType const &key);
+
+    ConstIterator floor(KeyType const &key) const;
+
+    Iterator ceiling(KeyType const &key);
+
+    ConstIterator ceiling(KeyType const &key) const;
+
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor);
+
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const;
+
+    FrozenTree<KeyType, ValueType, Compare> freeze() const;
+
+    void save(std::string const &path) const;
+
+    static MappedTree<KeyType, ValueType, Compare> openMapped(std::string const &path, bool verifyChecksum = true,
+                                                              Compare const &compare = Compare());
+
+    Cursor cursor();
+
     std::string toString() const;
 
     template<typename StreamType>
-    void print(StreamType &stream) const;
+    void writeString(StreamType &stream, size_t maxDepth = std::numeric_limits<size_t>::max()) const;
+
+    template<typename StreamType>
+    void print(StreamType &stream, size_t maxDepth = std::numeric_limits<size_t>::max()) const;
+
+    template<typename StreamType>
+    void printRange(StreamType &stream, KeyType const &lo, KeyType const &hi) const;
 
     KeyType findClosestTester(KeyType &key);
 
     void remove(KeyType const &key);
 };
 
-template<typename KeyType, typename ValueType>
-void BinarySearchTree<KeyType, ValueType>::remove(const KeyType &key) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::remove(const KeyType &key) {
     if (root == nullptr)
         return;
 
     Node **rootptr = &root;
-    Node **closest = findClosest(key, rootptr);
+    int order;
+    Node **closest = findClosest(key, rootptr, order);
 
-    if ((*closest)->key != key)  // node not found, do nothing and return
+    if (order != 0)  // node not found, do nothing and return
         return;
 
+    // the node will be removed, so every node on the path from the root loses one descendant
+    for (Node *ancestor = (*closest)->parent; ancestor != nullptr; ancestor = ancestor->parent)
+        --ancestor->subtreeSize;
+
     if ((*closest)->rightChild == nullptr && (*closest)->leftChild == nullptr) {
         // no children, just change the pointer from its parent to null and delete
         auto removedNode = *closest;
         *closest = nullptr;
-        delete removedNode;
+        nodeAllocator.destroy(removedNode);
 
     } else if ((*closest)->rightChild == nullptr && (*closest)->leftChild != nullptr) {
         // single child cases, swap its non null child in ints place and delete the node
         auto removedNode = *closest;
         *closest = (*closest)->leftChild;
-        removedNode->leftChild = nullptr;
-        delete removedNode;
+        (*closest)->parent = removedNode->parent;
+        nodeAllocator.destroy(removedNode);
 
     } else if ((*closest)->leftChild == nullptr && (*closest)->rightChild != nullptr) {
         auto removedNode = *closest;
         *closest = (*closest)->rightChild;
-        removedNode->rightChild = nullptr;
-        delete removedNode;
+        (*closest)->parent = removedNode->parent;
+        nodeAllocator.destroy(removedNode);
 
     } else {
         auto removedNode = *closest;
         // find the node on the left of the removed node with the largest value
-        auto subNode = findClosest((*closest)->key, &((*closest)->leftChild));
+        auto subNode = findClosest((*closest)->key, &((*closest)->leftChild), order);
         auto keepSubNode = *subNode;  // store a pointer to the subnode before changing the original pointer from its parent
+        // the substitution node is the rightmost one in the left subtree, nodes above it lose one descendant
+        for (Node *ancestor = removedNode->leftChild; ancestor != keepSubNode; ancestor = ancestor->rightChild)
+            --ancestor->subtreeSize;
+        keepSubNode->subtreeSize = removedNode->subtreeSize - 1;
         // remove the substitution node from its place and substitute it with its left child if necessary
         *subNode = ((*subNode)->leftChild == nullptr) ? nullptr : ((*subNode)->leftChild);
+        if (*subNode != nullptr)
+            (*subNode)->parent = keepSubNode->parent;
 
         keepSubNode->leftChild = removedNode->leftChild;    // repin the children
         keepSubNode->rightChild = removedNode->rightChild;
+        if (keepSubNode->leftChild != nullptr)
+            keepSubNode->leftChild->parent = keepSubNode;
+        keepSubNode->rightChild->parent = keepSubNode;
 
-        removedNode->leftChild = nullptr;                   // remove the children before deleting the node
-        removedNode->rightChild = nullptr;
-
+        keepSubNode->parent = removedNode->parent;
         *closest = keepSubNode;                             // put the subnode in place
-        delete removedNode;                                 // delete the unneeded node
+        nodeAllocator.destroy(removedNode);                 // delete the unneeded node
     }
 }
 
-template<typename KeyType, typename ValueType>
-KeyType BinarySearchTree<KeyType, ValueType>::findClosestTester(KeyType &key) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+KeyType BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::findClosestTester(KeyType &key) {
     Node **rootptr = &root;
-    auto closest = findClosest(key, rootptr);
+    int order;
+    auto closest = findClosest(key, rootptr, order);
     int k = (*closest)->key;
     return k;
 }
 
-template<typename KeyType, typename ValueType>
-typename BinarySearchTree<KeyType, ValueType>::Node **
-BinarySearchTree<KeyType, ValueType>::findClosest(const KeyType &key, Node **starting_point) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node **
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::findClosest(const KeyType &key, Node **starting_point, int &order) const {
     Node **current_closest = starting_point;
 
-    if ((*current_closest)->key > key && (*current_closest)->leftChild != nullptr) {
-        current_closest = &((*current_closest)->leftChild);
-        return findClosest(key, current_closest);
-    } else if ((*current_closest)->key < key && (*current_closest)->rightChild != nullptr) {
-        current_closest = &((*current_closest)->rightChild);
-        return findClosest(key, current_closest);
-    } else {
-        return current_closest;
+    // a single three-way comparison per node, the last result tells the caller where the key belongs
+    while (true) {
+        order = compare(key, (*current_closest)->key);
+        if (order < 0 && (*current_closest)->leftChild != nullptr) {
+            current_closest = &((*current_closest)->leftChild);
+        } else if (order > 0 && (*current_closest)->rightChild != nullptr) {
+            current_closest = &((*current_closest)->rightChild);
+        } else {
+            return current_closest;
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node::nodeSubtreeSize(Node const *node) {
+    if (node == nullptr)
+        return 0;
+
+    return node->subtreeSize;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::rank(const KeyType &key) const {
+    size_t lessCount = 0;
+    Node const *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else if (order > 0) {
+            lessCount += Node::nodeSubtreeSize(current->leftChild) + 1;
+            current = current->rightChild;
+        } else {
+            return lessCount + Node::nodeSubtreeSize(current->leftChild);
+        }
+    }
+    return lessCount;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::countNotGreater(const KeyType &key) const {
+    size_t count = 0;
+    Node const *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else if (order > 0) {
+            count += Node::nodeSubtreeSize(current->leftChild) + 1;
+            current = current->rightChild;
+        } else {
+            return count + Node::nodeSubtreeSize(current->leftChild) + 1;
+        }
+    }
+    return count;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+KeyType const *BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::select(size_t k) const {
+    Node const *current = root;
+    while (current != nullptr) {
+        auto leftSize = Node::nodeSubtreeSize(current->leftChild);
+        if (k < leftSize) {
+            current = current->leftChild;
+        } else if (k > leftSize) {
+            k -= leftSize + 1;
+            current = current->rightChild;
+        } else {
+            return &(current->key);
+        }
     }
+    return nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-size_t BinarySearchTree<KeyType, ValueType>::sizeOfSubtree(Node *subRoot) const {
-    if (subRoot == nullptr)
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::countInRange(const KeyType &lo, const KeyType &hi) const {
+    if (compare(hi, lo) < 0)
         return 0;
 
-    auto left = sizeOfSubtree(subRoot->leftChild);
-    auto right = sizeOfSubtree(subRoot->rightChild);
-    return left + right + 1;
+    return countNotGreater(hi) - rank(lo);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::~BinarySearchTree() {
+    clear();
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::clear() {
+    // trivially destructible nodes in a pool can be freed together with their slabs
+    if (!NodeAllocator<Node>::RELEASES_IN_BULK || !std::is_trivially_destructible<Node>::value)
+        destroySubtree(root);
+
+    nodeAllocator.releaseAll();
+    root = nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::buildFromSorted(ForwardIterator first, ForwardIterator last,
+                                                                         size_t threadCount) {
+    // keys have to be strictly increasing, the resulting tree is perfectly balanced
+    assert(std::adjacent_find(first, last, [this](decltype(*first) previous, decltype(*first) next) {
+        return compare(previous.first, next.first) >= 0;
+    }) == last);
+
+    clear();
+    auto count = (size_t) std::distance(first, last);
+    if (threadCount <= 1 || count < 2 * PARALLEL_BUILD_GRAIN) {
+        root = buildSubtree(first, count, nodeAllocator);
+        return;
+    }
+
+    // top levels are created here, the independent subtrees below them are built concurrently
+    // into separate allocators which are adopted afterwards
+    std::vector<BuildTask<ForwardIterator>> tasks;
+    std::vector<NodeAllocator<Node>> allocators;
+    try {
+        splitBuild(first, count, nullptr, &root, threadCount, tasks);
+
+        allocators.resize(tasks.size());
+        std::vector<std::function<void()>> builds;
+        for (size_t idx = 0; idx < tasks.size(); ++idx) {
+            builds.push_back([this, &tasks, &allocators, idx]() {
+                auto current = tasks[idx].first;
+                auto subRoot = buildSubtree(current, tasks[idx].count, allocators[idx]);
+                if (subRoot != nullptr)
+                    subRoot->parent = tasks[idx].parent;
+                *tasks[idx].link = subRoot;
+            });
+        }
+        runConcurrently(builds);
+    } catch (...) {
+        // a failed build has destroyed its own nodes and left its link empty, the rest is reachable from root
+        for (auto &allocator : allocators)
+            nodeAllocator.adopt(std::move(allocator));
+        clear();
+        throw;
+    }
+
+    for (auto &allocator : allocators)
+        nodeAllocator.adopt(std::move(allocator));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::splitBuild(ForwardIterator first, size_t count,
+                                                                    Node *parent, Node **link, size_t threadCount,
+                                                                    std::vector<BuildTask<ForwardIterator>> &tasks) {
+    if (threadCount <= 1 || count < 2 * PARALLEL_BUILD_GRAIN) {
+        tasks.push_back({first, count, parent, link});
+        return;
+    }
+
+    // same medians as buildSubtree, so the shape does not depend on the number of threads
+    auto leftCount = (count - 1) / 2;
+    auto median = std::next(first, leftCount);
+    auto subRoot = nodeAllocator.create(median->first, median->second);
+    subRoot->parent = parent;
+    subRoot->subtreeSize = count;
+    *link = subRoot;
+    splitBuild(first, leftCount, subRoot, &subRoot->leftChild, threadCount / 2, tasks);
+    splitBuild(std::next(median), count - 1 - leftCount, subRoot, &subRoot->rightChild,
+               threadCount - threadCount / 2, tasks);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename ForwardIterator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::buildSubtree(ForwardIterator &current, size_t count,
+                                                                  NodeAllocator<Node> &allocator) {
+    if (count == 0)
+        return nullptr;
+
+    // elements are consumed in order: left subtree, subtree's root, right subtree
+    auto leftCount = (count - 1) / 2;
+    auto left = buildSubtree(current, leftCount, allocator);
+
+    // nodes built so far are destroyed when a copy throws, a failed right subtree cleans up after itself
+    Node *subRoot = nullptr;
+    try {
+        subRoot = allocator.create(current->first, current->second);
+        ++current;
+        subRoot->leftChild = left;
+        subRoot->rightChild = buildSubtree(current, count - 1 - leftCount, allocator);
+    } catch (...) {
+        destroySubtree(subRoot != nullptr ? subRoot : left, allocator);
+        throw;
+    }
+    subRoot->subtreeSize = count;
+    if (subRoot->leftChild != nullptr)
+        subRoot->leftChild->parent = subRoot;
+    if (subRoot->rightChild != nullptr)
+        subRoot->rightChild->parent = subRoot;
+    return subRoot;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename InputIterator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::bulkLoad(InputIterator first, InputIterator last,
+                                                                  bool deduplicate, size_t threadCount) {
+    std::vector<std::pair<KeyType, ValueType>> pairs;
+    for (; first != last; ++first)
+        pairs.emplace_back(first->first, first->second);
+
+    // stable sort keeps equal keys in input order, the last one of each run is the latest write
+    parallelStableSort(pairs.begin(), pairs.end(), threadCount, [this](std::pair<KeyType, ValueType> const &lhs,
+                                                                      std::pair<KeyType, ValueType> const &rhs) {
+        return compare(lhs.first, rhs.first) < 0;
+    });
+
+    if (deduplicate && !pairs.empty()) {
+        size_t kept = 0;
+        for (size_t idx = 1; idx < pairs.size(); ++idx) {
+            if (compare(pairs[kept].first, pairs[idx].first) < 0)
+                ++kept;
+            if (kept != idx)
+                pairs[kept] = std::move(pairs[idx]);
+        }
+        pairs.resize(kept + 1);
+    }
+
+    buildFromSorted(pairs.begin(), pairs.end(), threadCount);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot) {
+    destroySubtree(subRoot, nodeAllocator);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::destroySubtree(Node *subRoot,
+                                                                           NodeAllocator<Node> &allocator) {
+    // rotate left children up until the current node has none, then it can be destroyed
+    // and its right subtree processed next - no recursion nor auxiliary stack
+    while (subRoot != nullptr) {
+        if (subRoot->leftChild != nullptr) {
+            auto left = subRoot->leftChild;
+            subRoot->leftChild = left->rightChild;
+            left->rightChild = subRoot;
+            subRoot = left;
+        } else {
+            auto right = subRoot->rightChild;
+            allocator.destroy(subRoot);
+            subRoot = right;
+        }
+    }
 }
 
-template<typename KeyType, typename ValueType>
-BinarySearchTree<KeyType, ValueType>::~BinarySearchTree() {
-    delete root;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::BinarySearchTree() {
+    root = nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-BinarySearchTree<KeyType, ValueType>::Node::~Node() {
-    delete leftChild;
-    delete rightChild;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::BinarySearchTree(Compare const &compare)
+        : compare(compare) {
+    root = nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-BinarySearchTree<KeyType, ValueType>::BinarySearchTree() {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::BinarySearchTree(BinarySearchTree const &other)
+        : compare(other.compare) {
     root = nullptr;
+    root = cloneSubtree(other.root);
 }
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::BinarySearchTree(BinarySearchTree &&other) noexcept
+        : nodeAllocator(std::move(other.nodeAllocator)), compare(std::move(other.compare)) {
+    root = other.root;
+    other.root = nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator> &
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::operator=(BinarySearchTree const &other) {
+    if (this != &other) {
+        clear();
+        compare = other.compare;
+        root = cloneSubtree(other.root);
+    }
+    return *this;
+}
 
-template<typename KeyType, typename ValueType>
-std::string BinarySearchTree<KeyType, ValueType>::Node::toString(const std::string &separator) const {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator> &
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::operator=(BinarySearchTree &&other) noexcept {
+    if (this != &other) {
+        clear();
+        nodeAllocator = std::move(other.nodeAllocator);
+        compare = std::move(other.compare);
+        root = other.root;
+        other.root = nullptr;
+    }
+    return *this;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::cloneSubtree(Node const *source) {
+    if (source == nullptr)
+        return nullptr;
+
+    // the whole copy is reserved at once, then copied with an explicit stack of (source, copy) pairs
+    nodeAllocator.reserve(source->subtreeSize);
+    auto cloneRoot = nodeAllocator.create(source->key, source->value);
+    cloneRoot->subtreeSize = source->subtreeSize;
+
+    std::vector<std::pair<Node const *, Node *>> stack;
+    stack.emplace_back(source, cloneRoot);
+    try {
+        while (!stack.empty()) {
+            auto pair = stack.back();
+            stack.pop_back();
+
+            if (pair.first->leftChild != nullptr) {
+                auto sourceChild = pair.first->leftChild;
+                pair.second->leftChild = nodeAllocator.create(sourceChild->key, sourceChild->value);
+                pair.second->leftChild->subtreeSize = sourceChild->subtreeSize;
+                pair.second->leftChild->parent = pair.second;
+                stack.emplace_back(sourceChild, pair.second->leftChild);
+            }
+            if (pair.first->rightChild != nullptr) {
+                auto sourceChild = pair.first->rightChild;
+                pair.second->rightChild = nodeAllocator.create(sourceChild->key, sourceChild->value);
+                pair.second->rightChild->subtreeSize = sourceChild->subtreeSize;
+                pair.second->rightChild->parent = pair.second;
+                stack.emplace_back(sourceChild, pair.second->rightChild);
+            }
+        }
+    } catch (...) {
+        // every created node is already linked into the copy
+        destroySubtree(cloneRoot);
+        throw;
+    }
+    return cloneRoot;
+}
+
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node::toString(const std::string &separator) const {
     std::stringstream ss;
-    ss << "[" << key << "," << separator << value << "]";
+    write(ss, separator.c_str());
     return ss.str();
 }
 
-template<typename KeyType, typename ValueType>
-BinarySearchTree<KeyType, ValueType>::Node::Node(KeyType key, ValueType value) {
-    this->key = key;
-    this->value = value;
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node::write(StreamType &stream, const char *separator) const {
+    stream << "[" << key << "," << separator << this->value << "]";
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node::Node(K &&key, Args &&... valueArgs)
+        : NodeValue<ValueType>(std::forward<Args>(valueArgs)...), key(std::forward<K>(key)) {
+    this->subtreeSize = 1;
     this->leftChild = nullptr;
     this->rightChild = nullptr;
+    this->parent = nullptr;
 }
 
 
-template<typename KeyType, typename ValueType>
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
 template<typename StreamType>
-void BinarySearchTree<KeyType, ValueType>::print(StreamType &stream) const {
-    printSubtree(stream, root, 0, "");
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::print(StreamType &stream, size_t maxDepth) const {
+    printSubtree(stream, root, maxDepth, nullptr, nullptr);
 }
 
-template<typename KeyType, typename ValueType>
-std::string BinarySearchTree<KeyType, ValueType>::indentWhitespace(int width) {
-    return std::string(width, ' ');
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::printRange(StreamType &stream, KeyType const &lo,
+                                                                              KeyType const &hi) const {
+    printSubtree(stream, root, std::numeric_limits<size_t>::max(), &lo, &hi);
 }
 
-template<typename KeyType, typename ValueType>
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
 template<typename StreamType>
-void BinarySearchTree<KeyType, ValueType>::printSubtree(StreamType &stream, Node *subRoot, const int indent,
-                                                        const std::string &prefix) {
-    if (subRoot == nullptr)
-        return;
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::printSubtree(StreamType &stream, Node *subRoot, size_t maxDepth,
+                                                                                KeyType const *lo, KeyType const *hi) const {
+    struct Frame {
+        Node *node;
+        size_t depth;
+        const char *prefix;
+    };
 
-    stream << indentWhitespace(indent) << prefix << subRoot->toString(" ") << '\n';
+    if (subRoot == nullptr || maxDepth == 0)
+        return;
 
-    if (subRoot->leftChild != nullptr)
-        printSubtree(stream, subRoot->leftChild, indent + PRINT_NEST_INDENT, "L: ");
-    if (subRoot->rightChild != nullptr)
-        printSubtree(stream, subRoot->rightChild, indent + PRINT_NEST_INDENT, "R: ");
+    std::vector<Frame> stack;
+    stack.push_back({subRoot, 0, ""});
+    while (!stack.empty()) {
+        auto frame = stack.back();
+        stack.pop_back();
+        // setw pads the empty string, no indentation string is built
+        auto indent = (int) frame.depth * PRINT_NEST_INDENT;
+
+        if (frame.depth >= maxDepth) {
+            stream << std::setw(indent) << "" << frame.prefix << "...\n";
+            continue;
+        }
+
+        auto node = frame.node;
+        bool aboveLo = lo == nullptr || compare(*lo, node->key) < 0;
+        bool belowHi = hi == nullptr || compare(node->key, *hi) < 0;
+        if ((aboveLo || compare(*lo, node->key) == 0) && (belowHi || compare(node->key, *hi) == 0)) {
+            stream << std::setw(indent) << "" << frame.prefix;
+            node->write(stream, " ");
+            stream << '\n';
+        }
+
+        // right pushed first so that left gets printed first, subtrees outside the range are skipped
+        if (node->rightChild != nullptr && belowHi)
+            stack.push_back({node->rightChild, frame.depth + 1, "R: "});
+        if (node->leftChild != nullptr && aboveLo)
+            stack.push_back({node->leftChild, frame.depth + 1, "L: "});
+    }
 }
 
-template<typename KeyType, typename ValueType>
-ValueType *BinarySearchTree<KeyType, ValueType>::find(const KeyType &key) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+ValueType *BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::find(const KeyType &key) {
     if (root == nullptr)
         return nullptr;
 
     Node **rootptr = &root;
-    auto closest = findClosest(key, rootptr);
-    if ((*closest)->key == key) {
+    int order;
+    auto closest = findClosest(key, rootptr, order);
+    if (order == 0) {
         return &((*closest)->value);
     }
     return nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-std::string BinarySearchTree<KeyType, ValueType>::subTreeToString(Node *subRoot) {
-    if (subRoot == nullptr)
-        return "";
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+bool BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::contains(const KeyType &key) const {
+    auto node = root;
+    while (node != nullptr) {
+        int order = compare(key, node->key);
+        if (order == 0)
+            return true;
+        node = (order < 0) ? node->leftChild : node->rightChild;
+    }
+    return false;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::findBatch(std::vector<KeyType> const &keys, std::vector<ValueType *> &outValues) {
+    outValues.assign(keys.size(), nullptr);
+    for (size_t batchStart = 0; batchStart < keys.size(); batchStart += BATCH_WIDTH) {
+        auto width = (keys.size() - batchStart < BATCH_WIDTH) ? keys.size() - batchStart : BATCH_WIDTH;
+        Node *current[BATCH_WIDTH];
+        for (size_t lane = 0; lane < width; ++lane) {
+            current[lane] = root;
+        }
+
+        // Every round moves each unfinished descent one level down, finished lanes hold nullptr
+        bool active = root != nullptr;
+        while (active) {
+            active = false;
+            for (size_t lane = 0; lane < width; ++lane) {
+                auto node = current[lane];
+                if (node == nullptr)
+                    continue;
+                auto order = compare(keys[batchStart + lane], node->key);
+                if (order == 0) {
+                    outValues[batchStart + lane] = &(node->value);
+                    current[lane] = nullptr;
+                    continue;
+                }
+                node = (order < 0) ? node->leftChild : node->rightChild;
+                prefetchRead(node);
+                current[lane] = node;
+                active = active || node != nullptr;
+            }
+        }
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::begin() {
+    return Iterator(InOrder<Node>::first(root), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::end() {
+    return Iterator(nullptr, &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::begin() const {
+    return ConstIterator(InOrder<Node>::first(root), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::end() const {
+    return ConstIterator(nullptr, &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::lowerBound(KeyType const &key) {
+    return Iterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::lowerBound(KeyType const &key) const {
+    return ConstIterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::upperBound(KeyType const &key) {
+    return Iterator(boundNode(key, false), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::upperBound(KeyType const &key) const {
+    return ConstIterator(boundNode(key, false), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::floor(KeyType const &key) {
+    return Iterator(floorNode(key), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::floor(KeyType const &key) const {
+    return ConstIterator(floorNode(key), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Iterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ceiling(KeyType const &key) {
+    return Iterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ConstIterator BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::ceiling(KeyType const &key) const {
+    return ConstIterator(boundNode(key, true), &root);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Visitor>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) {
+    // one descent to the first key in the range, then an in-order walk until the key exceeds hi
+    for (auto node = boundNode(lo, true); node != nullptr && compare(node->key, hi) <= 0; node = InOrder<Node>::next(node))
+        visitor(static_cast<KeyType const &>(node->key), static_cast<ValueType &>(node->value));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename Visitor>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const {
+    // one descent to the first key in the range, then an in-order walk until the key exceeds hi
+    for (auto node = boundNode(lo, true); node != nullptr && compare(node->key, hi) <= 0; node = InOrder<Node>::next(node))
+        visitor(static_cast<KeyType const &>(node->key), static_cast<ValueType const &>(node->value));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::boundNode(const KeyType &key, bool includeKey) const {
+    // smallest node with key >= (or > if includeKey is false) than the given one
+    Node *bound = nullptr;
+    Node *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order == 0 && includeKey)
+            return current;
+        if (order < 0) {
+            bound = current;
+            current = current->leftChild;
+        } else {
+            current = current->rightChild;
+        }
+    }
+    return bound;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node *
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::floorNode(const KeyType &key) const {
+    // largest node with key <= than the given one
+    Node *bound = nullptr;
+    Node *current = root;
+    while (current != nullptr) {
+        auto order = compare(key, current->key);
+        if (order < 0) {
+            current = current->leftChild;
+        } else {
+            bound = current;
+            if (order == 0)
+                break;
+            current = current->rightChild;
+        }
+    }
+    return bound;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+FrozenTree<KeyType, ValueType, Compare> BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::freeze() const {
+    return FrozenTree<KeyType, ValueType, Compare>(begin(), size(), compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::save(std::string const &path) const {
+    saveMappedTree<KeyType, ValueType>(path, begin(), size());
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+MappedTree<KeyType, ValueType, Compare>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::openMapped(std::string const &path, bool verifyChecksum,
+                                                                         Compare const &compare) {
+    return MappedTree<KeyType, ValueType, Compare>::open(path, verifyChecksum, compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Cursor BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::cursor() {
+    return Cursor(&root, &compare);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::writeSubtree(StreamType &stream, Node *subRoot, size_t maxDepth) {
+    // stack holds either a node to expand or a literal to emit, so that "(node,left,right)" is produced in order
+    struct Item {
+        Node *node;
+        const char *literal;
+        size_t depth;
+    };
 
-    auto left = subTreeToString(subRoot->leftChild);
-    auto right = subTreeToString(subRoot->rightChild);
+    std::vector<Item> stack;
+    stack.push_back({subRoot, nullptr, 0});
+    while (!stack.empty()) {
+        auto item = stack.back();
+        stack.pop_back();
+
+        if (item.literal != nullptr) {
+            stream << item.literal;
+        } else if (item.node != nullptr && item.depth >= maxDepth) {
+            stream << "...";
+        } else if (item.node != nullptr) {
+            stream << "(";
+            item.node->write(stream, "");
+            stream << ",";
+            stack.push_back({nullptr, ")", 0});
+            stack.push_back({item.node->rightChild, nullptr, item.depth + 1});
+            stack.push_back({nullptr, ",", 0});
+            stack.push_back({item.node->leftChild, nullptr, item.depth + 1});
+        }
+    }
+}
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::string BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::toString() const {
     std::stringstream ss;
-    ss << "(" << subRoot->toString() << "," << left << "," << right << ")";
+    writeSubtree(ss, root, std::numeric_limits<size_t>::max());
     return ss.str();
 }
 
-template<typename KeyType, typename ValueType>
-std::string BinarySearchTree<KeyType, ValueType>::toString() const {
-    return subTreeToString(root);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename StreamType>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::writeString(StreamType &stream, size_t maxDepth) const {
+    writeSubtree(stream, root, maxDepth);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+typename BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::Node **
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::findInsertionPoint(const KeyType &key, Node *&parent) {
+    // link to the node with the key, or the empty link below the closest node where the key belongs
+    parent = nullptr;
+    if (root == nullptr)
+        return &root;
+
+    int order;
+    Node **closest = findClosest(key, &root, order);
+    if (order == 0)
+        return closest;
+
+    parent = *closest;
+    return (order < 0) ? &(parent->leftChild) : &(parent->rightChild);
 }
 
-template<typename KeyType, typename ValueType>
-void BinarySearchTree<KeyType, ValueType>::insert(const KeyType &key, const ValueType &value) {
-    if (root == nullptr) {
-        root = new Node(key, value);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::attachNode(Node **link, Node *parent, Node *node) {
+    // new leaf hangs at the link, every node on the path from the root gains one descendant
+    node->parent = parent;
+    *link = node;
+    for (Node *ancestor = parent; ancestor != nullptr; ancestor = ancestor->parent)
+        ++ancestor->subtreeSize;
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename V>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::insertOrAssign(K &&key, V &&value) {
+    Node *parent;
+    Node **link = findInsertionPoint(key, parent);
+    if (*link != nullptr) {
+        (*link)->value = std::forward<V>(value);
         return;
     }
 
-    Node **rootptr = &root;
-    Node **closest = findClosest(key, rootptr);
+    attachNode(link, parent, nodeAllocator.create(std::forward<K>(key), std::forward<V>(value)));
+}
 
-    if ((*closest)->key == key)
-        (*closest)->value = value;
-    else if ((*closest)->key > key)
-        (*closest)->leftChild = new Node(key, value);
-    else
-        (*closest)->rightChild = new Node(key, value);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+std::pair<ValueType *, bool>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::emplaceIfAbsent(K &&key, Args &&... valueArgs) {
+    Node *parent;
+    Node **link = findInsertionPoint(key, parent);
+    if (*link != nullptr)
+        return std::make_pair(&((*link)->value), false);
+
+    auto node = nodeAllocator.create(std::forward<K>(key), std::forward<Args>(valueArgs)...);
+    attachNode(link, parent, node);
+    return std::make_pair(&(node->value), true);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::insert(const KeyType &key, const ValueType &value) {
+    insertOrAssign(key, value);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+void BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::insert(KeyType &&key, ValueType &&value) {
+    insertOrAssign(std::move(key), std::move(value));
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename K, typename... Args>
+std::pair<ValueType *, bool>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::emplace(K &&key, Args &&... valueArgs) {
+    // the key has to be constructed before it can be compared, so the node is created up front
+    auto node = nodeAllocator.create(std::forward<K>(key), std::forward<Args>(valueArgs)...);
+    Node *parent;
+    Node **link = findInsertionPoint(node->key, parent);
+    if (*link != nullptr) {
+        nodeAllocator.destroy(node);
+        return std::make_pair(&((*link)->value), false);
+    }
+
+    attachNode(link, parent, node);
+    return std::make_pair(&(node->value), true);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename... Args>
+std::pair<ValueType *, bool>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::tryEmplace(const KeyType &key, Args &&... valueArgs) {
+    return emplaceIfAbsent(key, std::forward<Args>(valueArgs)...);
+}
+
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+template<typename... Args>
+std::pair<ValueType *, bool>
+BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::tryEmplace(KeyType &&key, Args &&... valueArgs) {
+    return emplaceIfAbsent(std::move(key), std::forward<Args>(valueArgs)...);
+}
 
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::size() const {
+    return Node::nodeSubtreeSize(root);
 }
 
-template<typename KeyType, typename ValueType>
-size_t BinarySearchTree<KeyType, ValueType>::size() const {
-    return sizeOfSubtree(root);
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+size_t BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator>::nodeBytes() {
+    return sizeof(Node);
 }
 
-template<typename KeyType, typename ValueType>
-std::ostream &operator<<(std::ostream &stream, BinarySearchTree<KeyType, ValueType> const &tree) {
+template<typename KeyType, typename ValueType, typename Compare, template<typename> class NodeAllocator>
+std::ostream &operator<<(std::ostream &stream, BinarySearchTree<KeyType, ValueType, Compare, NodeAllocator> const &tree) {
     tree.print(stream);
     return stream;
 }
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <utility>
+#include "BinarySearchTree.h"
+
+
+// binary search tree of keys only, nodes store no value (see NodeValue)
+template<typename KeyType, typename Compare = ThreeWayCompare<KeyType>,
+        template<typename> class NodeAllocator = NodePool>
+class BinarySearchTreeSet : public BinarySearchTree<KeyType, NoValue, Compare, NodeAllocator> {
+private:
+    using Base = BinarySearchTree<KeyType, NoValue, Compare, NodeAllocator>;
+
+public:
+    using Base::insert;
+
+    BinarySearchTreeSet() = default;
+
+    explicit BinarySearchTreeSet(Compare const &compare) : Base(compare) {}
+
+    explicit BinarySearchTreeSet(Base &&tree) noexcept : Base(std::move(tree)) {}
+
+    // returns true if the key was not present yet
+    bool insert(KeyType const &key) {
+        return this->tryEmplace(key).second;
+    }
+
+    bool insert(KeyType &&key) {
+        return this->tryEmplace(std::move(key)).second;
+    }
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+
+
+/**
+ * Three-way comparator built on a strict weak ordering predicate
+ *
+ * Comparators used by the trees are called once per visited node and return a negative value, zero
+ * or a positive value when the first key is respectively less than, equal to or greater than the second one.
+ * Keys with a cheaper native three-way comparison should provide their own comparator instead,
+ * this adapter needs two predicate calls to tell equal keys apart.
+ *
+ * @tparam KeyType type of compared keys
+ * @tparam Less strict weak ordering predicate (std::less, std::greater, ...)
+ */
+template<typename KeyType, typename Less = std::less<KeyType>>
+struct ThreeWayCompare {
+    Less less;
+
+    ThreeWayCompare() = default;
+
+    explicit ThreeWayCompare(Less const &less) : less(less) {}
+
+    int operator()(KeyType const &lhs, KeyType const &rhs) const {
+        if (less(lhs, rhs)) {
+            return -1;
+        }
+        return less(rhs, lhs) ? 1 : 0;
+    }
+};
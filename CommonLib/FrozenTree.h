@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Compare.h"
+#include "Prefetch.h"
+
+
+/**
+ * Immutable, pointer-free snapshot of a search tree in Eytzinger (breadth-first) layout
+ *
+ * Elements are laid out as a complete binary search tree in breadth-first order, children of index k
+ * are at 2k and 2k + 1, so the top levels shared by all searches stay in a few cache lines and deeper
+ * levels can be prefetched ahead of the comparisons.
+ * Keys and values are kept in separate arrays, a search touches only keys.
+ * All member functions are const and nothing is modified after construction, so a snapshot can be
+ * read from any number of threads without synchronization.
+ *
+ * @tparam KeyType type of the keys, has to be default constructible
+ * @tparam ValueType type of the values, has to be default constructible
+ * @tparam Compare three-way comparator of the keys (see ThreeWayCompare)
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>>
+class FrozenTree {
+private:
+
+    /**
+     * Keys in Eytzinger order, index 0 is unused so that the root is at 1
+     */
+    std::vector<KeyType> keys;
+
+    /**
+     * Values in the same order as keys
+     */
+    std::vector<ValueType> values;
+
+    Compare compare;
+
+    /**
+     * Distance in levels at which a search prefetches keys, 16 keys of a level fit in a few cache lines
+     */
+    static const size_t PREFETCH_LEVELS = 4;
+
+    /**
+     * Fill slots of a subtree in in-order, consuming the source sequentially
+     *
+     * @tparam InputIterator iterator over pairs (first - key, second - value) sorted by key
+     * @param current next element of the source, advanced past the consumed elements
+     * @param slot Eytzinger index of the subtree's root
+     */
+    template<typename InputIterator>
+    void fill(InputIterator &current, size_t slot);
+
+    /**
+     * Get Eytzinger index of the smallest key not less than given key
+     *
+     * Every level is one comparison and an index update without a data-dependent branch
+     *
+     * @param key searched key
+     * @return index of the found key or 0 if all keys are less than key
+     */
+    size_t lowerBoundSlot(KeyType const &key) const;
+
+public:
+
+    /**
+     * Initialize empty snapshot
+     */
+    FrozenTree() : keys(1), values(1) {}
+
+    /**
+     * Build snapshot from a sequence sorted by strictly increasing keys, O(n)
+     *
+     * @tparam InputIterator iterator over pairs (first - key, second - value), like the trees' iterators
+     * @param first beginning of the sorted sequence
+     * @param count number of elements in the sequence
+     * @param compare comparator the sequence is sorted by
+     */
+    template<typename InputIterator>
+    FrozenTree(InputIterator first, size_t count, Compare const &compare = Compare());
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value or nullptr if not found
+     */
+    ValueType const *find(KeyType const &key) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename InputIterator>
+FrozenTree<KeyType, ValueType, Compare>::FrozenTree(InputIterator first, size_t count, Compare const &compare)
+        : keys(count + 1), values(count + 1), compare(compare) {
+    fill(first, 1);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename InputIterator>
+void FrozenTree<KeyType, ValueType, Compare>::fill(InputIterator &current, size_t slot) {
+    // Recursion depth is the height of the implicit tree, log2(n)
+    if (slot >= keys.size()) {
+        return;
+    }
+
+    fill(current, 2 * slot);
+    keys[slot] = current->first;
+    values[slot] = current->second;
+    ++current;
+    fill(current, 2 * slot + 1);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t FrozenTree<KeyType, ValueType, Compare>::size() const {
+    return keys.size() - 1;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t FrozenTree<KeyType, ValueType, Compare>::lowerBoundSlot(KeyType const &key) const {
+    auto count = keys.size() - 1;
+    auto data = keys.data();
+    size_t slot = 1;
+    while (slot <= count) {
+        prefetchRead(data + (slot << PREFETCH_LEVELS));
+        // Go right when the slot's key is less than the searched one
+        slot = 2 * slot + (compare(data[slot], key) < 0);
+    }
+
+    // Path bits record the turns, after the last left turn the slot is the lower bound;
+    // dropping trailing right turns (ones) and that left turn (zero) recovers it
+#if defined(__GNUC__)
+    return slot >> __builtin_ffsll((long long) ~slot);
+#else
+    while (slot & 1) {
+        slot >>= 1;
+    }
+    return slot >> 1;
+#endif
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+ValueType const *FrozenTree<KeyType, ValueType, Compare>::find(KeyType const &key) const {
+    auto slot = lowerBoundSlot(key);
+    if (slot == 0 || compare(key, keys[slot]) != 0) {
+        return nullptr;
+    }
+    return &values[slot];
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+bool FrozenTree<KeyType, ValueType, Compare>::contains(KeyType const &key) const {
+    return find(key) != nullptr;
+}
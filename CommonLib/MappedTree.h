@@ -0,0 +1,643 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Compare.h"
+#include "Prefetch.h"
+
+
+/**
+ * Header at the beginning of a snapshot file written by saveMappedTree
+ *
+ * The file holds all keys sorted in increasing order, followed by the values in the same order.
+ * Both arrays start at offsets aligned to MAPPED_TREE_ALIGNMENT and are stored in the host's
+ * byte order, so a mapping of the file is used directly without deserialization.
+ */
+struct MappedTreeHeader {
+    /**
+     * File type marker, MAPPED_TREE_MAGIC
+     */
+    char magic[8];
+
+    /**
+     * Format version, MAPPED_TREE_VERSION
+     */
+    std::uint32_t version;
+
+    /**
+     * MAPPED_TREE_BYTE_ORDER as written by the saving host, detects files from hosts of other endianness
+     */
+    std::uint32_t byteOrder;
+
+    /**
+     * sizeof of the key and value types, detects opening with different types
+     */
+    std::uint32_t keySize;
+    std::uint32_t valueSize;
+
+    /**
+     * Number of stored elements
+     */
+    std::uint64_t count;
+
+    /**
+     * Offsets of the key and value arrays from the beginning of the file
+     */
+    std::uint64_t keysOffset;
+    std::uint64_t valuesOffset;
+
+    /**
+     * Size of the whole file, the payload after the header is padded to a multiple of 8 bytes
+     */
+    std::uint64_t fileSize;
+
+    /**
+     * Checksum of everything after the header, see MappedTreeChecksum
+     */
+    std::uint64_t checksum;
+};
+
+const char MAPPED_TREE_MAGIC[8] = {'T', 'R', 'E', 'E', 'S', 'N', 'A', 'P'};
+
+const std::uint32_t MAPPED_TREE_VERSION = 1;
+
+const std::uint32_t MAPPED_TREE_BYTE_ORDER = 0x01020304;
+
+/**
+ * Alignment of the arrays in the file, one cache line
+ */
+const std::uint64_t MAPPED_TREE_ALIGNMENT = 64;
+
+static_assert(sizeof(MappedTreeHeader) <= MAPPED_TREE_ALIGNMENT, "Header has to fit before the first array");
+
+/**
+ * Running checksum of a byte stream consumed in 8 byte words
+ *
+ * Not cryptographic, it detects truncated, torn or corrupted files
+ */
+class MappedTreeChecksum {
+private:
+    std::uint64_t hash = 0x84222325CBF29CE4ULL;
+
+public:
+
+    /**
+     * Consume words of the stream
+     *
+     * @param data first word, does not have to be aligned
+     * @param words number of 8 byte words
+     */
+    void update(void const *data, size_t words) {
+        auto bytes = static_cast<unsigned char const *>(data);
+        for (size_t idx = 0; idx < words; ++idx) {
+            std::uint64_t word;
+            std::memcpy(&word, bytes + 8 * idx, sizeof(word));
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+            hash ^= hash >> 29;
+        }
+    }
+
+    /**
+     * Get checksum of the words consumed so far
+     *
+     * @return checksum
+     */
+    std::uint64_t value() const {
+        return hash;
+    }
+};
+
+/**
+ * Round offset up to a multiple of alignment
+ *
+ * @param offset rounded offset
+ * @param alignment power of two
+ * @return smallest multiple of alignment not less than offset
+ */
+inline std::uint64_t alignMappedOffset(std::uint64_t offset, std::uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Buffered writer of a snapshot file computing the checksum of the written payload
+ */
+class MappedTreeWriter {
+private:
+    std::FILE *file;
+
+    std::string path;
+
+    std::vector<unsigned char> buffer;
+
+    std::uint64_t written = 0;
+
+    MappedTreeChecksum checksum;
+
+    /**
+     * Size of the buffer, a multiple of 8 so that the checksum sees whole words
+     */
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    /**
+     * Throw exception describing failed operation and errno
+     *
+     * @param operation description of the failed operation
+     */
+    [[noreturn]] void fail(char const *operation) {
+        throw std::system_error(errno, std::generic_category(), std::string(operation) + " " + path);
+    }
+
+    /**
+     * Write and checksum the buffered bytes, the buffer size has to be a multiple of 8
+     */
+    void flush() {
+        checksum.update(buffer.data(), buffer.size() / 8);
+        if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            fail("Cannot write");
+        }
+        buffer.clear();
+    }
+
+public:
+
+    /**
+     * Create file and reserve space for the header
+     *
+     * @param path created file, replaced if it exists
+     */
+    explicit MappedTreeWriter(std::string path) : path(std::move(path)) {
+        file = std::fopen(this->path.c_str(), "wb");
+        if (file == nullptr) {
+            fail("Cannot create");
+        }
+        buffer.reserve(BUFFER_SIZE);
+        // The header is filled in by finish, the payload starts after its slot
+        static const unsigned char placeholder[MAPPED_TREE_ALIGNMENT] = {};
+        if (std::fwrite(placeholder, sizeof(placeholder), 1, file) != 1) {
+            fail("Cannot write");
+        }
+        written = MAPPED_TREE_ALIGNMENT;
+    }
+
+    ~MappedTreeWriter() {
+        if (file != nullptr) {
+            std::fclose(file);
+        }
+    }
+
+    MappedTreeWriter(MappedTreeWriter const &) = delete;
+
+    MappedTreeWriter &operator=(MappedTreeWriter const &) = delete;
+
+    /**
+     * Get offset of the next written byte
+     *
+     * @return offset from the beginning of the file
+     */
+    std::uint64_t offset() const {
+        return written;
+    }
+
+    /**
+     * Append bytes
+     *
+     * @param data appended bytes
+     * @param size number of bytes
+     */
+    void write(void const *data, size_t size) {
+        auto bytes = static_cast<unsigned char const *>(data);
+        while (size > 0) {
+            auto chunk = BUFFER_SIZE - buffer.size();
+            chunk = chunk < size ? chunk : size;
+            buffer.insert(buffer.end(), bytes, bytes + chunk);
+            bytes += chunk;
+            size -= chunk;
+            written += chunk;
+            if (buffer.size() == BUFFER_SIZE) {
+                flush();
+            }
+        }
+    }
+
+    /**
+     * Append zero bytes up to an aligned offset
+     *
+     * @param alignment power of two
+     */
+    void pad(std::uint64_t alignment) {
+        static const unsigned char zeros[MAPPED_TREE_ALIGNMENT] = {};
+        while (written % alignment != 0) {
+            auto missing = alignMappedOffset(written, alignment) - written;
+            write(zeros, missing < sizeof(zeros) ? (size_t) missing : sizeof(zeros));
+        }
+    }
+
+    /**
+     * Pad the payload, write the header with its checksum, sync the file to disk and close it
+     *
+     * @param header header with all fields but the file size and checksum filled in
+     */
+    void finish(MappedTreeHeader header) {
+        pad(8);
+        flush();
+        header.fileSize = written;
+        header.checksum = checksum.value();
+        if (std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+            std::fflush(file) != 0) {
+            fail("Cannot write");
+        }
+        // Data has to be durable before the rename publishing it, the rename may reach the disk first otherwise
+        if (fsync(fileno(file)) != 0) {
+            fail("Cannot sync");
+        }
+        auto result = std::fclose(file);
+        file = nullptr;
+        if (result != 0) {
+            fail("Cannot close");
+        }
+    }
+};
+
+/**
+ * Make a rename or creation of a file durable by syncing its directory
+ *
+ * @param path path of the file
+ * @throws std::system_error if the directory cannot be synced
+ */
+inline void syncParentDirectory(std::string const &path) {
+    auto separator = path.find_last_of('/');
+    auto directory = (separator == std::string::npos) ? std::string(".")
+                                                      : (separator == 0 ? std::string("/") : path.substr(0, separator));
+    auto descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open directory " + directory);
+    }
+    auto result = fsync(descriptor);
+    auto error = errno;
+    close(descriptor);
+    if (result != 0) {
+        throw std::system_error(error, std::generic_category(), "Cannot sync directory " + directory);
+    }
+}
+
+/**
+ * Write sorted elements into a snapshot file readable by MappedTree, O(n)
+ *
+ * The file is written under a temporary name, synced and renamed over path when complete, and the rename
+ * is synced as well, so neither a crash nor a power loss while saving leaves a torn snapshot under path.
+ *
+ * @tparam KeyType trivially copyable type of the keys
+ * @tparam ValueType trivially copyable type of the values
+ * @tparam ForwardIterator iterator over pairs (first - key, second - value) sorted by key, like the trees' iterators
+ * @param path saved file
+ * @param first beginning of the sorted sequence, traversed twice
+ * @param count number of elements in the sequence
+ * @throws std::system_error if the file cannot be written
+ */
+template<typename KeyType, typename ValueType, typename ForwardIterator>
+void saveMappedTree(std::string const &path, ForwardIterator first, size_t count) {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Only trivially copyable keys and values can be mapped");
+
+    auto temporaryPath = path + ".tmp";
+    try {
+        MappedTreeWriter writer(temporaryPath);
+        MappedTreeHeader header = {};
+        std::memcpy(header.magic, MAPPED_TREE_MAGIC, sizeof(header.magic));
+        header.version = MAPPED_TREE_VERSION;
+        header.byteOrder = MAPPED_TREE_BYTE_ORDER;
+        header.keySize = sizeof(KeyType);
+        header.valueSize = sizeof(ValueType);
+        header.count = count;
+
+        header.keysOffset = writer.offset();
+        auto current = first;
+        for (size_t idx = 0; idx < count; ++idx, ++current) {
+            KeyType const &key = current->first;
+            writer.write(&key, sizeof(KeyType));
+        }
+
+        writer.pad(MAPPED_TREE_ALIGNMENT);
+        header.valuesOffset = writer.offset();
+        current = first;
+        for (size_t idx = 0; idx < count; ++idx, ++current) {
+            ValueType const &value = current->second;
+            writer.write(&value, sizeof(ValueType));
+        }
+        writer.finish(header);
+    } catch (...) {
+        std::remove(temporaryPath.c_str());
+        throw;
+    }
+
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot rename " + temporaryPath);
+    }
+    syncParentDirectory(path);
+}
+
+/**
+ * Read-only view of a snapshot file mapped into memory
+ *
+ * Lookups and scans run directly on the mapping, opening costs one mmap and an optional checksum pass,
+ * pages are loaded lazily by the first searches touching them.
+ * All member functions are const and the mapping is never modified, so a view can be read from any
+ * number of threads without synchronization.
+ *
+ * @tparam KeyType trivially copyable type of the keys, same as when saving
+ * @tparam ValueType trivially copyable type of the values, same as when saving
+ * @tparam Compare three-way comparator of the keys ordering the keys the same way as when saving
+ */
+template<typename KeyType, typename ValueType, typename Compare = ThreeWayCompare<KeyType>>
+class MappedTree {
+    static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                  "Only trivially copyable keys and values can be mapped");
+
+private:
+
+    void *mapping = nullptr;
+
+    size_t mappingSize = 0;
+
+    KeyType const *keys = nullptr;
+
+    ValueType const *values = nullptr;
+
+    size_t count = 0;
+
+    Compare compare;
+
+    /**
+     * Unmap the file
+     */
+    void release();
+
+    /**
+     * Get index of the smallest key not less than given key
+     *
+     * Branchless binary search, the next probes of both halves are prefetched
+     *
+     * @param key searched key
+     * @return index of the found key or size() if all keys are less than key
+     */
+    size_t lowerBoundIndex(KeyType const &key) const;
+
+public:
+
+    /**
+     * Initialize empty view
+     *
+     * @param compare three-way comparator of the keys
+     */
+    explicit MappedTree(Compare const &compare = Compare()) : compare(compare) {}
+
+    /**
+     * Map snapshot file written by saveMappedTree
+     *
+     * The checksum pass reads the whole file once, skipping it makes opening O(1)
+     * at the cost of trusting the file's contents
+     *
+     * @param path snapshot file
+     * @param verifyChecksum whether to compare the payload with the header's checksum
+     * @param compare three-way comparator of the keys
+     * @return view of the file
+     * @throws std::system_error if the file cannot be opened or mapped
+     * @throws std::runtime_error if the file is not a valid snapshot of these key and value types
+     */
+    static MappedTree open(std::string const &path, bool verifyChecksum = true, Compare const &compare = Compare());
+
+    ~MappedTree();
+
+    MappedTree(MappedTree const &) = delete;
+
+    MappedTree &operator=(MappedTree const &) = delete;
+
+    MappedTree(MappedTree &&other) noexcept;
+
+    MappedTree &operator=(MappedTree &&other) noexcept;
+
+    /**
+     * Get number of stored elements
+     *
+     * @return number of stored elements
+     */
+    size_t size() const;
+
+    /**
+     * Find value associated with key
+     *
+     * @param key searched key
+     * @return pointer to the value inside the mapping or nullptr if not found
+     */
+    ValueType const *find(KeyType const &key) const;
+
+    /**
+     * Check whether key is present
+     *
+     * @param key searched key
+     * @return whether key is present
+     */
+    bool contains(KeyType const &key) const;
+
+    /**
+     * Call visitor for every element in increasing key order
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param visitor callable invoked for each element
+     */
+    template<typename Visitor>
+    void forEach(Visitor &&visitor) const;
+
+    /**
+     * Call visitor for every key in range [lo, hi] (inclusive), in increasing order
+     *
+     * @tparam Visitor callable taking (KeyType const &, ValueType const &)
+     * @param lo lower bound of the range
+     * @param hi upper bound of the range
+     * @param visitor callable invoked for each key in the range
+     */
+    template<typename Visitor>
+    void forEachInRange(KeyType const &lo, KeyType const &hi, Visitor &&visitor) const;
+};
+
+template<typename KeyType, typename ValueType, typename Compare>
+MappedTree<KeyType, ValueType, Compare>
+MappedTree<KeyType, ValueType, Compare>::open(std::string const &path, bool verifyChecksum, Compare const &compare) {
+    MappedTree tree(compare);
+    auto descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+    }
+    struct stat status = {};
+    if (::fstat(descriptor, &status) != 0) {
+        auto error = errno;
+        ::close(descriptor);
+        throw std::system_error(error, std::generic_category(), "Cannot stat " + path);
+    }
+    if ((std::uint64_t) status.st_size < MAPPED_TREE_ALIGNMENT) {
+        ::close(descriptor);
+        throw std::runtime_error("Snapshot too short: " + path);
+    }
+
+    tree.mappingSize = (size_t) status.st_size;
+    auto mapping = ::mmap(nullptr, tree.mappingSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    auto error = errno;
+    // The mapping stays valid after closing the descriptor
+    ::close(descriptor);
+    if (mapping == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "Cannot map " + path);
+    }
+    tree.mapping = mapping;
+
+    // From here on the view owns the mapping and releases it when a check throws
+    MappedTreeHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    auto invalid = [&path](char const *reason) {
+        return std::runtime_error(std::string("Invalid snapshot ") + path + ": " + reason);
+    };
+    if (std::memcmp(header.magic, MAPPED_TREE_MAGIC, sizeof(header.magic)) != 0) {
+        throw invalid("not a snapshot file");
+    }
+    if (header.version != MAPPED_TREE_VERSION) {
+        throw invalid("unsupported version");
+    }
+    if (header.byteOrder != MAPPED_TREE_BYTE_ORDER) {
+        throw invalid("written on a host of different byte order");
+    }
+    if (header.keySize != sizeof(KeyType) || header.valueSize != sizeof(ValueType)) {
+        throw invalid("key or value type differs");
+    }
+    if (header.fileSize != tree.mappingSize) {
+        throw invalid("truncated");
+    }
+    // Dividing instead of multiplying keeps huge counts from overflowing
+    auto keysCapacity = (header.fileSize - header.keysOffset) / sizeof(KeyType);
+    if (header.keysOffset != MAPPED_TREE_ALIGNMENT || header.count > keysCapacity ||
+        header.valuesOffset != alignMappedOffset(header.keysOffset + header.count * sizeof(KeyType),
+                                                 MAPPED_TREE_ALIGNMENT) ||
+        header.valuesOffset > header.fileSize ||
+        header.count > (header.fileSize - header.valuesOffset) / sizeof(ValueType)) {
+        throw invalid("inconsistent layout");
+    }
+    if (verifyChecksum) {
+        MappedTreeChecksum checksum;
+        checksum.update(static_cast<char const *>(mapping) + MAPPED_TREE_ALIGNMENT,
+                        (size_t) (header.fileSize - MAPPED_TREE_ALIGNMENT) / 8);
+        if (checksum.value() != header.checksum) {
+            throw invalid("checksum mismatch");
+        }
+    }
+
+    tree.count = (size_t) header.count;
+    tree.keys = reinterpret_cast<KeyType const *>(static_cast<char const *>(mapping) + header.keysOffset);
+    tree.values = reinterpret_cast<ValueType const *>(static_cast<char const *>(mapping) + header.valuesOffset);
+    return tree;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+void MappedTree<KeyType, ValueType, Compare>::release() {
+    if (mapping != nullptr) {
+        ::munmap(mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    keys = nullptr;
+    values = nullptr;
+    count = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+MappedTree<KeyType, ValueType, Compare>::~MappedTree() {
+    release();
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+MappedTree<KeyType, ValueType, Compare>::MappedTree(MappedTree &&other) noexcept
+        : mapping(other.mapping), mappingSize(other.mappingSize), keys(other.keys), values(other.values),
+          count(other.count), compare(other.compare) {
+    other.mapping = nullptr;
+    other.release();
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+MappedTree<KeyType, ValueType, Compare> &
+MappedTree<KeyType, ValueType, Compare>::operator=(MappedTree &&other) noexcept {
+    if (this != &other) {
+        release();
+        mapping = other.mapping;
+        mappingSize = other.mappingSize;
+        keys = other.keys;
+        values = other.values;
+        count = other.count;
+        compare = other.compare;
+        other.mapping = nullptr;
+        other.release();
+    }
+    return *this;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t MappedTree<KeyType, ValueType, Compare>::size() const {
+    return count;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+size_t MappedTree<KeyType, ValueType, Compare>::lowerBoundIndex(KeyType const &key) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    auto base = keys;
+    auto length = count;
+    while (length > 1) {
+        auto half = length / 2;
+        prefetchRead(base + half / 2);
+        prefetchRead(base + half + half / 2);
+        base += (compare(base[half], key) < 0) ? half : 0;
+        length -= half;
+    }
+    return (size_t) (base - keys) + (compare(*base, key) < 0);
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+ValueType const *MappedTree<KeyType, ValueType, Compare>::find(KeyType const &key) const {
+    auto index = lowerBoundIndex(key);
+    if (index == count || compare(key, keys[index]) != 0) {
+        return nullptr;
+    }
+    return values + index;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+bool MappedTree<KeyType, ValueType, Compare>::contains(KeyType const &key) const {
+    return find(key) != nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename Visitor>
+void MappedTree<KeyType, ValueType, Compare>::forEach(Visitor &&visitor) const {
+    for (size_t idx = 0; idx < count; ++idx) {
+        visitor(keys[idx], values[idx]);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Compare>
+template<typename Visitor>
+void MappedTree<KeyType, ValueType, Compare>::forEachInRange(KeyType const &lo, KeyType const &hi,
+                                                             Visitor &&visitor) const {
+    for (auto idx = lowerBoundIndex(lo); idx < count && compare(keys[idx], hi) <= 0; ++idx) {
+        visitor(keys[idx], values[idx]);
+    }
+}
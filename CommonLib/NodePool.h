@@ -0,0 +1,392 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/**
+ * Allocate raw memory aligned for objects of type T
+ *
+ * Before C++17 operator new guarantees only fundamental alignment, memory for over-aligned types
+ * (like cache line aligned B-tree nodes) comes from posix_memalign instead
+ *
+ * @tparam T type of objects placed in the memory
+ * @param bytes size of the memory
+ * @return pointer to the memory, freed by releaseAligned<T>
+ * @throws std::bad_alloc if the memory cannot be allocated
+ */
+template<typename T>
+void *allocateAligned(size_t bytes) {
+    if (alignof(T) <= alignof(std::max_align_t)) {
+        return ::operator new(bytes);
+    }
+    void *memory = nullptr;
+    if (posix_memalign(&memory, alignof(T), bytes) != 0) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/**
+ * Free memory allocated by allocateAligned<T>
+ *
+ * @tparam T type the memory was allocated for
+ * @param memory freed memory
+ */
+template<typename T>
+void releaseAligned(void *memory) {
+    if (alignof(T) <= alignof(std::max_align_t)) {
+        ::operator delete(memory);
+    } else {
+        std::free(memory);
+    }
+}
+
+/**
+ * Node allocator using the global heap - every node is a separate new/delete
+ *
+ * Allocators are pluggable into the trees through a template template parameter and have to be movable and provide
+ * create, destroy, reserve, releaseAll, adopt, RELEASES_IN_BULK and TRANSFERS_NODES
+ *
+ * @tparam T type of allocated nodes
+ */
+template<typename T>
+class HeapAllocator {
+public:
+    /**
+     * Whether releaseAll frees memory of all nodes, so that trivially destructible nodes
+     * do not have to be destroyed one by one
+     */
+    static constexpr bool RELEASES_IN_BULK = false;
+
+    /**
+     * Whether a single node may be handed over to another allocator of the same type and destroyed by it,
+     * so that trees can relink nodes into each other instead of copying them
+     */
+    static constexpr bool TRANSFERS_NODES = true;
+
+    /**
+     * Allocate and construct a node
+     *
+     * @param args arguments forwarded to the node's constructor
+     * @return pointer to the constructed node
+     */
+    template<typename... Args>
+    T *create(Args &&... args) {
+        auto memory = allocateAligned<T>(sizeof(T));
+        try {
+            return new(memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            releaseAligned<T>(memory);
+            throw;
+        }
+    }
+
+    /**
+     * Destroy and free a node
+     *
+     * @param node node created by this allocator
+     */
+    void destroy(T *node) {
+        node->~T();
+        releaseAligned<T>(node);
+    }
+
+    /**
+     * No-op, nodes are allocated one by one
+     */
+    void reserve(size_t) {}
+
+    /**
+     * No-op, every node is freed individually by destroy
+     */
+    void releaseAll() {}
+
+    /**
+     * No-op, nodes of all heap allocators come from the same heap
+     */
+    void adopt(HeapAllocator &&) {}
+};
+
+
+/**
+ * Node allocator carving nodes out of fixed-size slabs
+ *
+ * Freed nodes are kept on a free list and reused by subsequent allocations. Slabs honour the alignment of T,
+ * extended alignments included.
+ * Movable, moving a pool moves ownership of all its nodes.
+ * All slabs are released at once by releaseAll or when the pool is destroyed - destructors of nodes still
+ * alive at that point are not called, owner is responsible for destroying non-trivially destructible nodes first.
+ *
+ * @tparam T type of allocated nodes
+ */
+template<typename T>
+class NodePool {
+private:
+
+    /**
+     * Storage for a single node, doubles as a free list entry when unused
+     */
+    union Slot {
+        Slot *nextFree;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    /**
+     * Size of a single slab in bytes
+     */
+    static const size_t SLAB_BYTES = 64 * 1024;
+
+    /**
+     * Number of nodes carved out of a single slab
+     */
+    static const size_t SLOTS_PER_SLAB = (SLAB_BYTES / sizeof(Slot) > 0) ? SLAB_BYTES / sizeof(Slot) : 1;
+
+    /**
+     * Allocated slabs, each of at least SLOTS_PER_SLAB slots
+     */
+    std::vector<Slot *> slabs;
+
+    /**
+     * Head of the list of freed slots
+     */
+    Slot *freeList;
+
+    /**
+     * Next never used slot in the most recent slab
+     */
+    Slot *slabCursor;
+
+    /**
+     * End of the most recent slab
+     */
+    Slot *slabEnd;
+
+    /**
+     * Get storage for a single node
+     *
+     * Remaining slots of the current slab are used first, so that reserved batches stay contiguous,
+     * freed slots are reused before another slab is allocated
+     *
+     * @return uninitialized slot
+     */
+    Slot *acquireSlot();
+
+    /**
+     * Allocate a slab and make it the current one
+     *
+     * The slab list grows geometrically, growing it by one entry per slab would leave a trail of freed,
+     * already touched list buffers between the slabs
+     *
+     * @param slotCount number of slots in the slab
+     */
+    void addSlab(size_t slotCount);
+
+public:
+    static constexpr bool RELEASES_IN_BULK = true;
+
+    /**
+     * Nodes live in slabs owned by their pool and can be handed over only all at once by adopt
+     */
+    static constexpr bool TRANSFERS_NODES = false;
+
+    /**
+     * Initialize empty pool, no slab is allocated until the first node is created
+     */
+    NodePool();
+
+    NodePool(NodePool const &) = delete;
+
+    NodePool &operator=(NodePool const &) = delete;
+
+    /**
+     * Take over all slabs of another pool, leaving it empty
+     */
+    NodePool(NodePool &&other) noexcept;
+
+    /**
+     * Release own slabs and take over all slabs of another pool, leaving it empty
+     */
+    NodePool &operator=(NodePool &&other) noexcept;
+
+    /**
+     * Release all slabs
+     */
+    ~NodePool();
+
+    /**
+     * Allocate and construct a node
+     *
+     * @param args arguments forwarded to the node's constructor
+     * @return pointer to the constructed node
+     */
+    template<typename... Args>
+    T *create(Args &&... args);
+
+    /**
+     * Destroy a node and put its slot on the free list
+     *
+     * @param node node created by this pool
+     */
+    void destroy(T *node);
+
+    /**
+     * Make sure the next count nodes can be created without allocating another slab
+     *
+     * Missing capacity is allocated as a single slab, so a batch of nodes ends up contiguous
+     *
+     * @param count number of nodes about to be created
+     */
+    void reserve(size_t count);
+
+    /**
+     * Free all slabs at once without calling destructors of the nodes
+     */
+    void releaseAll();
+
+    /**
+     * Take over all nodes of another pool, leaving it empty
+     *
+     * Nodes created by different pools, for example on different threads, can then be destroyed by this one
+     *
+     * @param other pool whose slabs are appended to this pool's slabs
+     */
+    void adopt(NodePool &&other);
+};
+
+template<typename T>
+NodePool<T>::NodePool() {
+    freeList = nullptr;
+    slabCursor = nullptr;
+    slabEnd = nullptr;
+}
+
+template<typename T>
+NodePool<T>::NodePool(NodePool &&other) noexcept
+        : slabs(std::move(other.slabs)) {
+    freeList = other.freeList;
+    slabCursor = other.slabCursor;
+    slabEnd = other.slabEnd;
+    other.slabs.clear();
+    other.freeList = nullptr;
+    other.slabCursor = nullptr;
+    other.slabEnd = nullptr;
+}
+
+template<typename T>
+NodePool<T> &NodePool<T>::operator=(NodePool &&other) noexcept {
+    if (this != &other) {
+        releaseAll();
+        std::swap(slabs, other.slabs);
+        std::swap(freeList, other.freeList);
+        std::swap(slabCursor, other.slabCursor);
+        std::swap(slabEnd, other.slabEnd);
+    }
+    return *this;
+}
+
+template<typename T>
+NodePool<T>::~NodePool() {
+    releaseAll();
+}
+
+template<typename T>
+void NodePool<T>::reserve(size_t count) {
+    if ((size_t) (slabEnd - slabCursor) >= count) {
+        return;
+    }
+
+    // Unused tail of the current slab stays available through the free list
+    for (; slabCursor != slabEnd; ++slabCursor) {
+        slabCursor->nextFree = freeList;
+        freeList = slabCursor;
+    }
+
+    addSlab((count > SLOTS_PER_SLAB) ? count : SLOTS_PER_SLAB);
+}
+
+template<typename T>
+void NodePool<T>::addSlab(size_t slotCount) {
+    // Reserve first, so that push_back cannot throw and leak the slab
+    if (slabs.size() == slabs.capacity()) {
+        slabs.reserve(2 * slabs.size() + 1);
+    }
+    slabCursor = static_cast<Slot *>(allocateAligned<Slot>(slotCount * sizeof(Slot)));
+    slabEnd = slabCursor + slotCount;
+    slabs.push_back(slabCursor);
+}
+
+template<typename T>
+typename NodePool<T>::Slot *NodePool<T>::acquireSlot() {
+    if (freeList != nullptr && slabCursor == slabEnd) {
+        auto slot = freeList;
+        freeList = slot->nextFree;
+        return slot;
+    }
+
+    if (slabCursor == slabEnd) {
+        addSlab(SLOTS_PER_SLAB);
+    }
+
+    return slabCursor++;
+}
+
+template<typename T>
+template<typename... Args>
+T *NodePool<T>::create(Args &&... args) {
+    auto slot = acquireSlot();
+    try {
+        return new(&slot->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+        slot->nextFree = freeList;
+        freeList = slot;
+        throw;
+    }
+}
+
+template<typename T>
+void NodePool<T>::destroy(T *node) {
+    node->~T();
+    auto slot = reinterpret_cast<Slot *>(node);
+    slot->nextFree = freeList;
+    freeList = slot;
+}
+
+template<typename T>
+void NodePool<T>::releaseAll() {
+    for (auto slab : slabs) {
+        releaseAligned<Slot>(slab);
+    }
+    slabs.clear();
+    freeList = nullptr;
+    slabCursor = nullptr;
+    slabEnd = nullptr;
+}
+
+template<typename T>
+void NodePool<T>::adopt(NodePool &&other) {
+    if (this == &other) {
+        return;
+    }
+
+    slabs.insert(slabs.end(), other.slabs.begin(), other.slabs.end());
+    // Unused tail of the other pool's slab and its free slots are reused through this pool's free list
+    for (; other.slabCursor != other.slabEnd; ++other.slabCursor) {
+        other.slabCursor->nextFree = freeList;
+        freeList = other.slabCursor;
+    }
+    while (other.freeList != nullptr) {
+        auto slot = other.freeList;
+        other.freeList = slot->nextFree;
+        slot->nextFree = freeList;
+        freeList = slot;
+    }
+
+    other.slabs.clear();
+    other.slabCursor = nullptr;
+    other.slabEnd = nullptr;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+
+/**
+ * Value type of trees used as sets, keys are stored without any associated value
+ */
+struct NoValue {
+    NoValue() = default;
+
+    /**
+     * Accept and ignore any constructor arguments, so that map style insertion still compiles
+     */
+    template<typename... Args>
+    explicit NoValue(Args &&...) {}
+
+    bool operator==(NoValue const &) const {
+        return true;
+    }
+
+    bool operator!=(NoValue const &) const {
+        return false;
+    }
+};
+
+/**
+ * Sets print only their keys, the value part of a node stays empty
+ */
+inline std::ostream &operator<<(std::ostream &stream, NoValue const &) {
+    return stream;
+}
+
+/**
+ * Base of tree nodes holding the node's value
+ *
+ * @tparam ValueType type of the value
+ * @tparam IsNoValue whether ValueType is NoValue, selects the storage-free specialization
+ */
+template<typename ValueType, bool IsNoValue = std::is_same<ValueType, NoValue>::value>
+struct NodeValue {
+    ValueType value;
+
+    /**
+     * Construct the value in place
+     *
+     * @param valueArgs arguments for constructing the value
+     */
+    template<typename... Args>
+    explicit NodeValue(Args &&... valueArgs) : value(std::forward<Args>(valueArgs)...) {}
+};
+
+/**
+ * Nodes of sets occupy no bytes for their value
+ *
+ * The empty base is optimized away and every node refers to one shared NoValue instead. NoValue has no state,
+ * so reading or assigning it touches no memory and needs no synchronization.
+ */
+template<typename ValueType>
+struct NodeValue<ValueType, true> {
+    static ValueType value;
+
+    template<typename... Args>
+    explicit NodeValue(Args &&...) {}
+};
+
+template<typename ValueType>
+ValueType NodeValue<ValueType, true>::value;
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Run tasks concurrently, each on its own thread, the first one on the calling thread
+ *
+ * Returns after all tasks finished, the first exception thrown by a task is rethrown afterwards. If a thread
+ * cannot be started, the tasks left without a thread run on the calling thread.
+ *
+ * @param tasks independent tasks
+ */
+inline void runConcurrently(std::vector<std::function<void()>> const &tasks) {
+    std::vector<std::exception_ptr> errors(tasks.size());
+    auto run = [&tasks, &errors](size_t idx) {
+        try {
+            tasks[idx]();
+        } catch (...) {
+            errors[idx] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    size_t firstInline = 1;
+    try {
+        for (; firstInline < tasks.size(); ++firstInline) {
+            threads.emplace_back(run, firstInline);
+        }
+    } catch (...) {
+        // Threads already started must still be joined, the rest of the tasks runs below
+    }
+    if (!tasks.empty()) {
+        run(0);
+    }
+    for (auto idx = firstInline; idx < tasks.size(); ++idx) {
+        run(idx);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (auto const &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * Smallest partition worth sorting on a separate thread
+ */
+const size_t PARALLEL_SORT_GRAIN = 16384;
+
+/**
+ * Stable sort using up to threadCount threads
+ *
+ * The range is split into equal partitions sorted concurrently, neighbouring partitions are then merged
+ * pairwise in rounds, merges of one round run concurrently. Merging is stable, so elements with equal keys
+ * keep their input order like with std::stable_sort.
+ *
+ * @tparam RandomAccessIterator iterator of the sorted range
+ * @tparam Less strict weak ordering of the elements
+ * @param first beginning of the range
+ * @param last end of the range
+ * @param threadCount maximal number of threads
+ * @param less ordering of the elements
+ */
+template<typename RandomAccessIterator, typename Less>
+void parallelStableSort(RandomAccessIterator first, RandomAccessIterator last, size_t threadCount, Less less) {
+    auto count = (size_t) std::distance(first, last);
+    auto partitions = std::min(threadCount, count / PARALLEL_SORT_GRAIN);
+    if (partitions <= 1) {
+        std::stable_sort(first, last, less);
+        return;
+    }
+
+    std::vector<RandomAccessIterator> bounds;
+    for (size_t partition = 0; partition <= partitions; ++partition) {
+        bounds.push_back(first + count * partition / partitions);
+    }
+
+    std::vector<std::function<void()>> sorts;
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        auto begin = bounds[partition];
+        auto end = bounds[partition + 1];
+        sorts.push_back([begin, end, &less]() {
+            std::stable_sort(begin, end, less);
+        });
+    }
+    runConcurrently(sorts);
+
+    // Every round merges pairs of sorted runs and halves their number
+    for (size_t width = 1; width < partitions; width *= 2) {
+        std::vector<std::function<void()>> merges;
+        for (size_t left = 0; left + width < partitions; left += 2 * width) {
+            auto begin = bounds[left];
+            auto middle = bounds[left + width];
+            auto end = bounds[std::min(left + 2 * width, partitions)];
+            merges.push_back([begin, middle, end, &less]() {
+                std::inplace_merge(begin, middle, end, less);
+            });
+        }
+        runConcurrently(merges);
+    }
+}
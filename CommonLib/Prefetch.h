@@ -0,0 +1,17 @@
+#pragma once
+
+
+/**
+ * Hint the CPU to start loading memory that will be read soon, no-op on compilers without the builtin
+ *
+ * Never faults, so it may be given addresses past the end of an array or nullptr
+ *
+ * @param address address about to be read
+ */
+inline void prefetchRead(void const *address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address, 0, 3);
+#else
+    (void) address;
+#endif
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+/**
+ * In-order neighbours of nodes linked with parent pointers
+ *
+ * Nodes have to provide leftChild, rightChild and parent members
+ */
+template<typename Node>
+struct InOrder {
+    /**
+     * Get the node with the smallest key of a subtree
+     *
+     * @param subRoot root node of the subtree, may be nullptr
+     * @return leftmost node or nullptr for an empty subtree
+     */
+    static Node *first(Node *subRoot) {
+        if (subRoot != nullptr) {
+            while (subRoot->leftChild != nullptr) {
+                subRoot = subRoot->leftChild;
+            }
+        }
+        return subRoot;
+    }
+
+    /**
+     * Get the node with the largest key of a subtree
+     *
+     * @param subRoot root node of the subtree, may be nullptr
+     * @return rightmost node or nullptr for an empty subtree
+     */
+    static Node *last(Node *subRoot) {
+        if (subRoot != nullptr) {
+            while (subRoot->rightChild != nullptr) {
+                subRoot = subRoot->rightChild;
+            }
+        }
+        return subRoot;
+    }
+
+    /**
+     * Get the node with the next larger key, amortized O(1) over a full scan
+     *
+     * @param node current node
+     * @return successor or nullptr if node holds the largest key
+     */
+    static Node *next(Node *node) {
+        if (node->rightChild != nullptr) {
+            return first(node->rightChild);
+        }
+        while (node->parent != nullptr && node == node->parent->rightChild) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    /**
+     * Get the node with the next smaller key, amortized O(1) over a full scan
+     *
+     * @param node current node
+     * @return predecessor or nullptr if node holds the smallest key
+     */
+    static Node *previous(Node *node) {
+        if (node->leftChild != nullptr) {
+            return last(node->leftChild);
+        }
+        while (node->parent != nullptr && node == node->parent->leftChild) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+};
+
+
+/**
+ * Bidirectional in-order iterator over a tree with parent pointers
+ *
+ * Dereferencing yields a pair of references (key, value), the key is never mutable.
+ * An iterator stays valid until the element it points to is removed, rotations do not move elements between nodes.
+ * End iterator can be decremented to the largest element, it reads the root through a pointer to the tree's root link.
+ *
+ * @tparam Node tree's node type with key, value, leftChild, rightChild and parent members
+ * @tparam KeyType type of the keys
+ * @tparam ValueType type of the values
+ * @tparam IsConst whether the values are read-only
+ */
+template<typename Node, typename KeyType, typename ValueType, bool IsConst>
+class TreeIterator {
+public:
+    using MappedType = typename std::conditional<IsConst, ValueType const, ValueType>::type;
+
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::pair<KeyType, ValueType>;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<KeyType const &, MappedType &>;
+
+    /**
+     * Holder of a dereferenced pair, so that it->first and it->second work
+     */
+    struct ArrowProxy {
+        reference entry;
+
+        reference const *operator->() const {
+            return &entry;
+        }
+    };
+
+    using pointer = ArrowProxy;
+
+private:
+    template<typename, typename, typename, bool>
+    friend class TreeIterator;
+
+    Node *node;
+
+    Node *const *root;
+
+public:
+
+    /**
+     * Initialize singular iterator, usable only as an assignment target
+     */
+    TreeIterator() : node(nullptr), root(nullptr) {}
+
+    /**
+     * Initialize iterator pointing to given node
+     *
+     * @param node pointed node, nullptr for the end iterator
+     * @param root link to the tree's root node
+     */
+    TreeIterator(Node *node, Node *const *root) : node(node), root(root) {}
+
+    /**
+     * Convert mutable iterator to a read-only one
+     */
+    template<bool OtherConst, typename = typename std::enable_if<IsConst && !OtherConst>::type>
+    TreeIterator(TreeIterator<Node, KeyType, ValueType, OtherConst> const &other)
+            : node(other.node), root(other.root) {}
+
+    KeyType const &key() const {
+        return node->key;
+    }
+
+    MappedType &value() const {
+        return node->value;
+    }
+
+    reference operator*() const {
+        return reference(node->key, node->value);
+    }
+
+    pointer operator->() const {
+        return ArrowProxy{**this};
+    }
+
+    TreeIterator &operator++() {
+        node = InOrder<Node>::next(node);
+        return *this;
+    }
+
+    TreeIterator operator++(int) {
+        auto previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    TreeIterator &operator--() {
+        node = (node == nullptr) ? InOrder<Node>::last(*root) : InOrder<Node>::previous(node);
+        return *this;
+    }
+
+    TreeIterator operator--(int) {
+        auto previous = *this;
+        --*this;
+        return previous;
+    }
+
+    bool operator==(TreeIterator const &other) const {
+        return node == other.node;
+    }
+
+    bool operator!=(TreeIterator const &other) const {
+        return node != other.node;
+    }
+};
+
+
+/**
+ * Stateful position in a tree with parent pointers
+ *
+ * Seek descends from the root once, subsequent steps in either direction follow child and parent pointers only.
+ * Cursor stays valid under the same conditions as TreeIterator.
+ *
+ * @tparam Node tree's node type with key, value, leftChild, rightChild and parent members
+ * @tparam KeyType type of the keys
+ * @tparam ValueType type of the values
+ * @tparam Compare three-way comparator of the keys
+ */
+template<typename Node, typename KeyType, typename ValueType, typename Compare>
+class TreeCursor {
+private:
+    Node *node;
+
+    Node *const *root;
+
+    Compare const *compare;
+
+public:
+
+    /**
+     * Initialize cursor positioned at the smallest key of a tree
+     *
+     * @param root link to the tree's root node
+     * @param compare tree's comparator
+     */
+    TreeCursor(Node *const *root, Compare const *compare)
+            : node(InOrder<Node>::first(*root)), root(root), compare(compare) {}
+
+    /**
+     * Move to the smallest key not less than given key
+     *
+     * @param key searched key
+     * @return whether the key is present, cursor becomes invalid if all keys are less than it
+     */
+    bool seek(KeyType const &key) {
+        node = nullptr;
+        for (auto current = *root; current != nullptr;) {
+            auto order = (*compare)(key, current->key);
+            if (order == 0) {
+                node = current;
+                return true;
+            }
+            if (order < 0) {
+                node = current;
+                current = current->leftChild;
+            } else {
+                current = current->rightChild;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Move to the smallest key
+     *
+     * @return whether the tree is not empty
+     */
+    bool seekFirst() {
+        node = InOrder<Node>::first(*root);
+        return valid();
+    }
+
+    /**
+     * Move to the largest key
+     *
+     * @return whether the tree is not empty
+     */
+    bool seekLast() {
+        node = InOrder<Node>::last(*root);
+        return valid();
+    }
+
+    /**
+     * Step to the next larger key, invalid cursor stays invalid
+     *
+     * @return whether the cursor points to a key after the step
+     */
+    bool next() {
+        if (node != nullptr) {
+            node = InOrder<Node>::next(node);
+        }
+        return valid();
+    }
+
+    /**
+     * Step to the next smaller key, invalid cursor stays invalid
+     *
+     * @return whether the cursor points to a key after the step
+     */
+    bool previous() {
+        if (node != nullptr) {
+            node = InOrder<Node>::previous(node);
+        }
+        return valid();
+    }
+
+    /**
+     * @return whether the cursor points to a key
+     */
+    bool valid() const {
+        return node != nullptr;
+    }
+
+    /**
+     * @return key at the cursor, cursor has to be valid
+     */
+    KeyType const &key() const {
+        return node->key;
+    }
+
+    /**
+     * @return value at the cursor, cursor has to be valid
+     */
+    ValueType &value() const {
+        return node->value;
+    }
+
+    /**
+     * @return iterator pointing to the same element, end iterator for an invalid cursor
+     */
+    TreeIterator<Node, KeyType, ValueType, false> position() const {
+        return TreeIterator<Node, KeyType, ValueType, false>(node, root);
+    }
+};
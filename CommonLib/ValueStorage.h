@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "NodeValue.h"
+
+
+/**
+ * Value storage policy keeping every value inside its node, next to the key
+ *
+ * Suits small values, a hit needs no further memory access
+ *
+ * @tparam ValueType type of the values
+ */
+template<typename ValueType>
+class InlineValues {
+public:
+    /**
+     * Base of the tree's nodes, holds the value
+     */
+    using NodePart = NodeValue<ValueType>;
+
+    /**
+     * Get value of a node
+     *
+     * @tparam Node node type deriving from NodePart
+     * @param node node holding the value
+     * @return reference to the value
+     */
+    template<typename Node>
+    ValueType &at(Node &node, size_t) {
+        return node.value;
+    }
+
+    template<typename Node>
+    ValueType const &at(Node const &node, size_t) const {
+        return node.value;
+    }
+
+    /**
+     * Values are constructed together with their nodes, nothing is stored separately
+     */
+    void store(size_t, ValueType const &) {}
+
+    void reserve(size_t) {}
+
+    void clear() {}
+
+    /**
+     * Get memory taken outside of the nodes
+     *
+     * @return number of bytes
+     */
+    size_t memoryUsage() const {
+        return 0;
+    }
+};
+
+/**
+ * Value storage policy keeping values out of the nodes, in a contiguous arena indexed like the nodes
+ *
+ * Nodes hold only keys and links, so a descent reads hot key and link memory only and large values
+ * do not push neighbouring nodes out of cache. The value is read from the arena after the final hit,
+ * at the cost of one more cache miss.
+ *
+ * @tparam ValueType type of the values, copy assignable
+ */
+template<typename ValueType>
+class ColdValues {
+private:
+    std::vector<ValueType> values;
+
+public:
+    /**
+     * Nodes store no value
+     */
+    using NodePart = NodeValue<NoValue>;
+
+    /**
+     * Get value of a node
+     *
+     * @param index index of the node
+     * @return reference to the value
+     */
+    template<typename Node>
+    ValueType &at(Node &, size_t index) {
+        return values[index];
+    }
+
+    template<typename Node>
+    ValueType const &at(Node const &, size_t index) const {
+        return values[index];
+    }
+
+    /**
+     * Store value of a newly allocated node, growing the arena if the node is new
+     *
+     * @param index index of the node, at most the number of nodes allocated so far
+     * @param value stored value
+     */
+    void store(size_t index, ValueType const &value) {
+        if (index == values.size()) {
+            values.push_back(value);
+        } else {
+            values[index] = value;
+        }
+    }
+
+    void reserve(size_t count) {
+        values.reserve(count);
+    }
+
+    void clear() {
+        std::vector<ValueType>().swap(values);
+    }
+
+    /**
+     * Get memory taken by the arena, including unused capacity
+     *
+     * @return number of bytes
+     */
+    size_t memoryUsage() const {
+        return values.capacity() * sizeof(ValueType);
+    }
+};
@@ -1,5 +1,13 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
 #include "../AVLTreeLib/AVLTree.h"
+#include "../AVLTreeLib/AVLTreeSet.h"
 
 
 namespace AVLTreeUnitTest {
@@ -487,4 +495,1070 @@ namespace AVLTreeUnitTest {
 
         ASSERT_EQ(7, tree.size());
     }
+
+    TEST(AVLTree, sizeAfterRotationsAndReplace) {
+        AVLTree<int, int> tree;
+        for (int i = 1; i <= 100; ++i) {
+            tree.insert(i, i);
+        }
+        tree.insert(50, 500);
+        ASSERT_EQ(100, tree.size());
+    }
+
+    TEST(AVLTree, rank) {
+        AVLTree<int, int> tree;
+        for (int i = 10; i <= 100; i += 10) {
+            tree.insert(i, i);
+        }
+        ASSERT_EQ(0, tree.rank(5));
+        ASSERT_EQ(0, tree.rank(10));
+        ASSERT_EQ(4, tree.rank(50));
+        ASSERT_EQ(5, tree.rank(55));
+        ASSERT_EQ(10, tree.rank(1000));
+    }
+
+    TEST(AVLTree, select) {
+        AVLTree<int, int> tree;
+        for (int i = 100; i >= 10; i -= 10) {
+            tree.insert(i, i);
+        }
+        for (size_t k = 0; k < 10; ++k) {
+            ASSERT_EQ(10 * (int) (k + 1), *tree.select(k));
+        }
+        ASSERT_EQ(nullptr, tree.select(10));
+    }
+
+    TEST(AVLTree, countInRange) {
+        AVLTree<int, int> tree;
+        for (int i = 10; i <= 100; i += 10) {
+            tree.insert(i, i);
+        }
+        ASSERT_EQ(3, tree.countInRange(20, 40));
+        ASSERT_EQ(2, tree.countInRange(25, 45));
+        ASSERT_EQ(10, tree.countInRange(0, 1000));
+        ASSERT_EQ(0, tree.countInRange(41, 49));
+        ASSERT_EQ(0, tree.countInRange(40, 20));
+    }
+
+    TEST(AVLTree, heapAllocator) {
+        AVLTree<int, int, ThreeWayCompare<int>, HeapAllocator> tree;
+        tree.insert(10, 10);
+        tree.insert(20, 20);
+        tree.insert(30, 30);
+        std::string expected = "([20,20],([10,10],,),([30,30],,))";
+        ASSERT_EQ(expected, tree.toString());
+    }
+
+    TEST(AVLTree, clear) {
+        AVLTree<int, std::string> tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(i, std::to_string(i));
+        }
+        tree.clear();
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ("", tree.toString());
+        tree.insert(1, "one");
+        ASSERT_EQ("one", *tree.find(1));
+    }
+
+    TEST(AVLTree, removeFromEmpty) {
+        AVLTree<int, int> tree;
+        tree.remove(10);
+        ASSERT_EQ("", tree.toString());
+    }
+
+    TEST(AVLTree, removeRoot) {
+        AVLTree<int, int> tree;
+        tree.insert(10, 10);
+        tree.remove(10);
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(AVLTree, removeNotExisting) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.remove(25);
+        std::string expected = "([20,20],([10,10],,),([30,30],,))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(3, tree.size());
+    }
+
+    TEST(AVLTree, rightRotationAfterRemove) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.insert(5, 5);
+        tree.remove(30);
+        std::string expected = "([10,10],([5,5],,),([20,20],,))";
+        ASSERT_EQ(expected, tree.toString());
+    }
+
+    TEST(AVLTree, rightRotationBalancedChildAfterRemove) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.insert(5, 5);
+        tree.insert(15, 15);
+        tree.remove(30);
+        std::string expected = "([10,10],([5,5],,),([20,20],([15,15],,),))";
+        ASSERT_EQ(expected, tree.toString());
+    }
+
+    TEST(AVLTree, leftRightRotationAfterRemove) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.insert(15, 15);
+        tree.remove(30);
+        std::string expected = "([15,15],([10,10],,),([20,20],,))";
+        ASSERT_EQ(expected, tree.toString());
+    }
+
+    TEST(AVLTree, removeNodeWithChildren) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.insert(25, 25);
+        tree.insert(40, 40);
+        tree.remove(20);
+        std::string expected = "([25,25],([10,10],,),([30,30],,([40,40],,)))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(4, tree.size());
+    }
+
+    TEST(AVLTree, randomInsertRemoveMatchesMap) {
+        AVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(42);
+        for (int i = 0; i < 20000; ++i) {
+            int key = (int) (generator() % 2000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        size_t position = 0;
+        for (auto const &entry : reference) {
+            ASSERT_EQ(entry.second, *tree.find(entry.first));
+            ASSERT_EQ(entry.first, *tree.select(position));
+            ASSERT_EQ(position, tree.rank(entry.first));
+            ++position;
+        }
+    }
+
+    TEST(AVLTree, insertStatisticsRotation) {
+        AVLTree<int, int> tree;
+        tree.insert(10, 10);
+        tree.insert(20, 20);
+        tree.resetInsertStatistics();
+        tree.insert(30, 30);
+        auto statistics = tree.getInsertStatistics();
+        ASSERT_EQ(1, statistics.insertions);
+        ASSERT_EQ(1, statistics.rotations);
+        ASSERT_EQ(2, statistics.touchedNodes);
+    }
+
+    TEST(AVLTree, insertStatisticsStopWhenHeightUnchanged) {
+        AVLTree<int, int> tree;
+        tree.insert(20, 20);
+        tree.insert(10, 10);
+        tree.insert(30, 30);
+        tree.insert(5, 5);
+        tree.resetInsertStatistics();
+        tree.insert(25, 25);
+        auto statistics = tree.getInsertStatistics();
+        ASSERT_EQ(0, statistics.rotations);
+        ASSERT_EQ(2, statistics.touchedNodes);
+
+        tree.insert(1, 1);
+        statistics = tree.getInsertStatistics();
+        ASSERT_EQ(2, statistics.insertions);
+        ASSERT_EQ(1, statistics.rotations);
+        ASSERT_EQ(4, statistics.touchedNodes);
+        std::string expected = "([20,20],([5,5],([1,1],,),([10,10],,)),([30,30],([25,25],,),))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(6, tree.size());
+    }
+
+    TEST(AVLTree, insertStatisticsDoubleRotation) {
+        AVLTree<int, int> tree;
+        tree.insert(30, 30);
+        tree.insert(10, 10);
+        tree.resetInsertStatistics();
+        tree.insert(20, 20);
+        ASSERT_EQ(2, tree.getInsertStatistics().rotations);
+    }
+
+    TEST(AVLTree, buildFromSorted) {
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 1; i <= 7; ++i) {
+            pairs.emplace_back(i, 10 * i);
+        }
+        AVLTree<int, int> tree;
+        tree.insert(100, 100);
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        std::string expected = "([4,40],([2,20],([1,10],,),([3,30],,)),([6,60],([5,50],,),([7,70],,)))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(7, tree.size());
+        ASSERT_EQ(nullptr, tree.find(100));
+    }
+
+    TEST(AVLTree, buildFromSortedEmpty) {
+        std::vector<std::pair<int, int>> pairs;
+        AVLTree<int, int> tree;
+        tree.insert(1, 1);
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(AVLTree, bulkLoadDeduplicatesLastWriteWins) {
+        std::vector<std::pair<int, int>> pairs = {{5, 1}, {3, 1}, {5, 2}, {1, 1}, {3, 2}, {5, 3}, {4, 1}};
+        AVLTree<int, int> tree;
+        tree.bulkLoad(pairs.begin(), pairs.end());
+        std::string expected = "([3,2],([1,1],,),([4,1],,([5,3],,)))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(4, tree.size());
+    }
+
+    TEST(AVLTree, insertAndRemoveAfterBuildFromSorted) {
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 0; i < 1000; ++i) {
+            pairs.emplace_back(2 * i, i);
+        }
+        AVLTree<int, int> tree;
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(2 * i + 1, i);
+        }
+        for (int i = 0; i < 2000; i += 3) {
+            tree.remove(i);
+        }
+        ASSERT_EQ(2000 - 667, tree.size());
+        for (size_t k = 0; k + 1 < tree.size(); ++k) {
+            ASSERT_LT(*tree.select(k), *tree.select(k + 1));
+        }
+    }
+
+    /**
+     * Value counting how many times it was copied
+     */
+    struct CopyCounted {
+        static int copies;
+        int payload;
+
+        explicit CopyCounted(int payload) : payload(payload) {}
+
+        CopyCounted(CopyCounted const &other) : payload(other.payload) { ++copies; }
+
+        CopyCounted(CopyCounted &&other) noexcept: payload(other.payload) {}
+
+        CopyCounted &operator=(CopyCounted const &other) {
+            payload = other.payload;
+            ++copies;
+            return *this;
+        }
+
+        CopyCounted &operator=(CopyCounted &&other) noexcept {
+            payload = other.payload;
+            return *this;
+        }
+    };
+
+    int CopyCounted::copies = 0;
+
+    TEST(AVLTree, insertMovesValue) {
+        AVLTree<int, CopyCounted> tree;
+        CopyCounted::copies = 0;
+        tree.insert(1, CopyCounted(10));
+        tree.insert(2, CopyCounted(20));
+        tree.insert(1, CopyCounted(11));
+        ASSERT_EQ(0, CopyCounted::copies);
+        ASSERT_EQ(11, tree.find(1)->payload);
+
+        CopyCounted value(30);
+        tree.insert(3, value);
+        ASSERT_EQ(1, CopyCounted::copies);
+    }
+
+    TEST(AVLTree, insertMoveOnlyValue) {
+        AVLTree<int, std::unique_ptr<int>> tree;
+        tree.insert(1, std::unique_ptr<int>(new int(10)));
+        tree.insert(1, std::unique_ptr<int>(new int(11)));
+        ASSERT_EQ(11, **tree.find(1));
+        ASSERT_EQ(1, tree.size());
+    }
+
+    TEST(AVLTree, tryEmplace) {
+        AVLTree<int, std::string> tree;
+        auto result = tree.tryEmplace(1, 3, 'a');
+        ASSERT_TRUE(result.second);
+        ASSERT_EQ("aaa", *result.first);
+
+        std::string replacement = "bbb";
+        result = tree.tryEmplace(1, std::move(replacement));
+        ASSERT_FALSE(result.second);
+        ASSERT_EQ("aaa", *result.first);
+        ASSERT_EQ("bbb", replacement);
+        ASSERT_EQ(1, tree.size());
+    }
+
+    TEST(AVLTree, emplace) {
+        AVLTree<std::string, CopyCounted> tree;
+        CopyCounted::copies = 0;
+        auto result = tree.emplace("b", 2);
+        ASSERT_TRUE(result.second);
+        tree.emplace("a", 1);
+        tree.emplace("c", 3);
+        result = tree.emplace("b", 20);
+        ASSERT_FALSE(result.second);
+        ASSERT_EQ(2, result.first->payload);
+        ASSERT_EQ(3, tree.size());
+        ASSERT_EQ(0, CopyCounted::copies);
+        ASSERT_EQ("b", *tree.select(1));
+    }
+
+    TEST(AVLTree, copyIsIndependent) {
+        AVLTree<int, std::string> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90, 25})
+            tree.insert(i, std::to_string(i));
+
+        AVLTree<int, std::string> copy(tree);
+        ASSERT_EQ(tree.toString(), copy.toString());
+        ASSERT_EQ(tree.size(), copy.size());
+
+        copy.insert(60, "60");
+        copy.remove(20);
+        *copy.find(50) = "changed";
+        ASSERT_EQ("50", *tree.find(50));
+        ASSERT_EQ(nullptr, tree.find(60));
+        ASSERT_EQ(8, tree.size());
+        ASSERT_EQ(8, copy.size());
+        ASSERT_EQ(3, copy.rank(50));
+    }
+
+    TEST(AVLTree, copyAssignment) {
+        AVLTree<int, int> tree;
+        for (int i : {50, 20, 80})
+            tree.insert(i, i);
+        AVLTree<int, int> other;
+        other.insert(1, 1);
+
+        other = tree;
+        ASSERT_EQ(tree.toString(), other.toString());
+        other = other;
+        ASSERT_EQ(tree.toString(), other.toString());
+
+        AVLTree<int, int> empty;
+        other = empty;
+        ASSERT_EQ("", other.toString());
+        ASSERT_EQ(0, other.size());
+    }
+
+    TEST(AVLTree, move) {
+        AVLTree<int, std::string> tree;
+        for (int i : {50, 20, 80})
+            tree.insert(i, std::to_string(i));
+        auto expected = tree.toString();
+        auto value = tree.find(20);
+
+        AVLTree<int, std::string> moved(std::move(tree));
+        ASSERT_EQ(expected, moved.toString());
+        ASSERT_EQ(value, moved.find(20));
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+
+        AVLTree<int, std::string> assigned;
+        assigned.insert(1, "1");
+        assigned = std::move(moved);
+        ASSERT_EQ(expected, assigned.toString());
+        ASSERT_EQ(0, moved.size());
+
+        moved.insert(5, "5");
+        ASSERT_EQ("5", *moved.find(5));
+    }
+
+    TEST(AVLTree, copyPreservesHeights) {
+        AVLTree<int, int> tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(i, i);
+        }
+        AVLTree<int, int> copy(tree);
+        for (int i = 100; i < 200; ++i) {
+            tree.insert(i, i);
+            copy.insert(i, i);
+        }
+        for (int i = 0; i < 200; i += 7) {
+            tree.remove(i);
+            copy.remove(i);
+        }
+        ASSERT_EQ(tree.toString(), copy.toString());
+    }
+
+    TEST(AVLTree, customComparatorOrder) {
+        AVLTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i = 1; i <= 5; ++i) {
+            tree.insert(i, i);
+        }
+        ASSERT_EQ(5, *tree.select(0));
+        ASSERT_EQ(1, *tree.select(4));
+        ASSERT_EQ(1, tree.rank(4));
+        ASSERT_EQ(3, tree.countInRange(4, 2));
+        ASSERT_EQ(0, tree.countInRange(2, 4));
+
+        tree.remove(5);
+        ASSERT_EQ(nullptr, tree.find(5));
+        ASSERT_EQ(4, *tree.select(0));
+    }
+
+    struct CountingCompare {
+        size_t *count;
+
+        int operator()(int lhs, int rhs) const {
+            ++*count;
+            return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+        }
+    };
+
+    TEST(AVLTree, singleComparisonPerVisitedNode) {
+        size_t comparisons = 0;
+        AVLTree<int, int, CountingCompare> tree(CountingCompare{&comparisons});
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 0; i < 15; ++i) {
+            pairs.emplace_back(i, i);
+        }
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+
+        // Perfect tree of 15 nodes, root 7, leaves on the 4th level
+        comparisons = 0;
+        tree.find(7);
+        ASSERT_EQ(1, comparisons);
+
+        comparisons = 0;
+        tree.find(0);
+        ASSERT_EQ(4, comparisons);
+
+        comparisons = 0;
+        tree.find(100);
+        ASSERT_EQ(4, comparisons);
+
+        comparisons = 0;
+        tree.insert(100, 100);
+        ASSERT_EQ(4, comparisons);
+    }
+
+    TEST(AVLTree, iteratesInKeyOrder) {
+        AVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(7);
+        for (int i = 0; i < 5000; ++i) {
+            int key = (int) (generator() % 1000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        std::vector<std::pair<int, int>> forward;
+        for (auto entry : tree) {
+            forward.emplace_back(entry.first, entry.second);
+        }
+        std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, forward);
+
+        std::vector<std::pair<int, int>> backward;
+        auto it = tree.end();
+        while (it != tree.begin()) {
+            --it;
+            backward.emplace_back(it->first, it->second);
+        }
+        expected.assign(reference.rbegin(), reference.rend());
+        ASSERT_EQ(expected, backward);
+    }
+
+    TEST(AVLTree, iteratorModifiesValues) {
+        AVLTree<int, int> tree;
+        for (int i = 0; i < 10; ++i) {
+            tree.insert(i, i);
+        }
+        for (auto it = tree.begin(); it != tree.end(); ++it) {
+            it.value() *= 10;
+        }
+
+        AVLTree<int, int> const &constTree = tree;
+        int expectedKey = 0;
+        for (AVLTree<int, int>::ConstIterator it = constTree.begin(); it != constTree.end(); it++) {
+            ASSERT_EQ(expectedKey, it.key());
+            ASSERT_EQ(expectedKey * 10, (*it).second);
+            ++expectedKey;
+        }
+        ASSERT_EQ(10, expectedKey);
+    }
+
+    TEST(AVLTree, emptyTreeIteration) {
+        AVLTree<int, int> tree;
+        ASSERT_TRUE(tree.begin() == tree.end());
+        ASSERT_FALSE(tree.cursor().valid());
+    }
+
+    TEST(AVLTree, cursorSeekAndStep) {
+        AVLTree<int, int> tree;
+        for (int i = 10; i <= 100; i += 10) {
+            tree.insert(i, i);
+        }
+        auto cursor = tree.cursor();
+        ASSERT_EQ(10, cursor.key());
+
+        ASSERT_TRUE(cursor.seek(50));
+        ASSERT_EQ(50, cursor.key());
+        ASSERT_TRUE(cursor.next());
+        ASSERT_EQ(60, cursor.key());
+        ASSERT_TRUE(cursor.previous());
+        ASSERT_TRUE(cursor.previous());
+        ASSERT_EQ(40, cursor.key());
+
+        ASSERT_FALSE(cursor.seek(55));
+        ASSERT_EQ(60, cursor.value());
+        ASSERT_FALSE(cursor.seek(5));
+        ASSERT_EQ(10, cursor.key());
+        ASSERT_FALSE(cursor.previous());
+        ASSERT_FALSE(cursor.seek(101));
+        ASSERT_FALSE(cursor.valid());
+        ASSERT_TRUE(cursor.position() == tree.end());
+
+        ASSERT_TRUE(cursor.seekLast());
+        ASSERT_EQ(100, cursor.key());
+        ASSERT_FALSE(cursor.next());
+        ASSERT_TRUE(cursor.seekFirst());
+        ASSERT_EQ(10, cursor.key());
+    }
+
+    TEST(AVLTree, iteratorSurvivesRotations) {
+        AVLTree<int, int> tree;
+        tree.insert(1, 1);
+        auto it = tree.begin();
+        for (int i = 2; i < 100; ++i) {
+            tree.insert(i, i);
+        }
+        ASSERT_EQ(1, it.key());
+        ASSERT_EQ(2, (++it).key());
+        tree.remove(1);
+        ASSERT_EQ(3, (++it).key());
+    }
+
+    TEST(AVLTree, boundsMatchMap) {
+        AVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(11);
+        for (int i = 0; i < 500; ++i) {
+            int key = (int) (generator() % 2000);
+            tree.insert(key, i);
+            reference[key] = i;
+        }
+
+        for (int key = -10; key < 2010; key += 3) {
+            auto lower = reference.lower_bound(key);
+            auto upper = reference.upper_bound(key);
+            if (lower == reference.end()) {
+                ASSERT_TRUE(tree.lowerBound(key) == tree.end());
+                ASSERT_TRUE(tree.ceiling(key) == tree.end());
+            } else {
+                ASSERT_EQ(lower->first, tree.lowerBound(key).key());
+                ASSERT_EQ(lower->first, tree.ceiling(key).key());
+            }
+            if (upper == reference.end()) {
+                ASSERT_TRUE(tree.upperBound(key) == tree.end());
+            } else {
+                ASSERT_EQ(upper->first, tree.upperBound(key).key());
+            }
+            if (upper == reference.begin()) {
+                ASSERT_TRUE(tree.floor(key) == tree.end());
+            } else {
+                ASSERT_EQ(std::prev(upper)->first, tree.floor(key).key());
+            }
+        }
+    }
+
+    TEST(AVLTree, forEachInRange) {
+        AVLTree<int, int> tree;
+        for (int i = 0; i < 100; i += 5) {
+            tree.insert(i, i * 2);
+        }
+
+        std::vector<int> keys;
+        tree.forEachInRange(12, 40, [&keys](int const &key, int &value) {
+            keys.push_back(key);
+            value = -1;
+        });
+        ASSERT_EQ(std::vector<int>({15, 20, 25, 30, 35, 40}), keys);
+        ASSERT_EQ(-1, *tree.find(40));
+        ASSERT_EQ(90, *tree.find(45));
+
+        AVLTree<int, int> const &constTree = tree;
+        int sum = 0;
+        constTree.forEachInRange(90, 1000, [&sum](int const &, int const &value) {
+            sum += value;
+        });
+        ASSERT_EQ(180 + 190, sum);
+
+        keys.clear();
+        tree.forEachInRange(41, 44, [&keys](int const &key, int &) {
+            keys.push_back(key);
+        });
+        tree.forEachInRange(50, 10, [&keys](int const &key, int &) {
+            keys.push_back(key);
+        });
+        ASSERT_TRUE(keys.empty());
+    }
+
+    TEST(AVLTree, freezeMatchesTree) {
+        for (int count : {0, 1, 2, 7, 8, 100, 1023, 1024, 1025}) {
+            AVLTree<int, int> tree;
+            for (int i = 0; i < count; ++i) {
+                tree.insert(i * 3, i);
+            }
+            auto frozen = tree.freeze();
+            ASSERT_EQ(tree.size(), frozen.size());
+            for (int key = -2; key < count * 3 + 2; ++key) {
+                auto value = tree.find(key);
+                if (value == nullptr) {
+                    ASSERT_FALSE(frozen.contains(key));
+                } else {
+                    ASSERT_EQ(*value, *frozen.find(key));
+                }
+            }
+        }
+    }
+
+    TEST(AVLTree, freezeIsSnapshot) {
+        AVLTree<std::string, int> tree;
+        tree.insert("b", 2);
+        tree.insert("a", 1);
+        auto frozen = tree.freeze();
+        tree.insert("c", 3);
+        tree.remove("a");
+        ASSERT_EQ(2, frozen.size());
+        ASSERT_EQ(1, *frozen.find("a"));
+        ASSERT_EQ(nullptr, frozen.find("c"));
+    }
+
+    TEST(AVLTree, findBatchMatchesFind) {
+        AVLTree<int, int> tree;
+        std::vector<int> keys;
+        std::vector<int *> values;
+        tree.findBatch(keys, values);
+        ASSERT_TRUE(values.empty());
+
+        // 37 keys leave a partial batch after two full ones
+        for (int key = 0; key < 37; ++key) {
+            keys.push_back(key * 5);
+        }
+        tree.findBatch(keys, values);
+        ASSERT_EQ(std::vector<int *>(37, nullptr), values);
+
+        for (int i = 0; i < 200; i += 3) {
+            tree.insert(i, i + 1);
+        }
+        tree.findBatch(keys, values);
+        ASSERT_EQ(keys.size(), values.size());
+        for (size_t idx = 0; idx < keys.size(); ++idx) {
+            ASSERT_EQ(tree.find(keys[idx]), values[idx]);
+        }
+        ASSERT_EQ(16, *values[3]);
+        ASSERT_EQ(nullptr, values[1]);
+    }
+
+    TEST(AVLTree, parallelBulkLoadMatchesSequential) {
+        // Enough pairs for several concurrently sorted partitions and built subtrees, every key twice
+        std::vector<std::pair<int, int>> pairs;
+        std::mt19937 generator(5);
+        for (int i = 0; i < 150000; ++i) {
+            pairs.emplace_back((int) (generator() % 100000), i);
+        }
+
+        AVLTree<int, int> sequential;
+        sequential.bulkLoad(pairs.begin(), pairs.end());
+        AVLTree<int, int> parallel;
+        parallel.bulkLoad(pairs.begin(), pairs.end(), true, 4);
+        ASSERT_EQ(sequential.size(), parallel.size());
+        ASSERT_EQ(sequential.toString(), parallel.toString());
+
+        for (int key = 0; key < 100000; key += 2) {
+            sequential.remove(key);
+            sequential.insert(-key - 1, key);
+            parallel.remove(key);
+            parallel.insert(-key - 1, key);
+        }
+        ASSERT_EQ(sequential.toString(), parallel.toString());
+        for (size_t k = 0; k + 1 < parallel.size(); k += 97) {
+            ASSERT_LT(*parallel.select(k), *parallel.select(k + 1));
+        }
+    }
+
+    TEST(AVLTree, parallelBuildFromSortedWithHeapAllocator) {
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 0; i < 70000; ++i) {
+            pairs.emplace_back(i, -i);
+        }
+        AVLTree<int, int, ThreeWayCompare<int>, HeapAllocator> tree;
+        tree.buildFromSorted(pairs.begin(), pairs.end(), 3);
+        ASSERT_EQ(70000, tree.size());
+        ASSERT_EQ(-69999, *tree.find(69999));
+        ASSERT_EQ(34999, tree.rank(34999));
+    }
+
+    /**
+     * Check that tree holds exactly the reference elements, in order both ways and by rank
+     */
+    void assertMatches(std::map<int, int> const &reference, AVLTree<int, int> const &tree) {
+        ASSERT_EQ(reference.size(), tree.size());
+        std::vector<std::pair<int, int>> forward;
+        for (auto entry : tree) {
+            forward.emplace_back(entry.first, entry.second);
+        }
+        std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, forward);
+
+        std::vector<std::pair<int, int>> backward;
+        auto it = tree.end();
+        while (it != tree.begin()) {
+            --it;
+            backward.emplace_back(it->first, it->second);
+        }
+        expected.assign(reference.rbegin(), reference.rend());
+        ASSERT_EQ(expected, backward);
+
+        size_t k = 0;
+        for (auto const &entry : reference) {
+            ASSERT_EQ(entry.first, *tree.select(k));
+            ASSERT_EQ(k++, tree.rank(entry.first));
+        }
+    }
+
+    /**
+     * Fill tree and reference with random keys from [0, range)
+     */
+    void fillRandom(std::mt19937 &generator, int count, int range, int valueOffset,
+                    AVLTree<int, int> &tree, std::map<int, int> &reference) {
+        for (int i = 0; i < count; ++i) {
+            int key = (int) (generator() % range);
+            tree.insert(key, key + valueOffset);
+            reference[key] = key + valueOffset;
+        }
+    }
+
+    TEST(AVLTree, joinAndSplit) {
+        AVLTree<int, int> tree, greater;
+        std::map<int, int> reference;
+        for (int key = 0; key < 1000; ++key) {
+            (key < 10 ? tree : greater).insert(key, -key);
+            reference[key] = -key;
+        }
+        tree.join(std::move(greater));
+        ASSERT_EQ(0, greater.size());
+        assertMatches(reference, tree);
+
+        AVLTree<int, int> empty;
+        empty.join(std::move(tree));
+        assertMatches(reference, empty);
+        empty.join(std::move(tree));
+        assertMatches(reference, empty);
+
+        auto upper = empty.split(600);
+        std::map<int, int> lowerReference(reference.begin(), reference.find(600));
+        std::map<int, int> upperReference(reference.find(600), reference.end());
+        assertMatches(lowerReference, empty);
+        assertMatches(upperReference, upper);
+
+        auto none = upper.split(5000);
+        ASSERT_EQ(0, none.size());
+        auto all = upper.split(-5);
+        ASSERT_EQ(0, upper.size());
+        assertMatches(upperReference, all);
+
+        for (int key = 1000; key < 2000; ++key) {
+            all.insert(key, key);
+            upperReference[key] = key;
+        }
+        all.remove(700);
+        upperReference.erase(700);
+        assertMatches(upperReference, all);
+    }
+
+    TEST(AVLTree, splitRelinksHeapNodes) {
+        typedef AVLTree<int, int, ThreeWayCompare<int>, HeapAllocator> HeapTree;
+        HeapTree tree;
+        for (int key = 0; key < 1000; ++key) {
+            tree.insert(key, -key);
+        }
+        auto value = tree.find(700);
+
+        auto greater = tree.split(600);
+        ASSERT_EQ(600, tree.size());
+        ASSERT_EQ(400, greater.size());
+        ASSERT_EQ(value, greater.find(700));
+        ASSERT_EQ(nullptr, tree.find(700));
+        ASSERT_EQ(600, *greater.select(0));
+        ASSERT_EQ(999, *greater.select(399));
+        ASSERT_EQ(599, *tree.select(599));
+
+        greater.remove(700);
+        greater.insert(1000, 1000);
+        tree.join(std::move(greater));
+        ASSERT_EQ(1000, tree.size());
+        ASSERT_EQ(-650, *tree.find(650));
+    }
+
+    TEST(AVLTree, unionMatchesMap) {
+        std::mt19937 generator(19);
+        for (int otherCount : {0, 10, 1000, 30000}) {
+            AVLTree<int, int> tree, other;
+            std::map<int, int> reference, otherReference;
+            fillRandom(generator, 20000, 100000, 0, tree, reference);
+            fillRandom(generator, otherCount, 100000, 1, other, otherReference);
+            for (auto const &entry : otherReference) {
+                reference[entry.first] = entry.second;
+            }
+
+            tree.unionWith(std::move(other), otherCount > 1000 ? 4 : 1);
+            ASSERT_EQ(0, other.size());
+            assertMatches(reference, tree);
+            tree.insert(-1, -1);
+            tree.remove(reference.begin()->first);
+        }
+    }
+
+    TEST(AVLTree, intersectionMatchesMap) {
+        std::mt19937 generator(23);
+        for (int otherCount : {0, 10, 1000, 30000}) {
+            AVLTree<int, int> tree, other;
+            std::map<int, int> reference, otherReference;
+            fillRandom(generator, 20000, 40000, 0, tree, reference);
+            fillRandom(generator, otherCount, 40000, 1, other, otherReference);
+            std::map<int, int> expected;
+            for (auto const &entry : reference) {
+                if (otherReference.count(entry.first) != 0) {
+                    expected.insert(entry);
+                }
+            }
+
+            tree.intersectWith(other, otherCount > 1000 ? 4 : 1);
+            assertMatches(expected, tree);
+            assertMatches(otherReference, other);
+        }
+    }
+
+    TEST(AVLTree, differenceMatchesMap) {
+        std::mt19937 generator(29);
+        for (int otherCount : {0, 10, 1000, 30000}) {
+            AVLTree<int, int> tree, other;
+            std::map<int, int> reference, otherReference;
+            fillRandom(generator, 20000, 40000, 0, tree, reference);
+            fillRandom(generator, otherCount, 40000, 1, other, otherReference);
+            for (auto const &entry : otherReference) {
+                reference.erase(entry.first);
+            }
+
+            tree.differenceWith(other, otherCount > 1000 ? 4 : 1);
+            assertMatches(reference, tree);
+            assertMatches(otherReference, other);
+        }
+    }
+
+    TEST(AVLTree, setOperationsWithItself) {
+        AVLTree<int, int> tree;
+        std::map<int, int> reference;
+        for (int key = 0; key < 100; ++key) {
+            tree.insert(key, key);
+            reference[key] = key;
+        }
+        tree.unionWith(std::move(tree));
+        tree.intersectWith(tree);
+        assertMatches(reference, tree);
+        tree.differenceWith(tree);
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(AVLTree, writeStringMatchesToString) {
+        AVLTree<int, int> tree;
+        for (int i = 1; i <= 7; ++i) {
+            tree.insert(i, i * 10);
+        }
+        std::ostringstream stream;
+        tree.writeString(stream);
+        ASSERT_EQ(tree.toString(), stream.str());
+
+        std::ostringstream bounded;
+        tree.writeString(bounded, 2);
+        ASSERT_EQ("([4,40],([2,20],...,...),([6,60],...,...))", bounded.str());
+
+        std::ostringstream none;
+        tree.writeString(none, 0);
+        ASSERT_EQ("...", none.str());
+    }
+
+    TEST(AVLTree, printBoundedDepth) {
+        AVLTree<int, int> tree;
+        for (int i = 1; i <= 7; ++i) {
+            tree.insert(i, i);
+        }
+        std::ostringstream stream;
+        tree.print(stream, 2);
+        std::string expected = "[4, 4]\n    L: [2, 2]\n        L: ...\n        R: ...\n    R: [6, 6]\n"
+                               "        L: ...\n        R: ...\n";
+        ASSERT_EQ(expected, stream.str());
+
+        std::ostringstream empty;
+        tree.print(empty, 0);
+        ASSERT_EQ("", empty.str());
+    }
+
+    TEST(AVLTree, printRange) {
+        AVLTree<int, int> tree;
+        for (int i = 1; i <= 7; ++i) {
+            tree.insert(i, i);
+        }
+        std::ostringstream stream;
+        tree.printRange(stream, 3, 5);
+        ASSERT_EQ("[4, 4]\n        R: [3, 3]\n        L: [5, 5]\n", stream.str());
+
+        std::ostringstream outside;
+        tree.printRange(outside, 8, 10);
+        ASSERT_EQ("", outside.str());
+    }
+
+    TEST(AVLTree, containsKey) {
+        AVLTree<int, int> tree;
+        ASSERT_FALSE(tree.contains(1));
+        tree.insert(1, 10);
+        tree.insert(2, 20);
+        AVLTree<int, int> const &constTree = tree;
+        ASSERT_TRUE(constTree.contains(1));
+        ASSERT_TRUE(constTree.contains(2));
+        ASSERT_FALSE(constTree.contains(3));
+        tree.remove(1);
+        ASSERT_FALSE(constTree.contains(1));
+    }
+
+    TEST(AVLTree, setStoresNoValues) {
+        typedef AVLTreeSet<unsigned long> Set;
+        ASSERT_LT(Set::nodeBytes(), (AVLTree<unsigned long, unsigned long>::nodeBytes()));
+        ASSERT_EQ(48, Set::nodeBytes());
+    }
+
+    TEST(AVLTree, setMatchesStdSet) {
+        AVLTreeSet<int> set;
+        std::set<int> reference;
+        std::mt19937 generator(24);
+        std::uniform_int_distribution<int> keys(0, 999);
+        for (int i = 0; i < 5000; ++i) {
+            auto key = keys(generator);
+            if (i % 3 == 2) {
+                set.remove(key);
+                reference.erase(key);
+            } else {
+                ASSERT_EQ(reference.insert(key).second, set.insert(key));
+            }
+        }
+        ASSERT_EQ(reference.size(), set.size());
+        std::vector<int> inOrder;
+        for (auto element : set) {
+            inOrder.push_back(element.first);
+        }
+        ASSERT_EQ(std::vector<int>(reference.begin(), reference.end()), inOrder);
+        for (int key = 0; key < 1000; ++key) {
+            ASSERT_EQ(reference.count(key) == 1, set.contains(key));
+        }
+    }
+
+    TEST(AVLTree, setKeepsTreeInterface) {
+        AVLTreeSet<int> set;
+        for (int i = 1; i <= 3; ++i) {
+            set.insert(i);
+        }
+        ASSERT_FALSE(set.insert(2));
+        ASSERT_EQ("([2,],([1,],,),([3,],,))", set.toString());
+
+        AVLTreeSet<int> copy(set);
+        auto greater = copy.split(2);
+        ASSERT_EQ(1, copy.size());
+        ASSERT_TRUE(greater.contains(2));
+        ASSERT_TRUE(greater.contains(3));
+        ASSERT_FALSE(greater.contains(1));
+        ASSERT_EQ(3, set.size());
+    }
+
+    /**
+     * Value counting its live instances, copying throws once the shared copy budget is used up
+     */
+    struct FragileValue {
+        static std::atomic<int> live;
+        static std::atomic<int> copiesLeft;
+
+        FragileValue() {
+            ++live;
+        }
+
+        FragileValue(FragileValue const &) {
+            if (copiesLeft-- <= 0) {
+                throw std::runtime_error("copy failed");
+            }
+            ++live;
+        }
+
+        ~FragileValue() {
+            --live;
+        }
+    };
+
+    std::atomic<int> FragileValue::live(0);
+    std::atomic<int> FragileValue::copiesLeft(0);
+
+    /**
+     * Check that a build failing after copyBudget values leaves an empty tree and no live nodes behind
+     */
+    template<typename Tree>
+    void assertFailedBuildCleansUp(int count, int copyBudget, size_t threadCount) {
+        FragileValue::copiesLeft = count;
+        std::vector<std::pair<int, FragileValue>> pairs;
+        pairs.reserve(count);
+        for (int key = 0; key < count; ++key) {
+            pairs.emplace_back(key, FragileValue());
+        }
+
+        int liveBefore = FragileValue::live;
+        Tree tree;
+        FragileValue::copiesLeft = copyBudget;
+        ASSERT_THROW(tree.buildFromSorted(pairs.begin(), pairs.end(), threadCount), std::runtime_error);
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(liveBefore, FragileValue::live);
+    }
+
+    TEST(AVLTree, buildFromSortedCleansUpAfterThrowingCopy) {
+        typedef AVLTree<int, FragileValue, ThreeWayCompare<int>, HeapAllocator> HeapTree;
+        typedef AVLTree<int, FragileValue> PoolTree;
+        for (int copyBudget : {0, 1, 2, 600, 999}) {
+            assertFailedBuildCleansUp<HeapTree>(1000, copyBudget, 1);
+            assertFailedBuildCleansUp<PoolTree>(1000, copyBudget, 1);
+        }
+        for (int copyBudget : {0, 1, 2, 5, 35000, 69990}) {
+            assertFailedBuildCleansUp<HeapTree>(70000, copyBudget, 4);
+            assertFailedBuildCleansUp<PoolTree>(70000, copyBudget, 4);
+        }
+    }
 }
@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../BTreeLib/BTree.h"
+
+
+namespace BTreeUnitTest {
+
+    TEST(BTree, constructEmpty) {
+        BTree<int, int> tree;
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(1));
+        tree.remove(1);
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(BTree, insertAndFind) {
+        BTree<int, int> tree;
+        tree.insert(20, 2);
+        tree.insert(10, 1);
+        tree.insert(30, 3);
+        ASSERT_EQ("([10,1][20,2][30,3])", tree.toString());
+        ASSERT_EQ(3, tree.size());
+        ASSERT_EQ(2, *tree.find(20));
+        ASSERT_EQ(nullptr, tree.find(25));
+    }
+
+    TEST(BTree, insertReplacesValue) {
+        BTree<int, std::string> tree;
+        tree.insert(1, "one");
+        tree.insert(1, "uno");
+        ASSERT_EQ(1, tree.size());
+        ASSERT_EQ("uno", *tree.find(1));
+    }
+
+    TEST(BTree, rootSplitsWhenFull) {
+        // 32 byte keys leave 8 slots per node, a full node has 7 keys
+        BTree<std::string, int> tree;
+        for (int i = 0; i < 8; ++i) {
+            tree.insert(std::string(1, (char) ('a' + i)), i);
+        }
+        ASSERT_EQ("([d,3],([a,0][b,1][c,2]),([e,4][f,5][g,6][h,7]))", tree.toString());
+    }
+
+    TEST(BTree, removeFromLeafAndInternal) {
+        BTree<std::string, int> tree;
+        for (int i = 0; i < 8; ++i) {
+            tree.insert(std::string(1, (char) ('a' + i)), i);
+        }
+        tree.remove("d");
+        ASSERT_EQ("([e,4],([a,0][b,1][c,2]),([f,5][g,6][h,7]))", tree.toString());
+        tree.remove("a");
+        ASSERT_EQ("([b,1][c,2][e,4][f,5][g,6][h,7])", tree.toString());
+        tree.remove("x");
+        ASSERT_EQ(6, tree.size());
+    }
+
+    template<typename KeyType>
+    void checkAgainstMap(std::vector<KeyType> const &universe, unsigned seed) {
+        BTree<KeyType, int> tree;
+        std::map<KeyType, int> reference;
+        std::mt19937 generator(seed);
+        for (int i = 0; i < 30000; ++i) {
+            auto key = universe[generator() % universe.size()];
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        for (auto const &key : universe) {
+            auto entry = reference.find(key);
+            if (entry == reference.end()) {
+                ASSERT_EQ(nullptr, tree.find(key));
+            } else {
+                ASSERT_NE(nullptr, tree.find(key));
+                ASSERT_EQ(entry->second, *tree.find(key));
+            }
+        }
+
+        for (auto const &entry : reference) {
+            tree.remove(entry.first);
+        }
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ("", tree.toString());
+    }
+
+    TEST(BTree, randomUnsignedLongMatchesMap) {
+        std::vector<unsigned long> universe;
+        for (unsigned long i = 0; i < 3000; ++i) {
+            universe.push_back(i * 0x9E3779B97F4A7C15UL);
+        }
+        checkAgainstMap(universe, 1);
+    }
+
+    TEST(BTree, randomSignedIntMatchesMap) {
+        std::vector<int> universe;
+        for (int i = -1500; i < 1500; ++i) {
+            universe.push_back(i * 7919);
+        }
+        checkAgainstMap(universe, 2);
+    }
+
+    TEST(BTree, randomUnsignedIntMatchesMap) {
+        std::vector<std::uint32_t> universe;
+        for (std::uint32_t i = 0; i < 3000; ++i) {
+            universe.push_back(i * 2654435761U);
+        }
+        checkAgainstMap(universe, 3);
+    }
+
+    TEST(BTree, randomStringMatchesMap) {
+        std::vector<std::string> universe;
+        for (int i = 0; i < 1000; ++i) {
+            universe.push_back(std::to_string(i * 31));
+        }
+        checkAgainstMap(universe, 4);
+    }
+
+    TEST(BTree, nodeSearchMatchesScalar) {
+        typedef ThreeWayCompare<long> NaturalOrder;
+        long keys[32] = {};
+        for (size_t count = 0; count <= 31; ++count) {
+            for (size_t idx = 0; idx < count; ++idx) {
+                keys[idx] = (long) idx * 10 - 100;
+            }
+            for (long key = -120; key < 220; key += 5) {
+                size_t expected = 0;
+                while (expected < count && keys[expected] < key) {
+                    ++expected;
+                }
+                ASSERT_EQ(expected, (NodeSearch<long, NaturalOrder>::lowerBound<32>(keys, count, key, NaturalOrder())));
+            }
+        }
+    }
+
+    TEST(BTree, customComparator) {
+        BTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(i, i);
+        }
+        for (int i = 0; i < 100; i += 2) {
+            tree.remove(i);
+        }
+        ASSERT_EQ(50, tree.size());
+        ASSERT_EQ(nullptr, tree.find(50));
+        ASSERT_EQ(51, *tree.find(51));
+    }
+
+    TEST(BTree, print) {
+        BTree<std::string, int> tree;
+        for (int i = 0; i < 8; ++i) {
+            tree.insert(std::string(1, (char) ('a' + i)), i);
+        }
+        std::ostringstream stream;
+        stream << tree;
+        ASSERT_EQ("[d, 3]\n    [a, 0][b, 1][c, 2]\n    [e, 4][f, 5][g, 6][h, 7]\n", stream.str());
+    }
+
+    TEST(BTree, moveAndClear) {
+        BTree<int, int> tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(i, i);
+        }
+        BTree<int, int> moved(std::move(tree));
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(1000, moved.size());
+        ASSERT_EQ(500, *moved.find(500));
+
+        tree = std::move(moved);
+        ASSERT_EQ(1000, tree.size());
+        tree.clear();
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(500));
+        tree.insert(1, 1);
+        ASSERT_EQ(1, *tree.find(1));
+    }
+
+    /**
+     * Stand-in for a B-tree node, over-aligned to a cache line
+     */
+    struct alignas(64) LineAlignedNode {
+        unsigned long keys[33];
+    };
+
+    template<template<typename> class NodeAllocator>
+    void checkCacheLineAlignment() {
+        NodeAllocator<LineAlignedNode> allocator;
+        std::vector<LineAlignedNode *> nodes;
+        for (int i = 0; i < 1000; ++i) {
+            nodes.push_back(allocator.create());
+            ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(nodes.back()) % 64);
+        }
+        for (auto node : nodes) {
+            allocator.destroy(node);
+        }
+        allocator.releaseAll();
+    }
+
+    TEST(BTree, allocatorsAlignNodesToCacheLines) {
+        checkCacheLineAlignment<NodePool>();
+        checkCacheLineAlignment<HeapAllocator>();
+    }
+
+    TEST(BTree, heapAllocatedNodes) {
+        BTree<unsigned long, unsigned long, ThreeWayCompare<unsigned long>, HeapAllocator> tree;
+        for (unsigned long key = 0; key < 5000; ++key) {
+            tree.insert(key, key * 2);
+        }
+        for (unsigned long key = 0; key < 5000; key += 2) {
+            tree.remove(key);
+        }
+        ASSERT_EQ(2500, tree.size());
+        ASSERT_EQ(nullptr, tree.find(4000));
+        ASSERT_EQ(8002, *tree.find(4001));
+    }
+}
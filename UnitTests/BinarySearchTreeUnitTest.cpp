@@ -1,6 +1,14 @@
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <random>
+#include <cstdio>
+#include <stdexcept>
 #include "../BinarySearchTreeLib/BinarySearchTree.h"
+#include "../BinarySearchTreeLib/BinarySearchTreeSet.h"
 
 
 namespace BinarySearchTreeUnitTest
@@ -523,4 +531,623 @@ namespace BinarySearchTreeUnitTest
 
         ASSERT_EQ(4, closest);
     }
+
+    TEST(BinarySearchTree, sizeAfterRemove)
+    {
+        BinarySearchTree<int, int> tree;
+        tree.insert(50, 500);
+        tree.insert(20, 200);
+        tree.insert(80, 800);
+        tree.insert(10, 100);
+        tree.insert(30, 300);
+        tree.insert(15, 150);
+        tree.insert(12, 120);
+        tree.insert(20, 201);
+        ASSERT_EQ(7, tree.size());
+        tree.remove(20);
+        ASSERT_EQ(6, tree.size());
+        tree.remove(25);
+        ASSERT_EQ(6, tree.size());
+        tree.remove(50);
+        tree.remove(12);
+        ASSERT_EQ(4, tree.size());
+        ASSERT_EQ(3, tree.rank(50));
+    }
+
+    TEST(BinarySearchTree, rank)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+
+        ASSERT_EQ(0, tree.rank(5));
+        ASSERT_EQ(0, tree.rank(10));
+        ASSERT_EQ(3, tree.rank(50));
+        ASSERT_EQ(4, tree.rank(55));
+        ASSERT_EQ(7, tree.rank(100));
+    }
+
+    TEST(BinarySearchTree, select)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+        tree.remove(50);
+
+        std::vector<int> expected = {10, 20, 30, 70, 80, 90};
+        for (size_t k = 0; k < expected.size(); ++k)
+            ASSERT_EQ(expected[k], *tree.select(k));
+        ASSERT_EQ(nullptr, tree.select(6));
+    }
+
+    TEST(BinarySearchTree, countInRange)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+
+        ASSERT_EQ(3, tree.countInRange(20, 50));
+        ASSERT_EQ(3, tree.countInRange(25, 75));
+        ASSERT_EQ(7, tree.countInRange(0, 100));
+        ASSERT_EQ(0, tree.countInRange(31, 49));
+        ASSERT_EQ(0, tree.countInRange(50, 20));
+    }
+
+    TEST(BinarySearchTree, heapAllocator)
+    {
+        BinarySearchTree<int, int, ThreeWayCompare<int>, HeapAllocator> tree;
+        tree.insert(50, 500);
+        tree.insert(20, 200);
+        tree.insert(80, 800);
+        tree.remove(20);
+        std::string expected = "([50,500],,([80,800],,))";
+        ASSERT_EQ(expected, tree.toString());
+    }
+
+    TEST(BinarySearchTree, clear)
+    {
+        BinarySearchTree<int, std::string> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, std::to_string(i));
+        tree.remove(20);
+        tree.remove(80);
+        tree.insert(25, "25");
+        tree.clear();
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ("", tree.toString());
+        tree.insert(1, "one");
+        ASSERT_EQ("one", *tree.find(1));
+    }
+
+    TEST(BinarySearchTree, degenerateSortedInsert)
+    {
+        BinarySearchTree<int, int> tree;
+        const int count = 20000;
+        for (int i = 0; i < count; ++i)
+            tree.insert(i, i);
+
+        ASSERT_EQ(count, tree.size());
+        ASSERT_EQ(count - 1, *tree.find(count - 1));
+        ASSERT_EQ(nullptr, tree.find(count));
+        ASSERT_EQ(count - 1, tree.findClosestTester(*tree.find(count - 1)));
+        ASSERT_FALSE(tree.toString().empty());
+        tree.clear();
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(BinarySearchTree, buildFromSorted)
+    {
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 1; i <= 7; ++i) {
+            pairs.emplace_back(i, 10 * i);
+        }
+        BinarySearchTree<int, int> tree;
+        tree.insert(100, 100);
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        std::string expected = "([4,40],([2,20],([1,10],,),([3,30],,)),([6,60],([5,50],,),([7,70],,)))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(7, tree.size());
+        ASSERT_EQ(nullptr, tree.find(100));
+    }
+
+    TEST(BinarySearchTree, buildFromSortedEmpty)
+    {
+        std::vector<std::pair<int, int>> pairs;
+        BinarySearchTree<int, int> tree;
+        tree.insert(1, 1);
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(BinarySearchTree, bulkLoadDeduplicatesLastWriteWins)
+    {
+        std::vector<std::pair<int, int>> pairs = {{5, 1}, {3, 1}, {5, 2}, {1, 1}, {3, 2}, {5, 3}, {4, 1}};
+        BinarySearchTree<int, int> tree;
+        tree.bulkLoad(pairs.begin(), pairs.end());
+        std::string expected = "([3,2],([1,1],,),([4,1],,([5,3],,)))";
+        ASSERT_EQ(expected, tree.toString());
+        ASSERT_EQ(4, tree.size());
+    }
+
+    /**
+     * Value counting how many times it was copied
+     */
+    struct CopyCounted {
+        static int copies;
+        int payload;
+
+        explicit CopyCounted(int payload) : payload(payload) {}
+
+        CopyCounted(CopyCounted const &other) : payload(other.payload) { ++copies; }
+
+        CopyCounted(CopyCounted &&other) noexcept: payload(other.payload) {}
+
+        CopyCounted &operator=(CopyCounted const &other) {
+            payload = other.payload;
+            ++copies;
+            return *this;
+        }
+
+        CopyCounted &operator=(CopyCounted &&other) noexcept {
+            payload = other.payload;
+            return *this;
+        }
+    };
+
+    int CopyCounted::copies = 0;
+
+    TEST(BinarySearchTree, insertMovesValue)
+    {
+        BinarySearchTree<int, CopyCounted> tree;
+        CopyCounted::copies = 0;
+        tree.insert(1, CopyCounted(10));
+        tree.insert(2, CopyCounted(20));
+        tree.insert(1, CopyCounted(11));
+        ASSERT_EQ(0, CopyCounted::copies);
+        ASSERT_EQ(11, tree.find(1)->payload);
+
+        CopyCounted value(30);
+        tree.insert(3, value);
+        ASSERT_EQ(1, CopyCounted::copies);
+    }
+
+    TEST(BinarySearchTree, insertMoveOnlyValue)
+    {
+        BinarySearchTree<int, std::unique_ptr<int>> tree;
+        tree.insert(1, std::unique_ptr<int>(new int(10)));
+        tree.insert(1, std::unique_ptr<int>(new int(11)));
+        ASSERT_EQ(11, **tree.find(1));
+        ASSERT_EQ(1, tree.size());
+    }
+
+    TEST(BinarySearchTree, tryEmplace)
+    {
+        BinarySearchTree<int, std::string> tree;
+        auto result = tree.tryEmplace(1, 3, 'a');
+        ASSERT_TRUE(result.second);
+        ASSERT_EQ("aaa", *result.first);
+
+        std::string replacement = "bbb";
+        result = tree.tryEmplace(1, std::move(replacement));
+        ASSERT_FALSE(result.second);
+        ASSERT_EQ("aaa", *result.first);
+        ASSERT_EQ("bbb", replacement);
+        ASSERT_EQ(1, tree.size());
+    }
+
+    TEST(BinarySearchTree, emplace)
+    {
+        BinarySearchTree<std::string, CopyCounted> tree;
+        CopyCounted::copies = 0;
+        auto result = tree.emplace("b", 2);
+        ASSERT_TRUE(result.second);
+        tree.emplace("a", 1);
+        tree.emplace("c", 3);
+        result = tree.emplace("b", 20);
+        ASSERT_FALSE(result.second);
+        ASSERT_EQ(2, result.first->payload);
+        ASSERT_EQ(3, tree.size());
+        ASSERT_EQ(0, CopyCounted::copies);
+        ASSERT_EQ("b", *tree.select(1));
+    }
+
+    TEST(BinarySearchTree, copyIsIndependent)
+    {
+        BinarySearchTree<int, std::string> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90, 25})
+            tree.insert(i, std::to_string(i));
+
+        BinarySearchTree<int, std::string> copy(tree);
+        ASSERT_EQ(tree.toString(), copy.toString());
+        ASSERT_EQ(tree.size(), copy.size());
+
+        copy.insert(60, "60");
+        copy.remove(20);
+        *copy.find(50) = "changed";
+        ASSERT_EQ("50", *tree.find(50));
+        ASSERT_EQ(nullptr, tree.find(60));
+        ASSERT_EQ(8, tree.size());
+        ASSERT_EQ(8, copy.size());
+        ASSERT_EQ(3, copy.rank(50));
+    }
+
+    TEST(BinarySearchTree, copyAssignment)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80})
+            tree.insert(i, i);
+        BinarySearchTree<int, int> other;
+        other.insert(1, 1);
+
+        other = tree;
+        ASSERT_EQ(tree.toString(), other.toString());
+        other = other;
+        ASSERT_EQ(tree.toString(), other.toString());
+
+        BinarySearchTree<int, int> empty;
+        other = empty;
+        ASSERT_EQ("", other.toString());
+        ASSERT_EQ(0, other.size());
+    }
+
+    TEST(BinarySearchTree, move)
+    {
+        BinarySearchTree<int, std::string> tree;
+        for (int i : {50, 20, 80})
+            tree.insert(i, std::to_string(i));
+        auto expected = tree.toString();
+        auto value = tree.find(20);
+
+        BinarySearchTree<int, std::string> moved(std::move(tree));
+        ASSERT_EQ(expected, moved.toString());
+        ASSERT_EQ(value, moved.find(20));
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+
+        BinarySearchTree<int, std::string> assigned;
+        assigned.insert(1, "1");
+        assigned = std::move(moved);
+        ASSERT_EQ(expected, assigned.toString());
+        ASSERT_EQ(0, moved.size());
+
+        moved.insert(5, "5");
+        ASSERT_EQ("5", *moved.find(5));
+    }
+
+    TEST(BinarySearchTree, customComparatorOrder)
+    {
+        BinarySearchTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i : {3, 1, 5, 2, 4})
+            tree.insert(i, i);
+        ASSERT_EQ(5, *tree.select(0));
+        ASSERT_EQ(1, *tree.select(4));
+        ASSERT_EQ(1, tree.rank(4));
+        ASSERT_EQ(3, tree.countInRange(4, 2));
+
+        tree.remove(3);
+        ASSERT_EQ(nullptr, tree.find(3));
+        ASSERT_EQ(4, tree.size());
+        ASSERT_EQ(2, *tree.select(2));
+    }
+
+    struct CountingCompare
+    {
+        size_t *count;
+
+        int operator()(int lhs, int rhs) const
+        {
+            ++*count;
+            return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+        }
+    };
+
+    TEST(BinarySearchTree, singleComparisonPerVisitedNode)
+    {
+        size_t comparisons = 0;
+        BinarySearchTree<int, int, CountingCompare> tree(CountingCompare{&comparisons});
+        for (int i : {50, 20, 80, 10, 30})
+            tree.insert(i, i);
+
+        comparisons = 0;
+        tree.find(50);
+        ASSERT_EQ(1, comparisons);
+
+        comparisons = 0;
+        tree.find(30);
+        ASSERT_EQ(3, comparisons);
+
+        comparisons = 0;
+        tree.find(90);
+        ASSERT_EQ(2, comparisons);
+    }
+
+    TEST(BinarySearchTree, iteratesInKeyOrder)
+    {
+        BinarySearchTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(7);
+        for (int i = 0; i < 5000; ++i) {
+            int key = (int) (generator() % 1000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+        ASSERT_EQ(reference.size(), tree.size());
+
+        std::vector<std::pair<int, int>> forward;
+        for (auto entry : tree)
+            forward.emplace_back(entry.first, entry.second);
+        std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, forward);
+
+        std::vector<std::pair<int, int>> backward;
+        auto it = tree.end();
+        while (it != tree.begin()) {
+            --it;
+            backward.emplace_back(it->first, it->second);
+        }
+        expected.assign(reference.rbegin(), reference.rend());
+        ASSERT_EQ(expected, backward);
+    }
+
+    TEST(BinarySearchTree, iteratesCopiesAndBulkLoaded)
+    {
+        std::vector<std::pair<int, int>> pairs;
+        for (int i = 0; i < 100; ++i)
+            pairs.emplace_back(i, i);
+        BinarySearchTree<int, int> tree;
+        tree.buildFromSorted(pairs.begin(), pairs.end());
+        BinarySearchTree<int, int> const copy(tree);
+
+        int expectedKey = 0;
+        for (auto it = copy.begin(); it != copy.end(); ++it)
+            ASSERT_EQ(expectedKey++, it.key());
+        ASSERT_EQ(100, expectedKey);
+    }
+
+    TEST(BinarySearchTree, cursorSeekAndStep)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+        auto cursor = tree.cursor();
+        ASSERT_EQ(10, cursor.key());
+
+        ASSERT_TRUE(cursor.seek(30));
+        ASSERT_TRUE(cursor.next());
+        ASSERT_EQ(50, cursor.key());
+        ASSERT_TRUE(cursor.next());
+        ASSERT_EQ(70, cursor.key());
+        ASSERT_TRUE(cursor.previous());
+        ASSERT_EQ(50, cursor.key());
+
+        ASSERT_FALSE(cursor.seek(60));
+        ASSERT_EQ(70, cursor.key());
+        cursor.value() = 7;
+        ASSERT_EQ(7, *tree.find(70));
+        ASSERT_FALSE(cursor.seek(95));
+        ASSERT_FALSE(cursor.valid());
+    }
+
+    TEST(BinarySearchTree, bounds)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+
+        ASSERT_EQ(50, tree.lowerBound(50).key());
+        ASSERT_EQ(70, tree.upperBound(50).key());
+        ASSERT_EQ(30, tree.floor(45).key());
+        ASSERT_EQ(50, tree.ceiling(45).key());
+        ASSERT_EQ(90, tree.floor(1000).key());
+        ASSERT_TRUE(tree.floor(5) == tree.end());
+        ASSERT_TRUE(tree.upperBound(90) == tree.end());
+        ASSERT_EQ(10, tree.lowerBound(-5).key());
+    }
+
+    TEST(BinarySearchTree, forEachInRange)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90})
+            tree.insert(i, i);
+
+        std::vector<int> keys;
+        tree.forEachInRange(20, 75, [&keys](int const &key, int &value) {
+            keys.push_back(key);
+            ++value;
+        });
+        ASSERT_EQ(std::vector<int>({20, 30, 50, 70}), keys);
+        ASSERT_EQ(71, *tree.find(70));
+
+        BinarySearchTree<int, int> const &constTree = tree;
+        int count = 0;
+        constTree.forEachInRange(91, 100, [&count](int const &, int const &) {
+            ++count;
+        });
+        ASSERT_EQ(0, count);
+    }
+
+    TEST(BinarySearchTree, freezeMatchesTree)
+    {
+        BinarySearchTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90, 60})
+            tree.insert(i, i + 1);
+        auto frozen = tree.freeze();
+        ASSERT_EQ(8, frozen.size());
+        for (int key = 0; key <= 100; ++key) {
+            if (tree.find(key) == nullptr)
+                ASSERT_EQ(nullptr, frozen.find(key));
+            else
+                ASSERT_EQ(key + 1, *frozen.find(key));
+        }
+    }
+
+    TEST(BinarySearchTree, findBatchMatchesFind)
+    {
+        BinarySearchTree<int, int> tree;
+        std::vector<int> keys;
+        std::vector<int *> values;
+        tree.findBatch(keys, values);
+        ASSERT_TRUE(values.empty());
+
+        for (int key = 0; key < 37; ++key)
+            keys.push_back(key * 5);
+        tree.findBatch(keys, values);
+        ASSERT_EQ(std::vector<int *>(37, nullptr), values);
+
+        for (int i : {50, 20, 80, 10, 30, 70, 90, 60, 5, 95, 125, 170})
+            tree.insert(i, i + 1);
+        tree.findBatch(keys, values);
+        ASSERT_EQ(keys.size(), values.size());
+        for (size_t idx = 0; idx < keys.size(); ++idx)
+            ASSERT_EQ(tree.find(keys[idx]), values[idx]);
+    }
+
+    TEST(BinarySearchTree, parallelBulkLoadMatchesSequential)
+    {
+        std::vector<std::pair<int, int>> pairs;
+        std::mt19937 generator(5);
+        for (int i = 0; i < 150000; ++i)
+            pairs.emplace_back((int) (generator() % 100000), i);
+
+        BinarySearchTree<int, int> sequential;
+        sequential.bulkLoad(pairs.begin(), pairs.end());
+        BinarySearchTree<int, int> parallel;
+        parallel.bulkLoad(pairs.begin(), pairs.end(), true, 4);
+        ASSERT_EQ(sequential.size(), parallel.size());
+        ASSERT_EQ(sequential.toString(), parallel.toString());
+
+        for (int key = 0; key < 100000; key += 2)
+            parallel.remove(key);
+        for (size_t k = 0; k + 1 < parallel.size(); k += 97)
+            ASSERT_LT(*parallel.select(k), *parallel.select(k + 1));
+        ASSERT_EQ(parallel.size(), parallel.rank(100000));
+    }
+
+    TEST(BinarySearchTree, savedSnapshotMatchesTree)
+    {
+        auto path = ::testing::TempDir() + "bst-snapshot";
+        BinarySearchTree<int, int> tree;
+        for (int i : {50, 20, 80, 10, 30, 70, 90, 60})
+            tree.insert(i, i + 1);
+        tree.save(path);
+        tree.remove(50);
+
+        auto mapped = BinarySearchTree<int, int>::openMapped(path);
+        ASSERT_EQ(8, mapped.size());
+        for (int key = 0; key <= 100; ++key) {
+            if (key % 10 != 0 || key == 0 || key == 40 || key == 100)
+                ASSERT_EQ(nullptr, mapped.find(key));
+            else
+                ASSERT_EQ(key + 1, *mapped.find(key));
+        }
+        std::vector<int> keys;
+        mapped.forEachInRange(25, 65, [&keys](int const &key, int const &) {
+            keys.push_back(key);
+        });
+        ASSERT_EQ(std::vector<int>({30, 50, 60}), keys);
+        std::remove(path.c_str());
+    }
+
+    TEST(BinarySearchTree, boundedPrinting)
+    {
+        BinarySearchTree<int, int> tree;
+        for (int i : {4, 2, 6, 1, 3, 5, 7})
+            tree.insert(i, i);
+        std::ostringstream full;
+        tree.writeString(full);
+        ASSERT_EQ(tree.toString(), full.str());
+
+        std::ostringstream bounded;
+        tree.writeString(bounded, 1);
+        ASSERT_EQ("([4,4],...,...)", bounded.str());
+
+        std::ostringstream depth;
+        tree.print(depth, 1);
+        ASSERT_EQ("[4, 4]\n    L: ...\n    R: ...\n", depth.str());
+
+        std::ostringstream range;
+        tree.printRange(range, 5, 9);
+        ASSERT_EQ("    R: [6, 6]\n        L: [5, 5]\n        R: [7, 7]\n", range.str());
+    }
+
+    TEST(BinarySearchTree, keysOnlySet)
+    {
+        typedef BinarySearchTreeSet<unsigned long> Set;
+        ASSERT_LT(Set::nodeBytes(), (BinarySearchTree<unsigned long, unsigned long>::nodeBytes()));
+
+        Set set;
+        for (unsigned long key : {4, 2, 6, 1, 3})
+            ASSERT_TRUE(set.insert(key));
+        ASSERT_FALSE(set.insert(3));
+        ASSERT_EQ(5, set.size());
+        ASSERT_TRUE(set.contains(6));
+        set.remove(6);
+        ASSERT_FALSE(set.contains(6));
+        ASSERT_FALSE(set.contains(5));
+        ASSERT_EQ("([4,],([2,],([1,],,),([3,],,)),)", set.toString());
+    }
+
+    // counts live instances, copying throws once the shared copy budget is used up
+    struct FragileValue
+    {
+        static std::atomic<int> live;
+        static std::atomic<int> copiesLeft;
+
+        FragileValue()
+        {
+            ++live;
+        }
+
+        FragileValue(FragileValue const &)
+        {
+            if (copiesLeft-- <= 0)
+                throw std::runtime_error("copy failed");
+            ++live;
+        }
+
+        ~FragileValue()
+        {
+            --live;
+        }
+    };
+
+    std::atomic<int> FragileValue::live(0);
+    std::atomic<int> FragileValue::copiesLeft(0);
+
+    template<typename Tree>
+    void assertFailedBuildCleansUp(int count, int copyBudget, size_t threadCount)
+    {
+        FragileValue::copiesLeft = count;
+        std::vector<std::pair<int, FragileValue>> pairs;
+        pairs.reserve(count);
+        for (int key = 0; key < count; ++key)
+            pairs.emplace_back(key, FragileValue());
+
+        int liveBefore = FragileValue::live;
+        Tree tree;
+        FragileValue::copiesLeft = copyBudget;
+        ASSERT_THROW(tree.buildFromSorted(pairs.begin(), pairs.end(), threadCount), std::runtime_error);
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(liveBefore, FragileValue::live);
+    }
+
+    TEST(BinarySearchTree, buildFromSortedCleansUpAfterThrowingCopy)
+    {
+        typedef BinarySearchTree<int, FragileValue, ThreeWayCompare<int>, HeapAllocator> HeapTree;
+        typedef BinarySearchTree<int, FragileValue> PoolTree;
+        for (int copyBudget : {0, 1, 2, 600, 999}) {
+            assertFailedBuildCleansUp<HeapTree>(1000, copyBudget, 1);
+            assertFailedBuildCleansUp<PoolTree>(1000, copyBudget, 1);
+        }
+        for (int copyBudget : {0, 1, 2, 5, 35000, 69990}) {
+            assertFailedBuildCleansUp<HeapTree>(70000, copyBudget, 4);
+            assertFailedBuildCleansUp<PoolTree>(70000, copyBudget, 4);
+        }
+    }
 }
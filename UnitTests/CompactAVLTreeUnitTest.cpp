@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../AVLTreeLib/AVLTree.h"
+#include "../AVLTreeLib/CompactAVLTree.h"
+
+
+namespace CompactAVLTreeUnitTest {
+
+    TEST(CompactAVLTree, constructEmpty) {
+        CompactAVLTree<int, int> tree;
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(1));
+        tree.remove(1);
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(CompactAVLTree, nodesAreSmallerThanAVLTree) {
+        typedef CompactAVLTree<unsigned long, unsigned long> Compact;
+        ASSERT_EQ(32, Compact::nodeBytes());
+        ASSERT_LT(Compact::nodeBytes(), (AVLTree<unsigned long, unsigned long>::nodeBytes()));
+        ASSERT_EQ(4294967295u, Compact::maxSize());
+    }
+
+    TEST(CompactAVLTree, insertsMatchAVLTreeShape) {
+        CompactAVLTree<int, int> compact;
+        AVLTree<int, int> tree;
+        std::mt19937 generator(37);
+        for (int i = 0; i < 2000; ++i) {
+            int key = (int) (generator() % 5000);
+            compact.insert(key, i);
+            tree.insert(key, i);
+        }
+        ASSERT_EQ(tree.size(), compact.size());
+        ASSERT_EQ(tree.toString(), compact.toString());
+    }
+
+    TEST(CompactAVLTree, rotationsAfterRemoval) {
+        CompactAVLTree<int, int> tree;
+        for (int key : {20, 10, 30, 25}) {
+            tree.insert(key, key);
+        }
+        tree.remove(10);
+        ASSERT_EQ("([25,25],([20,20],,),([30,30],,))", tree.toString());
+        tree.remove(25);
+        ASSERT_EQ("([30,30],([20,20],,),)", tree.toString());
+    }
+
+    TEST(CompactAVLTree, randomOperationsMatchMap) {
+        CompactAVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(41);
+        for (int i = 0; i < 50000; ++i) {
+            int key = (int) (generator() % 3000);
+            if (generator() % 2 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        std::vector<std::pair<int, int>> visited;
+        tree.forEach([&visited](int const &key, int const &value) {
+            visited.emplace_back(key, value);
+        });
+        std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, visited);
+
+        visited.clear();
+        tree.forEachInRange(1000, 1100, [&visited](int const &key, int const &value) {
+            visited.emplace_back(key, value);
+        });
+        expected.assign(reference.lower_bound(1000), reference.upper_bound(1100));
+        ASSERT_EQ(expected, visited);
+    }
+
+    TEST(CompactAVLTree, removedNodesAreReused) {
+        CompactAVLTree<int, int> tree;
+        tree.reserve(100);
+        for (int key = 0; key < 100; ++key) {
+            tree.insert(key, key);
+        }
+        auto memory = tree.memoryUsage();
+        for (int round = 0; round < 10; ++round) {
+            for (int key = 0; key < 100; key += 2) {
+                tree.remove(key);
+            }
+            for (int key = 0; key < 100; key += 2) {
+                tree.insert(key, -key);
+            }
+        }
+        ASSERT_EQ(memory, tree.memoryUsage());
+        ASSERT_EQ(100, tree.size());
+        ASSERT_EQ(-42, *tree.find(42));
+
+        tree.clear();
+        ASSERT_EQ(0, tree.memoryUsage());
+        ASSERT_FALSE(tree.contains(1));
+    }
+
+    TEST(CompactAVLTree, narrowIndicesLimitSize) {
+        CompactAVLTree<int, int, ThreeWayCompare<int>, std::uint8_t> tree;
+        ASSERT_EQ(255, tree.maxSize());
+        for (int key = 0; key < 255; ++key) {
+            tree.insert(key, key);
+        }
+        ASSERT_THROW(tree.insert(1000, 0), std::length_error);
+        tree.insert(7, 70);
+        ASSERT_EQ(70, *tree.find(7));
+        tree.remove(0);
+        tree.insert(1000, 0);
+        ASSERT_EQ(255, tree.size());
+        ASSERT_TRUE(tree.contains(1000));
+    }
+
+    TEST(CompactAVLTree, coldValuesStayOutOfNodes) {
+        typedef CompactAVLTree<unsigned long, std::array<char, 256>, ThreeWayCompare<unsigned long>,
+                std::uint32_t, ColdValues> Cold;
+        typedef CompactAVLTree<unsigned long, std::array<char, 256>> Inline;
+        ASSERT_EQ(24, Cold::nodeBytes());
+        ASSERT_EQ(280, Inline::nodeBytes());
+
+        Cold tree;
+        tree.reserve(10);
+        ASSERT_EQ(10 * (24 + 256), tree.memoryUsage());
+    }
+
+    TEST(CompactAVLTree, coldValuesMatchMap) {
+        typedef CompactAVLTree<int, std::string, ThreeWayCompare<int>, std::uint32_t, ColdValues> Cold;
+        Cold tree;
+        std::map<int, std::string> reference;
+        std::mt19937 generator(43);
+        for (int i = 0; i < 20000; ++i) {
+            int key = (int) (generator() % 1000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, std::to_string(i));
+                reference[key] = std::to_string(i);
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        std::vector<std::pair<int, std::string>> visited;
+        tree.forEach([&visited](int const &key, std::string const &value) {
+            visited.emplace_back(key, value);
+        });
+        std::vector<std::pair<int, std::string>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, visited);
+        for (int key = 0; key < 1000; ++key) {
+            auto value = tree.find(key);
+            if (reference.count(key) == 0) {
+                ASSERT_EQ(nullptr, value);
+            } else {
+                ASSERT_EQ(reference[key], *value);
+            }
+        }
+
+        Cold small;
+        for (int key : {20, 10, 30, 25}) {
+            small.insert(key, std::to_string(key));
+        }
+        small.remove(20);
+        ASSERT_EQ("([25,25],([10,10],,),([30,30],,))", small.toString());
+    }
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../AVLTreeLib/ConcurrentAVLTree.h"
+
+
+namespace ConcurrentAVLTreeUnitTest {
+
+    TEST(ConcurrentAVLTree, constructEmpty) {
+        ConcurrentAVLTree<int, int> tree;
+        int value = -1;
+        ASSERT_EQ(0, tree.size());
+        ASSERT_FALSE(tree.find(1, value));
+        ASSERT_EQ(-1, value);
+        tree.remove(1);
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(ConcurrentAVLTree, insertReplacesValue) {
+        ConcurrentAVLTree<int, std::string> tree;
+        tree.insert(1, "one");
+        tree.insert(1, "uno");
+        std::string value;
+        ASSERT_EQ(1, tree.size());
+        ASSERT_TRUE(tree.find(1, value));
+        ASSERT_EQ("uno", value);
+    }
+
+    TEST(ConcurrentAVLTree, randomOperationsMatchMap) {
+        ConcurrentAVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::mt19937 generator(7);
+        for (int i = 0; i < 20000; ++i) {
+            int key = (int) (generator() % 2000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        for (int key = 0; key < 2000; ++key) {
+            int value = -1;
+            auto entry = reference.find(key);
+            ASSERT_EQ(entry != reference.end(), tree.find(key, value));
+            ASSERT_EQ(entry != reference.end(), tree.contains(key));
+            if (entry != reference.end()) {
+                ASSERT_EQ(entry->second, value);
+            }
+        }
+    }
+
+    TEST(ConcurrentAVLTree, customComparator) {
+        ConcurrentAVLTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(i, i);
+        }
+        for (int i = 0; i < 100; i += 2) {
+            tree.remove(i);
+        }
+        int value = 0;
+        ASSERT_EQ(50, tree.size());
+        ASSERT_FALSE(tree.contains(50));
+        ASSERT_TRUE(tree.find(51, value));
+        ASSERT_EQ(51, value);
+    }
+
+    TEST(ConcurrentAVLTree, readersSeeStableKeysDuringWrites) {
+        // Odd keys stay in the tree, even keys are inserted, reassigned and removed by the writer
+        ConcurrentAVLTree<int, std::string> tree;
+        for (int key = 1; key < 4000; key += 2) {
+            tree.insert(key, std::to_string(key));
+        }
+
+        std::atomic<bool> writing(true);
+        std::atomic<int> failures(0);
+        std::vector<std::thread> readers;
+        for (int reader = 0; reader < 3; ++reader) {
+            readers.emplace_back([&tree, &writing, &failures, reader]() {
+                std::mt19937 generator((unsigned) reader);
+                std::string value;
+                while (writing.load()) {
+                    int key = (int) (generator() % 2000) * 2 + 1;
+                    if (!tree.find(key, value) || value != std::to_string(key)) {
+                        failures.fetch_add(1);
+                    }
+                    if (tree.contains(-key)) {
+                        failures.fetch_add(1);
+                    }
+                }
+            });
+        }
+
+        std::mt19937 generator(42);
+        for (int round = 0; round < 20000; ++round) {
+            int key = (int) (generator() % 2000) * 2;
+            if (round % 3 == 2) {
+                tree.remove(key);
+            } else {
+                tree.insert(key, std::to_string(round));
+            }
+        }
+        writing.store(false);
+        for (auto &reader : readers) {
+            reader.join();
+        }
+
+        ASSERT_EQ(0, failures.load());
+        std::string value;
+        ASSERT_TRUE(tree.find(3999, value));
+        ASSERT_EQ("3999", value);
+    }
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "../AVLTreeLib/AVLTree.h"
+
+
+namespace MappedTreeUnitTest {
+
+    typedef AVLTree<int, int> IntTree;
+
+    /**
+     * Get path of a scratch file in the test's temporary directory
+     */
+    std::string scratchPath(std::string const &name) {
+        return ::testing::TempDir() + "mapped-tree-" + name;
+    }
+
+    /**
+     * Overwrite one byte of a file
+     */
+    void corruptByte(std::string const &path, long offset) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(offset);
+        char byte = 0;
+        file.get(byte);
+        file.seekp(offset);
+        file.put((char) (byte ^ 0x5A));
+    }
+
+    TEST(MappedTree, emptyTreeRoundTrip) {
+        auto path = scratchPath("empty");
+        AVLTree<int, int> tree;
+        tree.save(path);
+        auto mapped = IntTree::openMapped(path);
+        ASSERT_EQ(0, mapped.size());
+        ASSERT_EQ(nullptr, mapped.find(1));
+        mapped.forEach([](int const &, int const &) {
+            FAIL();
+        });
+        std::remove(path.c_str());
+    }
+
+    TEST(MappedTree, lookupsMatchTree) {
+        auto path = scratchPath("lookups");
+        AVLTree<long, double> tree;
+        std::map<long, double> reference;
+        std::mt19937 generator(31);
+        for (int i = 0; i < 50000; ++i) {
+            long key = (long) (generator() % 200000) - 100000;
+            tree.insert(key, key * 0.5);
+            reference[key] = key * 0.5;
+        }
+        tree.save(path);
+        tree.clear();
+
+        auto mapped = AVLTree<long, double>::openMapped(path);
+        ASSERT_EQ(reference.size(), mapped.size());
+        for (long key = -100010; key < 100010; ++key) {
+            auto entry = reference.find(key);
+            if (entry == reference.end()) {
+                ASSERT_EQ(nullptr, mapped.find(key));
+            } else {
+                ASSERT_EQ(entry->second, *mapped.find(key));
+            }
+        }
+
+        std::vector<std::pair<long, double>> visited;
+        mapped.forEach([&visited](long const &key, double const &value) {
+            visited.emplace_back(key, value);
+        });
+        std::vector<std::pair<long, double>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, visited);
+        std::remove(path.c_str());
+    }
+
+    TEST(MappedTree, rangeQueries) {
+        auto path = scratchPath("ranges");
+        AVLTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int key = 0; key < 100; key += 3) {
+            tree.insert(key, -key);
+        }
+        tree.save(path);
+
+        auto mapped = AVLTree<int, int, ThreeWayCompare<int, std::greater<int>>>::openMapped(path);
+        std::vector<int> keys;
+        mapped.forEachInRange(20, 10, [&keys](int const &key, int const &value) {
+            ASSERT_EQ(-key, value);
+            keys.push_back(key);
+        });
+        ASSERT_EQ(std::vector<int>({18, 15, 12}), keys);
+
+        keys.clear();
+        mapped.forEachInRange(200, 98, [&keys](int const &key, int const &) {
+            keys.push_back(key);
+        });
+        ASSERT_EQ(std::vector<int>({99}), keys);
+        std::remove(path.c_str());
+    }
+
+    TEST(MappedTree, viewOutlivesMove) {
+        auto path = scratchPath("move");
+        AVLTree<int, int> tree;
+        tree.insert(1, 10);
+        tree.insert(2, 20);
+        tree.save(path);
+
+        MappedTree<int, int> moved;
+        {
+            auto mapped = IntTree::openMapped(path);
+            moved = std::move(mapped);
+            ASSERT_EQ(0, mapped.size());
+        }
+        std::remove(path.c_str());
+        ASSERT_EQ(2, moved.size());
+        ASSERT_EQ(20, *moved.find(2));
+    }
+
+    TEST(MappedTree, rejectsInvalidFiles) {
+        auto path = scratchPath("invalid");
+        ASSERT_THROW(IntTree::openMapped(path), std::system_error);
+
+        AVLTree<int, int> tree;
+        for (int key = 0; key < 1000; ++key) {
+            tree.insert(key, key);
+        }
+        tree.save(path);
+        ASSERT_THROW((AVLTree<int, long>::openMapped(path)), std::runtime_error);
+        ASSERT_THROW((AVLTree<long, int>::openMapped(path)), std::runtime_error);
+
+        corruptByte(path, 1000);
+        ASSERT_THROW(IntTree::openMapped(path), std::runtime_error);
+        ASSERT_EQ(1000, IntTree::openMapped(path, false).size());
+
+        corruptByte(path, 0);
+        ASSERT_THROW(IntTree::openMapped(path, false), std::runtime_error);
+
+        tree.save(path);
+        ASSERT_EQ(1000, IntTree::openMapped(path).size());
+        {
+            std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+            truncated << "TREESNAP";
+        }
+        ASSERT_THROW(IntTree::openMapped(path), std::runtime_error);
+        std::remove(path.c_str());
+    }
+
+    TEST(MappedTree, saveIntoWorkingDirectory) {
+        // No directory part, the working directory is synced after the rename
+        std::string path = "mapped-tree-relative";
+        IntTree tree;
+        tree.insert(1, 10);
+        tree.save(path);
+        auto mapped = IntTree::openMapped(path);
+        ASSERT_EQ(10, *mapped.find(1));
+        std::remove(path.c_str());
+    }
+
+    TEST(MappedTree, syncMissingDirectoryThrows) {
+        ASSERT_THROW(syncParentDirectory(scratchPath("missing/snapshot")), std::system_error);
+        ASSERT_NO_THROW(syncParentDirectory(scratchPath("snapshot")));
+    }
+}
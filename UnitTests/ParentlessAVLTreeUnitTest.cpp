@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../AVLTreeLib/AVLTree.h"
+#include "../AVLTreeLib/ParentlessAVLTree.h"
+
+
+namespace ParentlessAVLTreeUnitTest {
+
+    TEST(ParentlessAVLTree, constructEmpty) {
+        ParentlessAVLTree<int, int> tree;
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(1));
+        tree.remove(1);
+        ASSERT_EQ(0, tree.size());
+    }
+
+    TEST(ParentlessAVLTree, nodesHaveNoParentPointer) {
+        typedef ParentlessAVLTree<unsigned long, unsigned long> Tree;
+        ASSERT_EQ(40, Tree::nodeBytes());
+        ASSERT_LT(Tree::nodeBytes(), (AVLTree<unsigned long, unsigned long>::nodeBytes()));
+    }
+
+    TEST(ParentlessAVLTree, doubleRotations) {
+        ParentlessAVLTree<int, int> tree;
+        tree.insert(30, 30);
+        tree.insert(10, 10);
+        tree.insert(20, 20);
+        ASSERT_EQ("([20,20],([10,10],,),([30,30],,))", tree.toString());
+        tree.insert(40, 40);
+        tree.insert(35, 35);
+        ASSERT_EQ("([20,20],([10,10],,),([35,35],([30,30],,),([40,40],,)))", tree.toString());
+    }
+
+    TEST(ParentlessAVLTree, removeNodeWithTwoChildren) {
+        ParentlessAVLTree<int, int> tree;
+        for (int key : {20, 10, 40, 5, 30, 50, 45}) {
+            tree.insert(key, key);
+        }
+        tree.remove(40);
+        ASSERT_EQ("([20,20],([10,10],([5,5],,),),([45,45],([30,30],,),([50,50],,)))", tree.toString());
+        tree.remove(20);
+        ASSERT_EQ("([30,30],([10,10],([5,5],,),),([45,45],,([50,50],,)))", tree.toString());
+        tree.remove(10);
+        tree.remove(5);
+        ASSERT_EQ("([45,45],([30,30],,),([50,50],,))", tree.toString());
+    }
+
+    TEST(ParentlessAVLTree, insertsMatchAVLTreeShape) {
+        ParentlessAVLTree<int, int> parentless;
+        AVLTree<int, int> tree;
+        std::mt19937 generator(43);
+        for (int i = 0; i < 3000; ++i) {
+            int key = (int) (generator() % 10000);
+            parentless.insert(key, i);
+            tree.insert(key, i);
+        }
+        ASSERT_EQ(tree.size(), parentless.size());
+        ASSERT_EQ(tree.toString(), parentless.toString());
+    }
+
+    TEST(ParentlessAVLTree, randomOperationsMatchMap) {
+        ParentlessAVLTree<int, std::string> tree;
+        std::map<int, std::string> reference;
+        std::mt19937 generator(47);
+        for (int i = 0; i < 50000; ++i) {
+            int key = (int) (generator() % 3000);
+            if (generator() % 2 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, std::to_string(i));
+                reference[key] = std::to_string(i);
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        std::vector<std::pair<int, std::string>> visited;
+        tree.forEach([&visited](int const &key, std::string const &value) {
+            visited.emplace_back(key, value);
+        });
+        std::vector<std::pair<int, std::string>> expected(reference.begin(), reference.end());
+        ASSERT_EQ(expected, visited);
+
+        tree.clear();
+        ASSERT_EQ(0, tree.size());
+        ASSERT_FALSE(tree.contains(expected.front().first));
+    }
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../AVLTreeLib/PersistentAVLTree.h"
+
+
+namespace PersistentAVLTreeUnitTest {
+
+    TEST(PersistentAVLTree, constructEmpty) {
+        PersistentAVLTree<int, int> tree;
+        ASSERT_EQ("", tree.toString());
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(1));
+        tree.remove(1);
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(0, tree.snapshot().size());
+    }
+
+    TEST(PersistentAVLTree, rotationsMatchAVLTree) {
+        PersistentAVLTree<int, int> tree;
+        tree.insert(10, 10);
+        tree.insert(20, 20);
+        tree.insert(30, 30);
+        ASSERT_EQ("([20,20],([10,10],,),([30,30],,))", tree.toString());
+        tree.insert(25, 25);
+        tree.insert(27, 27);
+        ASSERT_EQ("([20,20],([10,10],,),([27,27],([25,25],,),([30,30],,)))", tree.toString());
+        tree.remove(10);
+        ASSERT_EQ("([27,27],([20,20],,([25,25],,)),([30,30],,))", tree.toString());
+    }
+
+    TEST(PersistentAVLTree, snapshotIsUnaffectedByWrites) {
+        PersistentAVLTree<int, std::string> tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(i, std::to_string(i));
+        }
+        auto before = tree.snapshot();
+
+        tree.insert(5, "five");
+        tree.insert(1000, "thousand");
+        tree.remove(50);
+        auto after = tree.snapshot();
+        tree.clear();
+
+        ASSERT_EQ(100, before.size());
+        ASSERT_EQ("5", *before.find(5));
+        ASSERT_EQ(nullptr, before.find(1000));
+        ASSERT_TRUE(before.contains(50));
+
+        ASSERT_EQ(100, after.size());
+        ASSERT_EQ("five", *after.find(5));
+        ASSERT_EQ("thousand", *after.find(1000));
+        ASSERT_FALSE(after.contains(50));
+
+        ASSERT_EQ(0, tree.size());
+        ASSERT_EQ(nullptr, tree.find(5));
+    }
+
+    TEST(PersistentAVLTree, snapshotForEachInOrder) {
+        PersistentAVLTree<int, int, ThreeWayCompare<int, std::greater<int>>> tree;
+        for (int i : {5, 1, 4, 2, 3}) {
+            tree.insert(i, i * 10);
+        }
+        std::vector<int> keys, values;
+        tree.snapshot().forEach([&keys, &values](int const &key, int const &value) {
+            keys.push_back(key);
+            values.push_back(value);
+        });
+        ASSERT_EQ(std::vector<int>({5, 4, 3, 2, 1}), keys);
+        ASSERT_EQ(std::vector<int>({50, 40, 30, 20, 10}), values);
+    }
+
+    TEST(PersistentAVLTree, randomOperationsMatchMapVersions) {
+        PersistentAVLTree<int, int> tree;
+        std::map<int, int> reference;
+        std::vector<PersistentAVLTree<int, int>::Snapshot> snapshots;
+        std::vector<std::map<int, int>> references;
+        std::mt19937 generator(11);
+        for (int i = 0; i < 20000; ++i) {
+            int key = (int) (generator() % 1000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+            if (i % 4000 == 0) {
+                snapshots.push_back(tree.snapshot());
+                references.push_back(reference);
+            }
+        }
+        snapshots.push_back(tree.snapshot());
+        references.push_back(reference);
+
+        for (size_t version = 0; version < snapshots.size(); ++version) {
+            ASSERT_EQ(references[version].size(), snapshots[version].size());
+            for (int key = 0; key < 1000; ++key) {
+                auto entry = references[version].find(key);
+                if (entry == references[version].end()) {
+                    ASSERT_EQ(nullptr, snapshots[version].find(key));
+                } else {
+                    ASSERT_EQ(entry->second, *snapshots[version].find(key));
+                }
+            }
+        }
+    }
+
+    TEST(PersistentAVLTree, snapshotReadFromAnotherThread) {
+        PersistentAVLTree<int, int> tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(i, i);
+        }
+
+        auto snapshot = tree.snapshot();
+        int mismatches = 0;
+        std::thread reader([snapshot, &mismatches]() {
+            for (int round = 0; round < 20; ++round) {
+                for (int i = 0; i < 1000; ++i) {
+                    auto value = snapshot.find(i);
+                    mismatches += (value == nullptr || *value != i);
+                }
+            }
+        });
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(i, -i);
+            tree.remove(i / 2);
+        }
+        reader.join();
+
+        ASSERT_EQ(0, mismatches);
+        ASSERT_EQ(500, tree.size());
+        ASSERT_EQ(-999, *tree.find(999));
+    }
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../AVLTreeLib/ShardedTree.h"
+
+
+namespace ShardedTreeUnitTest {
+
+    TEST(ShardedTree, constructEmpty) {
+        ShardedTree<int, int> tree(4);
+        int value = -1;
+        ASSERT_EQ(4, tree.shardCount());
+        ASSERT_FALSE(tree.isRangePartitioned());
+        ASSERT_EQ(0, tree.size());
+        ASSERT_FALSE(tree.find(1, value));
+        ASSERT_EQ(-1, value);
+        tree.remove(1);
+
+        ShardedTree<int, int> zeroShards(0);
+        ASSERT_EQ(1, zeroShards.shardCount());
+    }
+
+    TEST(ShardedTree, hashPartitionedMatchesMap) {
+        ShardedTree<int, int> tree(8);
+        std::map<int, int> reference;
+        std::mt19937 generator(3);
+        for (int i = 0; i < 20000; ++i) {
+            int key = (int) (generator() % 2000);
+            if (generator() % 3 == 0) {
+                tree.remove(key);
+                reference.erase(key);
+            } else {
+                tree.insert(key, i);
+                reference[key] = i;
+            }
+        }
+
+        ASSERT_EQ(reference.size(), tree.size());
+        for (int key = 0; key < 2000; ++key) {
+            int value = -1;
+            auto entry = reference.find(key);
+            ASSERT_EQ(entry != reference.end(), tree.find(key, value));
+            ASSERT_EQ(entry != reference.end(), tree.contains(key));
+            if (entry != reference.end()) {
+                ASSERT_EQ(entry->second, value);
+            }
+        }
+
+        std::map<int, int> visited;
+        tree.forEach([&visited](int const &key, int const &value) {
+            visited[key] = value;
+        });
+        ASSERT_EQ(reference, visited);
+    }
+
+    TEST(ShardedTree, rangePartitionedScansInOrder) {
+        ShardedTree<int, int> tree(std::vector<int>({100, 200, 300}));
+        ASSERT_EQ(4, tree.shardCount());
+        ASSERT_TRUE(tree.isRangePartitioned());
+        for (int key = 395; key >= -5; key -= 10) {
+            tree.insert(key, key * 2);
+        }
+
+        std::vector<int> keys;
+        tree.forEach([&keys](int const &key, int const &value) {
+            keys.push_back(key);
+            ASSERT_EQ(key * 2, value);
+        });
+        ASSERT_EQ(41, keys.size());
+        ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+        keys.clear();
+        tree.forEachInRange(180, 225, [&keys](int const &key, int const &) {
+            keys.push_back(key);
+        });
+        ASSERT_EQ(std::vector<int>({185, 195, 205, 215, 225}), keys);
+
+        keys.clear();
+        tree.forEachInRange(300, 300, [&keys](int const &key, int const &) {
+            keys.push_back(key);
+        });
+        ASSERT_TRUE(keys.empty());
+    }
+
+    TEST(ShardedTree, hashPartitionedRangeScanFindsAllShards) {
+        ShardedTree<int, int> tree(5);
+        for (int key = 0; key < 100; ++key) {
+            tree.insert(key, key);
+        }
+        std::vector<int> keys;
+        tree.forEachInRange(10, 19, [&keys](int const &key, int const &) {
+            keys.push_back(key);
+        });
+        std::sort(keys.begin(), keys.end());
+        ASSERT_EQ(std::vector<int>({10, 11, 12, 13, 14, 15, 16, 17, 18, 19}), keys);
+    }
+
+    TEST(ShardedTree, concurrentInserts) {
+        ShardedTree<int, int> tree(std::vector<int>({2500, 5000, 7500}));
+        std::vector<std::thread> writers;
+        for (int writer = 0; writer < 4; ++writer) {
+            writers.emplace_back([&tree, writer]() {
+                for (int key = writer; key < 10000; key += 4) {
+                    tree.insert(key, -key);
+                }
+            });
+        }
+        for (auto &writer : writers) {
+            writer.join();
+        }
+
+        ASSERT_EQ(10000, tree.size());
+        int value = 0;
+        ASSERT_TRUE(tree.find(4321, value));
+        ASSERT_EQ(-4321, value);
+    }
+}
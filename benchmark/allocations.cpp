@@ -0,0 +1,36 @@
+#include "allocations.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Defined out of line, so that the compiler cannot pair the inlined free of operator delete
+// with a pointer returned by operator new and report a mismatch
+
+namespace {
+    // Atomic, nodes and buffers of parallel builds are allocated on worker threads
+    std::atomic<size_t> &allocationCounter() {
+        static std::atomic<size_t> count(0);
+        return count;
+    }
+}
+
+size_t allocationCount() {
+    return allocationCounter().load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+    allocationCounter().fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Heap allocation counting tool
+	Link benchmark/allocations.cpp into the program, it replaces global operator new/delete.
+	How to use:
+	{
+		auto before = allocationCount();
+
+		// Code to examinate
+
+		auto allocations = allocationCount() - before;
+	}
+*/
+
+size_t allocationCount();
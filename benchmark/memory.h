@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <unistd.h>
+
+/*
+	Resident memory measuring tool (Linux)
+	How to use:
+	{
+		auto before = residentSetBytes();
+
+		// Code to examinate
+
+		auto grown = residentSetBytes() - before;
+	}
+	Freed memory is not always returned to the system, so measure every structure in a fresh process.
+	Returns 0 where /proc is not available.
+*/
+
+inline size_t residentSetBytes() {
+    std::FILE *file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    unsigned long totalPages = 0, residentPages = 0;
+    auto fields = std::fscanf(file, "%lu %lu", &totalPages, &residentPages);
+    std::fclose(file);
+    return fields == 2 ? residentPages * (size_t) sysconf(_SC_PAGESIZE) : 0;
+}